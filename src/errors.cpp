@@ -25,6 +25,16 @@ authors named in the AUTHORS file.
 **********************************************************************/
 #include "structstream/errors.hpp"
 
+#include <cerrno>
+#include <cstring>
+
 namespace StructStream {
 
+/* StructStream::IOError */
+
+IOError IOError::from_errno(const std::string& what_arg)
+{
+    return IOError(what_arg + ": " + strerror(errno));
+}
+
 }
@@ -0,0 +1,858 @@
+/**********************************************************************
+File name: io_async.cpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#include "structstream/io_async.hpp"
+
+#include <deque>
+#include <exception>
+#include <stdexcept>
+
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cassert>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#ifdef WITH_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#include "structstream/errors.hpp"
+
+namespace StructStream {
+
+/**
+ * Carries out reads and writes at given offsets and reports their
+ * completion later. Each request is identified by a slot number,
+ * and only one request per slot may be in flight.
+ */
+class AsyncBackend {
+public:
+    virtual ~AsyncBackend() {};
+public:
+    virtual void submit(bool write, int fd, uint8_t *buf, intptr_t len,
+                        off_t offset, intptr_t slot) = 0;
+
+    /**
+     * Block until a request completes and return its slot and result,
+     * which is the amount of bytes transferred or a negated errno
+     * value.
+     */
+    virtual void wait(intptr_t *slot, intptr_t *result) = 0;
+
+    virtual bool is_io_uring() const = 0;
+};
+
+/**
+ * Fallback which executes each request right away using pread() and
+ * pwrite().
+ */
+class SyncBackend: public AsyncBackend {
+public:
+    SyncBackend():
+        _completed()
+    {
+
+    };
+    virtual ~SyncBackend() {};
+private:
+    std::deque<std::pair<intptr_t, intptr_t> > _completed;
+public:
+    virtual void submit(bool write, int fd, uint8_t *buf, intptr_t len,
+                        off_t offset, intptr_t slot)
+    {
+        ssize_t result = 0;
+        do {
+            if (write) {
+                result = pwrite(fd, buf, len, offset);
+            } else {
+                result = pread(fd, buf, len, offset);
+            }
+        } while (result < 0 && errno == EINTR);
+
+        _completed.push_back(std::make_pair(
+            slot, (result < 0 ? -errno : (intptr_t)result)));
+    };
+
+    virtual void wait(intptr_t *slot, intptr_t *result)
+    {
+        assert(!_completed.empty());
+        *slot = _completed.front().first;
+        *result = _completed.front().second;
+        _completed.pop_front();
+    };
+
+    virtual bool is_io_uring() const
+    {
+        return false;
+    };
+};
+
+#ifdef WITH_IO_URING
+
+/**
+ * Minimal io_uring driver using the raw system calls. Requests are
+ * submitted one at a time right away; completions are reaped in
+ * order of their arrival.
+ */
+class UringBackend: public AsyncBackend {
+private:
+    UringBackend(intptr_t slots):
+        _ring_fd(-1),
+        _sq_ring(MAP_FAILED),
+        _sq_ring_len(0),
+        _cq_ring(MAP_FAILED),
+        _cq_ring_len(0),
+        _sqes(nullptr),
+        _sqes_len(0),
+        _iov(slots)
+    {
+
+    };
+public:
+    virtual ~UringBackend()
+    {
+        if (_sqes) {
+            munmap(_sqes, _sqes_len);
+        }
+        if (_cq_ring != MAP_FAILED) {
+            munmap(_cq_ring, _cq_ring_len);
+        }
+        if (_sq_ring != MAP_FAILED) {
+            munmap(_sq_ring, _sq_ring_len);
+        }
+        if (_ring_fd >= 0) {
+            close(_ring_fd);
+        }
+    };
+private:
+    int _ring_fd;
+    void *_sq_ring;
+    size_t _sq_ring_len;
+    void *_cq_ring;
+    size_t _cq_ring_len;
+    struct io_uring_sqe *_sqes;
+    size_t _sqes_len;
+
+    unsigned *_sq_tail;
+    unsigned *_sq_mask;
+    unsigned *_sq_array;
+    unsigned *_cq_head;
+    unsigned *_cq_tail;
+    unsigned *_cq_mask;
+    struct io_uring_cqe *_cqes;
+
+    std::vector<struct iovec> _iov;
+
+private:
+    bool setup(unsigned entries)
+    {
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        _ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+        if (_ring_fd < 0) {
+            return false;
+        }
+
+        _sq_ring_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _sq_ring = mmap(nullptr, _sq_ring_len, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, _ring_fd,
+                        IORING_OFF_SQ_RING);
+        if (_sq_ring == MAP_FAILED) {
+            return false;
+        }
+
+        _cq_ring_len = params.cq_off.cqes
+            + params.cq_entries * sizeof(struct io_uring_cqe);
+        _cq_ring = mmap(nullptr, _cq_ring_len, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, _ring_fd,
+                        IORING_OFF_CQ_RING);
+        if (_cq_ring == MAP_FAILED) {
+            return false;
+        }
+
+        _sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+        void *sqes = mmap(nullptr, _sqes_len, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, _ring_fd,
+                          IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+        _sqes = (struct io_uring_sqe*)sqes;
+
+        uint8_t *sq = (uint8_t*)_sq_ring;
+        _sq_tail = (unsigned*)(sq + params.sq_off.tail);
+        _sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+        _sq_array = (unsigned*)(sq + params.sq_off.array);
+
+        uint8_t *cq = (uint8_t*)_cq_ring;
+        _cq_head = (unsigned*)(cq + params.cq_off.head);
+        _cq_tail = (unsigned*)(cq + params.cq_off.tail);
+        _cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+        _cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+        return true;
+    };
+
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags)
+    {
+        return syscall(__NR_io_uring_enter, _ring_fd, to_submit,
+                       min_complete, flags, nullptr, 0);
+    };
+
+public:
+    /**
+     * Return a backend for *slots* concurrent requests, or nullptr if
+     * the kernel does not provide io_uring.
+     */
+    static UringBackend *create(intptr_t slots)
+    {
+        UringBackend *backend = new UringBackend(slots);
+        if (!backend->setup(slots)) {
+            delete backend;
+            return nullptr;
+        }
+        return backend;
+    };
+
+    virtual void submit(bool write, int fd, uint8_t *buf, intptr_t len,
+                        off_t offset, intptr_t slot)
+    {
+        // the iovec must stay valid until the request completes
+        struct iovec &iov = _iov[slot];
+        iov.iov_base = buf;
+        iov.iov_len = len;
+
+        // only we write the tail, the kernel only reads it
+        const unsigned tail = *_sq_tail;
+        const unsigned index = tail & *_sq_mask;
+        struct io_uring_sqe *sqe = &_sqes[index];
+        memset(sqe, 0, sizeof(struct io_uring_sqe));
+        sqe->opcode = (write ? IORING_OP_WRITEV : IORING_OP_READV);
+        sqe->fd = fd;
+        sqe->addr = (uintptr_t)&iov;
+        sqe->len = 1;
+        sqe->off = offset;
+        sqe->user_data = slot;
+        _sq_array[index] = index;
+        __atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+        while (enter(1, 0, 0) < 0) {
+            if (errno != EINTR) {
+                throw IOError::from_errno("Could not submit to io_uring");
+            }
+        }
+    };
+
+    virtual void wait(intptr_t *slot, intptr_t *result)
+    {
+        while (true) {
+            const unsigned head = *_cq_head;
+            if (head != __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE)) {
+                const struct io_uring_cqe *cqe = &_cqes[head & *_cq_mask];
+                *slot = cqe->user_data;
+                *result = cqe->res;
+                __atomic_store_n(_cq_head, head + 1, __ATOMIC_RELEASE);
+                return;
+            }
+
+            if (enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                throw IOError::from_errno("Could not wait for io_uring");
+            }
+        }
+    };
+
+    virtual bool is_io_uring() const
+    {
+        return true;
+    };
+};
+
+#endif
+
+static AsyncBackend *create_backend(intptr_t slots, bool try_io_uring)
+{
+#ifdef WITH_IO_URING
+    if (try_io_uring) {
+        AsyncBackend *backend = UringBackend::create(slots);
+        if (backend) {
+            return backend;
+        }
+    }
+#endif
+    return new SyncBackend();
+}
+
+static void throw_errno(intptr_t result, const char *what)
+{
+    errno = -result;
+    throw IOError::from_errno(what);
+}
+
+static off_t current_offset(int fd)
+{
+    const off_t offset = lseek(fd, 0, SEEK_CUR);
+    if (offset < 0) {
+        throw IOError::from_errno("Asynchronous I/O requires a seekable file");
+    }
+    return offset;
+}
+
+/* StructStream::AsyncFileInput */
+
+AsyncFileInput::AsyncFileInput(int fd, bool owns_fd,
+                               intptr_t block_size, intptr_t depth,
+                               bool try_io_uring):
+    _fd(fd),
+    _owns_fd(owns_fd),
+    _block_size(block_size),
+    _backend(nullptr),
+    _blocks(depth),
+    _current(0),
+    _next_offset(0),
+    _eof(false),
+    _eof_offset(0)
+{
+    setup(try_io_uring);
+}
+
+AsyncFileInput::AsyncFileInput(const std::string &path,
+                               intptr_t block_size, intptr_t depth,
+                               bool try_io_uring):
+    _fd(open(path.c_str(), O_RDONLY | O_CLOEXEC)),
+    _owns_fd(true),
+    _block_size(block_size),
+    _backend(nullptr),
+    _blocks(depth),
+    _current(0),
+    _next_offset(0),
+    _eof(false),
+    _eof_offset(0)
+{
+    if (_fd < 0) {
+        throw IOError::from_errno("Could not open file for reading");
+    }
+    setup(try_io_uring);
+}
+
+AsyncFileInput::~AsyncFileInput()
+{
+    teardown();
+}
+
+void AsyncFileInput::setup(bool try_io_uring)
+{
+    assert(_block_size > 0);
+    assert(_blocks.size() > 0);
+
+    try {
+        for (auto &block: _blocks) {
+            block.data = nullptr;
+            block.pending = false;
+        }
+        for (auto &block: _blocks) {
+            block.data = (uint8_t*)malloc(_block_size);
+            if (!block.data) {
+                throw std::runtime_error("Out of memory while allocating blocks.");
+            }
+        }
+        _backend = create_backend(_blocks.size(), try_io_uring);
+        restart(current_offset(_fd));
+    } catch (...) {
+        teardown();
+        throw;
+    }
+}
+
+void AsyncFileInput::teardown()
+{
+    // the kernel may still write into the blocks
+    try {
+        drain();
+    } catch (const IOError&) {
+        // nothing sensible to do here
+    }
+
+    // if waiting itself failed, leak what is still in flight rather
+    // than hand it back to the allocator
+    bool in_flight = false;
+    for (auto &block: _blocks) {
+        if (block.pending) {
+            in_flight = true;
+            continue;
+        }
+        free(block.data);
+        block.data = nullptr;
+    }
+    if (_backend && !in_flight) {
+        delete _backend;
+        _backend = nullptr;
+    }
+    if (_owns_fd && _fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+}
+
+void AsyncFileInput::submit(intptr_t index)
+{
+    Block &block = _blocks[index];
+    block.offset = _next_offset;
+    block.len = 0;
+    block.offs = 0;
+    if (_eof) {
+        // an empty block marks the end
+        block.offset = _eof_offset;
+        block.pending = false;
+        return;
+    }
+
+    _next_offset += _block_size;
+    block.pending = true;
+    _backend->submit(false, _fd, block.data, _block_size, block.offset, index);
+}
+
+void AsyncFileInput::complete(intptr_t index, intptr_t result)
+{
+    Block &block = _blocks[index];
+    block.pending = false;
+    if (result < 0) {
+        throw_errno(result, "Could not read from file");
+    }
+
+    // a short read need not mean end-of-file; fetch the rest
+    // synchronously so that blocks never have holes
+    intptr_t len = result;
+    while (len > 0 && len < _block_size) {
+        const ssize_t more = pread(_fd, &block.data[len], _block_size - len,
+                                   block.offset + len);
+        if (more < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw IOError::from_errno("Could not read from file");
+        } else if (more == 0) {
+            break;
+        }
+        len += more;
+    }
+
+    block.len = len;
+    if (len < _block_size) {
+        // blocks beyond the end may complete first
+        if (!_eof || block.offset + len < _eof_offset) {
+            _eof_offset = block.offset + len;
+        }
+        _eof = true;
+    }
+}
+
+void AsyncFileInput::wait_for(intptr_t index)
+{
+    while (_blocks[index].pending) {
+        intptr_t slot = 0;
+        intptr_t result = 0;
+        _backend->wait(&slot, &result);
+        complete(slot, result);
+    }
+}
+
+std::exception_ptr AsyncFileInput::drain()
+{
+    std::exception_ptr error;
+    if (!_backend) {
+        return error;
+    }
+
+    intptr_t pending = 0;
+    for (auto &block: _blocks) {
+        if (block.pending) {
+            pending++;
+        }
+    }
+
+    // a failed request must not keep us from reaping the others
+    while (pending > 0) {
+        intptr_t slot = 0;
+        intptr_t result = 0;
+        _backend->wait(&slot, &result);
+        pending--;
+        try {
+            complete(slot, result);
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    return error;
+}
+
+void AsyncFileInput::restart(off_t offset)
+{
+    // failures of the reads we drop do not matter
+    drain();
+    _eof = false;
+    _next_offset = offset;
+    _current = 0;
+    for (intptr_t i = 0; i < (intptr_t)_blocks.size(); i++) {
+        submit(i);
+    }
+}
+
+AsyncFileInput::Block *AsyncFileInput::current_block()
+{
+    while (true) {
+        wait_for(_current);
+        Block *block = &_blocks[_current];
+        if (block->offs < block->len) {
+            return block;
+        }
+        if (block->len < _block_size) {
+            return nullptr;
+        }
+
+        // consumed; reuse it to read further ahead
+        submit(_current);
+        _current = (_current + 1) % _blocks.size();
+    }
+}
+
+bool AsyncFileInput::uses_io_uring() const
+{
+    return _backend->is_io_uring();
+}
+
+intptr_t AsyncFileInput::read(void *buf, const intptr_t len)
+{
+    uint8_t *dest = (uint8_t*)buf;
+    intptr_t done = 0;
+    while (done < len) {
+        Block *block = current_block();
+        if (!block) {
+            break;
+        }
+        intptr_t to_copy = block->len - block->offs;
+        if (to_copy > len - done) {
+            to_copy = len - done;
+        }
+        memcpy(&dest[done], &block->data[block->offs], to_copy);
+        block->offs += to_copy;
+        done += to_copy;
+    }
+    return done;
+}
+
+intptr_t AsyncFileInput::write(const void*, const intptr_t)
+{
+    return 0;
+}
+
+bool AsyncFileInput::seekable() const
+{
+    return true;
+}
+
+intptr_t AsyncFileInput::tell() const
+{
+    const Block &block = _blocks[_current];
+    return block.offset + block.offs;
+}
+
+intptr_t AsyncFileInput::seek(const intptr_t offset)
+{
+    wait_for(_current);
+    Block &block = _blocks[_current];
+    if (offset >= block.offset && offset <= block.offset + block.len) {
+        block.offs = offset - block.offset;
+        return offset;
+    }
+
+    // drop the blocks in flight and read ahead from the target
+    // offset instead
+    struct stat info;
+    if (fstat(_fd, &info) != 0) {
+        throw IOError::from_errno("Could not stat file");
+    }
+    const intptr_t target = (offset < info.st_size ? offset : info.st_size);
+    restart(target);
+    return target;
+}
+
+intptr_t AsyncFileInput::acquire(const uint8_t **buf, const intptr_t)
+{
+    Block *block = current_block();
+    if (!block) {
+        return 0;
+    }
+    *buf = &block->data[block->offs];
+    return block->len - block->offs;
+}
+
+void AsyncFileInput::commit(const intptr_t len)
+{
+    Block &block = _blocks[_current];
+    assert(block.offs + len <= block.len);
+    block.offs += len;
+}
+
+bool AsyncFileInput::buffered() const
+{
+    return true;
+}
+
+/* StructStream::AsyncFileOutput */
+
+AsyncFileOutput::AsyncFileOutput(int fd, bool owns_fd,
+                                 intptr_t block_size, intptr_t depth,
+                                 bool try_io_uring):
+    _fd(fd),
+    _owns_fd(owns_fd),
+    _block_size(block_size),
+    _backend(nullptr),
+    _blocks(depth),
+    _current(0),
+    _next_offset(0)
+{
+    setup(try_io_uring);
+}
+
+AsyncFileOutput::AsyncFileOutput(const std::string &path,
+                                 intptr_t block_size, intptr_t depth,
+                                 bool try_io_uring):
+    _fd(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666)),
+    _owns_fd(true),
+    _block_size(block_size),
+    _backend(nullptr),
+    _blocks(depth),
+    _current(0),
+    _next_offset(0)
+{
+    if (_fd < 0) {
+        throw IOError::from_errno("Could not open file for writing");
+    }
+    setup(try_io_uring);
+}
+
+AsyncFileOutput::~AsyncFileOutput()
+{
+    try {
+        flush();
+    } catch (const IOError&) {
+        // nothing sensible to do here
+    }
+    teardown();
+}
+
+void AsyncFileOutput::setup(bool try_io_uring)
+{
+    assert(_block_size > 0);
+    assert(_blocks.size() > 0);
+
+    try {
+        for (auto &block: _blocks) {
+            block.data = nullptr;
+            block.len = 0;
+            block.pending = false;
+        }
+        for (auto &block: _blocks) {
+            block.data = (uint8_t*)malloc(_block_size);
+            if (!block.data) {
+                throw std::runtime_error("Out of memory while allocating blocks.");
+            }
+        }
+        _next_offset = current_offset(_fd);
+        _backend = create_backend(_blocks.size(), try_io_uring);
+    } catch (...) {
+        teardown();
+        throw;
+    }
+}
+
+void AsyncFileOutput::teardown()
+{
+    // the kernel may still read from the blocks
+    try {
+        drain();
+    } catch (const IOError&) {
+        // nothing sensible to do here
+    }
+
+    // if waiting itself failed, leak what is still in flight rather
+    // than hand it back to the allocator
+    bool in_flight = false;
+    for (auto &block: _blocks) {
+        if (block.pending) {
+            in_flight = true;
+            continue;
+        }
+        free(block.data);
+        block.data = nullptr;
+    }
+    if (_backend && !in_flight) {
+        delete _backend;
+        _backend = nullptr;
+    }
+    if (_owns_fd && _fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+}
+
+void AsyncFileOutput::submit_current()
+{
+    Block &block = _blocks[_current];
+    block.offset = _next_offset;
+    block.pending = true;
+    _next_offset += block.len;
+    _backend->submit(true, _fd, block.data, block.len, block.offset, _current);
+
+    // continue in the next block once it is free again
+    _current = (_current + 1) % _blocks.size();
+    wait_for(_current);
+    _blocks[_current].len = 0;
+}
+
+void AsyncFileOutput::complete(intptr_t index, intptr_t result)
+{
+    Block &block = _blocks[index];
+    block.pending = false;
+    if (result < 0) {
+        throw_errno(result, "Could not write to file");
+    }
+
+    intptr_t written = result;
+    while (written < block.len) {
+        const ssize_t more = pwrite(_fd, &block.data[written],
+                                    block.len - written,
+                                    block.offset + written);
+        if (more < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw IOError::from_errno("Could not write to file");
+        }
+        written += more;
+    }
+}
+
+void AsyncFileOutput::wait_for(intptr_t index)
+{
+    while (_blocks[index].pending) {
+        intptr_t slot = 0;
+        intptr_t result = 0;
+        _backend->wait(&slot, &result);
+        complete(slot, result);
+    }
+}
+
+std::exception_ptr AsyncFileOutput::drain()
+{
+    std::exception_ptr error;
+    if (!_backend) {
+        return error;
+    }
+
+    intptr_t pending = 0;
+    for (auto &block: _blocks) {
+        if (block.pending) {
+            pending++;
+        }
+    }
+
+    // a failed request must not keep us from reaping the others
+    while (pending > 0) {
+        intptr_t slot = 0;
+        intptr_t result = 0;
+        _backend->wait(&slot, &result);
+        pending--;
+        try {
+            complete(slot, result);
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    return error;
+}
+
+bool AsyncFileOutput::uses_io_uring() const
+{
+    return _backend->is_io_uring();
+}
+
+void AsyncFileOutput::flush()
+{
+    if (_blocks[_current].len > 0) {
+        submit_current();
+    }
+    std::exception_ptr error = drain();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    if (lseek(_fd, _next_offset, SEEK_SET) < 0) {
+        throw IOError::from_errno("Could not seek in file");
+    }
+}
+
+intptr_t AsyncFileOutput::read(void*, const intptr_t)
+{
+    return 0;
+}
+
+intptr_t AsyncFileOutput::write(const void *buf, const intptr_t len)
+{
+    const uint8_t *src = (const uint8_t*)buf;
+    intptr_t done = 0;
+    while (done < len) {
+        Block &block = _blocks[_current];
+        intptr_t to_copy = _block_size - block.len;
+        if (to_copy > len - done) {
+            to_copy = len - done;
+        }
+        memcpy(&block.data[block.len], &src[done], to_copy);
+        block.len += to_copy;
+        done += to_copy;
+
+        if (block.len == _block_size) {
+            submit_current();
+        }
+    }
+    return len;
+}
+
+bool AsyncFileOutput::buffered() const
+{
+    return true;
+}
+
+}
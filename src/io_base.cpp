@@ -32,16 +32,65 @@ namespace StructStream {
 /* StructStream::IOIntf */
 
 intptr_t IOIntf::skip(const intptr_t len) {
-    void *buf = malloc(len);
+    if (seekable()) {
+        const intptr_t offset = tell();
+        return seek(offset + len) - offset;
+    }
+
+    uint8_t buf[4096];
     intptr_t skipped = 0;
-    try {
-        skipped = read(buf, len);
-    } catch(...) {
-        free(buf);
-        throw;
+    while (skipped < len) {
+        intptr_t chunk = len - skipped;
+        if (chunk > (intptr_t)sizeof(buf)) {
+            chunk = sizeof(buf);
+        }
+        const intptr_t result = read(buf, chunk);
+        skipped += result;
+        if (result < chunk) {
+            break;
+        }
     }
-    free(buf);
     return skipped;
 }
 
+bool IOIntf::seekable() const
+{
+    return false;
+}
+
+intptr_t IOIntf::tell() const
+{
+    return -1;
+}
+
+intptr_t IOIntf::seek(const intptr_t)
+{
+    return -1;
+}
+
+intptr_t IOIntf::acquire(const uint8_t**, const intptr_t)
+{
+    return 0;
+}
+
+void IOIntf::commit(const intptr_t len)
+{
+    skip(len);
+}
+
+bool IOIntf::contiguous() const
+{
+    return false;
+}
+
+bool IOIntf::buffered() const
+{
+    return contiguous();
+}
+
+intptr_t IOIntf::read_available(void *buf, const intptr_t len, const bool)
+{
+    return read(buf, len);
+}
+
 }
@@ -0,0 +1,288 @@
+/**********************************************************************
+File name: io_buffered.cpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#include "structstream/io_buffered.hpp"
+
+#include <stdexcept>
+
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+
+namespace StructStream {
+
+/* StructStream::BufferedReader */
+
+constexpr intptr_t BufferedReader::default_block_size;
+
+BufferedReader::BufferedReader(IOIntfHandle underlying_io,
+                               const intptr_t block_size):
+    _io_h(underlying_io),
+    _io(underlying_io.get()),
+    _buf((uint8_t*)malloc(block_size)),
+    _block_size(block_size),
+    _offs(0),
+    _len(0)
+{
+    assert(block_size > 0);
+    if (!_buf) {
+        throw std::runtime_error("Out of memory while allocating read buffer.");
+    }
+}
+
+BufferedReader::~BufferedReader()
+{
+    free(_buf);
+}
+
+intptr_t BufferedReader::read(void *buf, const intptr_t len)
+{
+    uint8_t *dest = (uint8_t*)buf;
+    intptr_t available = _len - _offs;
+    if (available >= len) {
+        memcpy(dest, &_buf[_offs], len);
+        _offs += len;
+        return len;
+    }
+
+    memcpy(dest, &_buf[_offs], available);
+    _offs = 0;
+    _len = 0;
+
+    intptr_t done = available;
+    while (done < len) {
+        const intptr_t remaining = len - done;
+        if (remaining >= _block_size) {
+            // no point in going through the buffer
+            return done + _io->read(&dest[done], remaining);
+        }
+
+        // take what is there; a pipe may not have a whole block yet
+        _len = _io->read_available(_buf, _block_size);
+        if (_len == 0) {
+            break;
+        }
+        _offs = (_len < remaining ? _len : remaining);
+        memcpy(&dest[done], _buf, _offs);
+        done += _offs;
+    }
+    return done;
+}
+
+intptr_t BufferedReader::write(const void*, const intptr_t)
+{
+    return 0;
+}
+
+intptr_t BufferedReader::skip(const intptr_t len)
+{
+    intptr_t available = _len - _offs;
+    if (available >= len) {
+        _offs += len;
+        return len;
+    }
+
+    _offs = 0;
+    _len = 0;
+    return available + _io->skip(len - available);
+}
+
+intptr_t BufferedReader::acquire(const uint8_t **buf, const intptr_t len)
+{
+    intptr_t available = _len - _offs;
+    if (available < len && len <= _block_size) {
+        memmove(_buf, &_buf[_offs], available);
+        _offs = 0;
+        // the bytes we have may already be all the caller needs, so
+        // only wait for more if there are none
+        _len = available + _io->read_available(
+            &_buf[available], _block_size - available, available == 0);
+        available = _len;
+    }
+
+    *buf = &_buf[_offs];
+    return available;
+}
+
+void BufferedReader::commit(const intptr_t len)
+{
+    assert(_offs + len <= _len);
+    _offs += len;
+}
+
+bool BufferedReader::buffered() const
+{
+    return true;
+}
+
+bool BufferedReader::seekable() const
+{
+    return _io->seekable();
+}
+
+intptr_t BufferedReader::tell() const
+{
+    const intptr_t underlying = _io->tell();
+    if (underlying < 0) {
+        return underlying;
+    }
+    return underlying - (_len - _offs);
+}
+
+intptr_t BufferedReader::seek(const intptr_t offset)
+{
+    const intptr_t underlying = _io->tell();
+    if (underlying < 0) {
+        return underlying;
+    }
+
+    const intptr_t buffer_start = underlying - _len;
+    if (offset >= buffer_start && offset <= underlying) {
+        _offs = offset - buffer_start;
+        return offset;
+    }
+
+    _offs = 0;
+    _len = 0;
+    return _io->seek(offset);
+}
+
+/* StructStream::BufferedWriter */
+
+constexpr intptr_t BufferedWriter::default_block_size;
+
+BufferedWriter::BufferedWriter(IOIntfHandle underlying_io,
+                               const intptr_t block_size):
+    _io_h(underlying_io),
+    _io(underlying_io.get()),
+    _buf((uint8_t*)malloc(block_size)),
+    _block_size(block_size),
+    _len(0),
+    _offs(0),
+    _pos(_io->seekable() ? _io->tell() : -1)
+{
+    assert(block_size > 0);
+    if (!_buf) {
+        throw std::runtime_error("Out of memory while allocating write buffer.");
+    }
+}
+
+BufferedWriter::~BufferedWriter()
+{
+    flush();
+    free(_buf);
+}
+
+intptr_t BufferedWriter::read(void*, const intptr_t)
+{
+    return 0;
+}
+
+intptr_t BufferedWriter::write(const void *buf, const intptr_t len)
+{
+    if (_offs + len <= _block_size) {
+        memcpy(&_buf[_offs], buf, len);
+        _offs += len;
+        if (_offs > _len) {
+            _len = _offs;
+        }
+        return len;
+    }
+
+    if (!flush()) {
+        return 0;
+    }
+
+    if (len >= _block_size) {
+        const intptr_t written = _io->write(buf, len);
+        if (_pos >= 0) {
+            _pos += written;
+        }
+        return written;
+    }
+
+    memcpy(_buf, buf, len);
+    _len = len;
+    _offs = len;
+    return len;
+}
+
+bool BufferedWriter::buffered() const
+{
+    return true;
+}
+
+bool BufferedWriter::seekable() const
+{
+    return _pos >= 0;
+}
+
+intptr_t BufferedWriter::tell() const
+{
+    if (_pos < 0) {
+        return -1;
+    }
+    return _pos + _offs;
+}
+
+intptr_t BufferedWriter::seek(const intptr_t offset)
+{
+    if (_pos < 0) {
+        return -1;
+    }
+    if (offset >= _pos && offset <= _pos + _len) {
+        _offs = offset - _pos;
+        return offset;
+    }
+
+    if (!flush()) {
+        return -1;
+    }
+    _pos = _io->seek(offset);
+    return _pos;
+}
+
+bool BufferedWriter::flush()
+{
+    if (_len == 0) {
+        return true;
+    }
+
+    const intptr_t to_write = _len;
+    const intptr_t offs = _offs;
+    _len = 0;
+    _offs = 0;
+    const bool complete = (_io->write(_buf, to_write) == to_write);
+    if (_pos >= 0) {
+        _pos += offs;
+        if (offs != to_write) {
+            // continue where we have seeked to
+            _pos = _io->seek(_pos);
+        }
+    }
+    return complete;
+}
+
+}
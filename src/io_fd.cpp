@@ -0,0 +1,411 @@
+/**********************************************************************
+File name: io_fd.cpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#include "structstream/io_fd.hpp"
+
+#include <stdexcept>
+
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cassert>
+#include <climits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "structstream/errors.hpp"
+
+namespace StructStream {
+
+static uint8_t *allocate_buffer(intptr_t size)
+{
+    if (size == 0) {
+        return nullptr;
+    }
+    uint8_t *buf = (uint8_t*)malloc(size);
+    if (!buf) {
+        throw std::runtime_error("Out of memory while allocating buffer.");
+    }
+    return buf;
+}
+
+static bool is_regular_file(int fd)
+{
+    struct stat info;
+    return fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+}
+
+/* StructStream::FdInput */
+
+FdInput::FdInput(int fd, bool owns_fd, intptr_t buffer_size):
+    _fd(fd),
+    _owns_fd(owns_fd),
+    _seekable(is_regular_file(fd)),
+    _buf(allocate_buffer(buffer_size)),
+    _buf_size(buffer_size),
+    _len(0),
+    _offs(0)
+{
+
+}
+
+FdInput::FdInput(const std::string &path, intptr_t buffer_size):
+    _fd(open(path.c_str(), O_RDONLY | O_CLOEXEC)),
+    _owns_fd(true),
+    _seekable(false),
+    _buf(nullptr),
+    _buf_size(buffer_size),
+    _len(0),
+    _offs(0)
+{
+    if (_fd < 0) {
+        throw IOError::from_errno("Could not open file for reading");
+    }
+    _seekable = is_regular_file(_fd);
+    try {
+        _buf = allocate_buffer(buffer_size);
+    } catch (...) {
+        close(_fd);
+        throw;
+    }
+}
+
+FdInput::~FdInput()
+{
+    free(_buf);
+    if (_owns_fd) {
+        close(_fd);
+    }
+}
+
+intptr_t FdInput::read_some(uint8_t *dest, intptr_t len)
+{
+    // one call fills the destination and, with what is left over,
+    // the buffer
+    struct iovec iov[2];
+    iov[0].iov_base = dest;
+    iov[0].iov_len = len;
+    iov[1].iov_base = _buf;
+    iov[1].iov_len = _buf_size;
+    const int count = (_buf_size > 0 ? 2 : 1);
+
+    while (true) {
+        const ssize_t result = readv(_fd, iov, count);
+        if (result >= 0) {
+            if (result > len) {
+                _offs = 0;
+                _len = result - len;
+                return len;
+            }
+            return result;
+        }
+        if (errno != EINTR) {
+            throw IOError::from_errno("Could not read from descriptor");
+        }
+    }
+}
+
+void FdInput::fill_buffer(intptr_t len)
+{
+    if (_offs > 0) {
+        memmove(_buf, &_buf[_offs], _len - _offs);
+        _len -= _offs;
+        _offs = 0;
+    }
+
+    while (_len < len) {
+        const ssize_t result = ::read(_fd, &_buf[_len], _buf_size - _len);
+        if (result == 0) {
+            return;
+        } else if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw IOError::from_errno("Could not read from descriptor");
+        }
+        _len += result;
+    }
+}
+
+intptr_t FdInput::read(void *buf, const intptr_t len)
+{
+    uint8_t *dest = (uint8_t*)buf;
+
+    intptr_t done = _len - _offs;
+    if (done >= len) {
+        memcpy(dest, &_buf[_offs], len);
+        _offs += len;
+        return len;
+    }
+    if (done > 0) {
+        memcpy(dest, &_buf[_offs], done);
+    }
+    _offs = _len = 0;
+
+    while (done < len) {
+        const intptr_t result = read_some(&dest[done], len - done);
+        if (result == 0) {
+            break;
+        }
+        done += result;
+    }
+    return done;
+}
+
+intptr_t FdInput::write(const void*, const intptr_t)
+{
+    return 0;
+}
+
+intptr_t FdInput::skip(const intptr_t len)
+{
+    if (_seekable) {
+        return IOIntf::skip(len);
+    }
+
+    intptr_t skipped = _len - _offs;
+    if (skipped >= len) {
+        _offs += len;
+        return len;
+    }
+    _offs = _len = 0;
+
+    intptr_t remaining = len - skipped;
+    if (_buf_size == 0) {
+        return skipped + IOIntf::skip(remaining);
+    }
+    while (remaining > 0) {
+        fill_buffer(1);
+        if (_len == 0) {
+            break;
+        }
+        const intptr_t step = (remaining < _len ? remaining : _len);
+        _offs += step;
+        skipped += step;
+        remaining -= step;
+    }
+    return skipped;
+}
+
+bool FdInput::seekable() const
+{
+    return _seekable;
+}
+
+intptr_t FdInput::tell() const
+{
+    if (!_seekable) {
+        return -1;
+    }
+    const off_t pos = lseek(_fd, 0, SEEK_CUR);
+    if (pos < 0) {
+        throw IOError::from_errno("Could not query descriptor offset");
+    }
+    return pos - (_len - _offs);
+}
+
+intptr_t FdInput::seek(const intptr_t offset)
+{
+    if (!_seekable) {
+        return -1;
+    }
+    const off_t pos = lseek(_fd, 0, SEEK_CUR);
+    if (pos < 0) {
+        throw IOError::from_errno("Could not query descriptor offset");
+    }
+
+    // stay within the buffer if possible
+    const intptr_t buffer_start = pos - _len;
+    if (offset >= buffer_start && offset <= pos) {
+        _offs = offset - buffer_start;
+        return offset;
+    }
+
+    // do not seek beyond the end, so that skip() can tell how much
+    // was actually there
+    struct stat info;
+    if (fstat(_fd, &info) != 0) {
+        throw IOError::from_errno("Could not stat descriptor");
+    }
+    const intptr_t target = (offset < info.st_size ? offset : info.st_size);
+    if (lseek(_fd, target, SEEK_SET) < 0) {
+        throw IOError::from_errno("Could not seek in descriptor");
+    }
+    _offs = _len = 0;
+    return target;
+}
+
+intptr_t FdInput::acquire(const uint8_t **buf, const intptr_t len)
+{
+    if (_len - _offs < len && len <= _buf_size) {
+        // pipes and sockets may not have more data yet, although what
+        // is buffered could be all the caller needs
+        if (_seekable) {
+            fill_buffer(len);
+        } else if (_len == _offs) {
+            fill_buffer(1);
+        }
+    }
+    *buf = &_buf[_offs];
+    return _len - _offs;
+}
+
+void FdInput::commit(const intptr_t len)
+{
+    assert(_offs + len <= _len);
+    _offs += len;
+}
+
+bool FdInput::buffered() const
+{
+    return _buf_size > 0;
+}
+
+/* StructStream::FdOutput */
+
+FdOutput::FdOutput(int fd, bool owns_fd, intptr_t buffer_size):
+    _fd(fd),
+    _owns_fd(owns_fd),
+    _buf(allocate_buffer(buffer_size)),
+    _buf_size(buffer_size),
+    _len(0)
+{
+
+}
+
+FdOutput::FdOutput(const std::string &path, intptr_t buffer_size):
+    _fd(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666)),
+    _owns_fd(true),
+    _buf(nullptr),
+    _buf_size(buffer_size),
+    _len(0)
+{
+    if (_fd < 0) {
+        throw IOError::from_errno("Could not open file for writing");
+    }
+    try {
+        _buf = allocate_buffer(buffer_size);
+    } catch (...) {
+        close(_fd);
+        throw;
+    }
+}
+
+FdOutput::~FdOutput()
+{
+    try {
+        flush();
+    } catch (const IOError&) {
+        // nothing sensible to do here
+    }
+    free(_buf);
+    if (_owns_fd) {
+        close(_fd);
+    }
+}
+
+void FdOutput::write_iov(struct iovec *iov, int count)
+{
+    while (count > 0) {
+        const ssize_t result = writev(_fd, iov, (count < IOV_MAX ? count : IOV_MAX));
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw IOError::from_errno("Could not write to descriptor");
+        }
+
+        // skip over what has been written and retry with the rest
+        size_t written = result;
+        while (count > 0 && written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t*)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+void FdOutput::flush()
+{
+    if (_len == 0) {
+        return;
+    }
+    struct iovec iov;
+    iov.iov_base = _buf;
+    iov.iov_len = _len;
+    _len = 0;
+    write_iov(&iov, 1);
+}
+
+void FdOutput::write_segments(const SegmentedMemory &mem)
+{
+    const std::vector<MemorySegment> &segments = mem.segments();
+    std::vector<struct iovec> iov(segments.size() + 1);
+    iov[0].iov_base = _buf;
+    iov[0].iov_len = _len;
+    for (size_t i = 0; i < segments.size(); i++) {
+        iov[i+1].iov_base = (void*)segments[i].data;
+        iov[i+1].iov_len = segments[i].len;
+    }
+    _len = 0;
+    write_iov(iov.data(), iov.size());
+}
+
+intptr_t FdOutput::read(void*, const intptr_t)
+{
+    return 0;
+}
+
+intptr_t FdOutput::write(const void *buf, const intptr_t len)
+{
+    if (_len + len <= _buf_size) {
+        memcpy(&_buf[_len], buf, len);
+        _len += len;
+        return len;
+    }
+
+    struct iovec iov[2];
+    iov[0].iov_base = _buf;
+    iov[0].iov_len = _len;
+    iov[1].iov_base = (void*)buf;
+    iov[1].iov_len = len;
+    _len = 0;
+    write_iov(iov, 2);
+    return len;
+}
+
+bool FdOutput::buffered() const
+{
+    return _buf_size > 0;
+}
+
+}
@@ -31,44 +31,87 @@ authors named in the AUTHORS file.
 #include <cstring>
 #include <cassert>
 
+#include "structstream/errors.hpp"
+
 namespace StructStream {
 
+static const uint8_t *copy_buffer(const uint8_t *srcbuf, const intptr_t len)
+{
+    uint8_t *buf = (uint8_t*)malloc(len);
+    memcpy(buf, srcbuf, len);
+    return buf;
+}
+
 ReadableMemory::ReadableMemory(const uint8_t *srcbuf, const intptr_t len):
-    _buf((uint8_t*)malloc(len)),
+    _buf(copy_buffer(srcbuf, len)),
     _len(len),
-    _offs(0)
+    _offs(0),
+    _owned(true)
 {
-    memcpy(_buf, srcbuf, len);
+
 }
 
 ReadableMemory::ReadableMemory(const ReadableMemory &ref):
-    _buf((uint8_t*)malloc(ref._len)),
+    _buf(copy_buffer(ref._buf, ref._len)),
     _len(ref._len),
-    _offs(0)
+    _offs(0),
+    _owned(true)
+{
+
+}
+
+const uint8_t *ReadableMemory::copy_segments(const WritableMemory &ref)
 {
-    memcpy(_buf, ref._buf, _len);
+    // copy the segments directly instead of merging them first
+    const SegmentedMemory *segmented = ref.segmented();
+    if (!segmented) {
+        return copy_buffer(ref._buf, ref.size());
+    }
+
+    uint8_t *buf = (uint8_t*)malloc(ref.size());
+    uint8_t *dest = buf;
+    for (auto &segment: segmented->segments()) {
+        memcpy(dest, segment.data, segment.len);
+        dest += segment.len;
+    }
+    return buf;
 }
 
 ReadableMemory::ReadableMemory(const WritableMemory &ref):
-    _buf((uint8_t*)malloc(ref.size())),
+    _buf(copy_segments(ref)),
     _len(ref.size()),
-    _offs(0)
+    _offs(0),
+    _owned(true)
+{
+
+}
+
+ReadableMemory::ReadableMemory(const uint8_t *srcbuf, const intptr_t len,
+                               bool copy):
+    _buf(copy ? copy_buffer(srcbuf, len) : srcbuf),
+    _len(len),
+    _offs(0),
+    _owned(copy)
 {
-    memcpy(_buf, ref.buffer(), _len);
+
 }
 
 ReadableMemory::~ReadableMemory()
 {
-    free(_buf);
+    if (_owned) {
+        free((void*)_buf);
+    }
 }
 
 ReadableMemory& ReadableMemory::operator=(const ReadableMemory &ref)
 {
-    free(_buf);
-    _buf = (uint8_t*)malloc(ref._len);
+    if (_owned) {
+        free((void*)_buf);
+    }
+    _buf = copy_buffer(ref._buf, ref._len);
     _len = ref._len;
     _offs = ref._offs;
-    memcpy(_buf, ref._buf, _len);
+    _owned = true;
     return *this;
 }
 
@@ -81,7 +124,7 @@ intptr_t ReadableMemory::read(void *buf, const intptr_t len)
             return 0;
         }
     }
-    memmove(buf, &((unsigned char*)_buf)[_offs], to_read);
+    memmove(buf, &_buf[_offs], to_read);
     _offs += to_read;
     return to_read;
 }
@@ -91,15 +134,96 @@ intptr_t ReadableMemory::write(const void *buf, const intptr_t len)
     return 0;
 }
 
+intptr_t ReadableMemory::acquire(const uint8_t **buf, const intptr_t)
+{
+    *buf = &_buf[_offs];
+    return _len - _offs;
+}
+
+void ReadableMemory::commit(const intptr_t len)
+{
+    assert(_offs + len <= _len);
+    _offs += len;
+}
+
+bool ReadableMemory::contiguous() const
+{
+    return true;
+}
+
+bool ReadableMemory::seekable() const
+{
+    return true;
+}
+
+intptr_t ReadableMemory::tell() const
+{
+    return _offs;
+}
+
+intptr_t ReadableMemory::seek(const intptr_t offset)
+{
+    assert(offset >= 0);
+    _offs = (offset < _len ? offset : _len);
+    return _offs;
+}
+
+/* StructStream::MemoryView */
+
+MemoryView::MemoryView(const uint8_t *srcbuf, const intptr_t len):
+    ReadableMemory(srcbuf, len, false)
+{
+
+}
+
+MemoryView::MemoryView(const MemoryView &ref):
+    ReadableMemory(ref.buffer(), ref.size(), false)
+{
+
+}
+
+MemoryView::MemoryView(const ReadableMemory &ref):
+    ReadableMemory(ref.buffer(), ref.size(), false)
+{
+
+}
+
+const uint8_t *ReadableMemory::view_segments(const WritableMemory &ref)
+{
+    // buffer() would merge the segments, which is a copy
+    const SegmentedMemory *segmented = ref.segmented();
+    if (!segmented) {
+        return ref._buf;
+    }
+    const std::vector<MemorySegment> &segments = segmented->segments();
+    if (segments.size() > 1) {
+        throw UnsupportedInput("Cannot view a WritableMemory spanning several segments.");
+    }
+    return (segments.empty() ? nullptr : segments[0].data);
+}
+
+MemoryView::MemoryView(const WritableMemory &ref):
+    ReadableMemory(view_segments(ref), ref.size(), false)
+{
+
+}
+
+MemoryView& MemoryView::operator=(const MemoryView &ref)
+{
+    if (_owned) {
+        free((void*)_buf);
+    }
+    _buf = ref._buf;
+    _len = ref._len;
+    _offs = ref._offs;
+    _owned = false;
+    return *this;
+}
+
 /* StructStream::WritableMemory */
 
 WritableMemory::WritableMemory():
-    _buf(),
-    _buf_size(0),
-    _outward_size(0),
-    _offs(0),
-    _blank_pattern(0xdeadbeef),
-    _may_grow(true)
+    WritableMemory(SegmentPool::default_pool())
 {
 
 }
@@ -110,7 +234,8 @@ WritableMemory::WritableMemory(uint8_t *buf, const intptr_t len):
     _outward_size(0),
     _offs(0),
     _blank_pattern(0),
-    _may_grow(false)
+    _may_grow(false),
+    _segments(nullptr)
 {
 
 }
@@ -121,41 +246,37 @@ WritableMemory::WritableMemory(const uint32_t blank_pattern):
     _outward_size(0),
     _offs(0),
     _blank_pattern(blank_pattern),
-    _may_grow(true)
+    _may_grow(true),
+    _segments(new SegmentedMemory())
+{
+
+}
+
+WritableMemory::WritableMemory(SegmentPoolHandle pool):
+    _buf(),
+    _buf_size(0),
+    _outward_size(0),
+    _offs(0),
+    _blank_pattern(0xdeadbeef),
+    _may_grow(true),
+    _segments(new SegmentedMemory(pool))
 {
 
 }
 
 WritableMemory::~WritableMemory()
 {
-    if (_buf && _may_grow) {
-        free(_buf);
+    if (_segments) {
+        delete _segments;
     }
 }
 
-void WritableMemory::grow()
+const uint8_t *WritableMemory::buffer()
 {
-    assert(_may_grow);
-    assert(_buf_size % sizeof(_blank_pattern) == 0);
-
-    const intptr_t new_size = _buf_size + 1024*sizeof(_blank_pattern);
-    uint8_t *new_buf = (uint8_t*)realloc(_buf, new_size);
-    if (!new_buf) {
-        free(_buf);
-        _buf = nullptr;
-        _buf_size = 0;
-        throw std::runtime_error("Out of memory during grow().");
+    if (_segments) {
+        return _segments->flatten();
     }
-
-    _buf = new_buf;
-
-    // uint32_t *fillat = (uint32_t*)(&((uint8_t*)_buf)[_buf_size]);
-    // const uint32_t *end = (uint32_t*)(&((uint8_t*)_buf)[new_size]);
-    // while (fillat < end) {
-    //     *fillat++ = _blank_pattern;
-    // }
-
-    _buf_size = new_size;
+    return _buf;
 }
 
 intptr_t WritableMemory::read(void*, const intptr_t)
@@ -165,14 +286,16 @@ intptr_t WritableMemory::read(void*, const intptr_t)
 
 intptr_t WritableMemory::write(const void *buf, const intptr_t len)
 {
+    if (_may_grow) {
+        _segments->write(buf, len);
+        _outward_size += len;
+        _offs += len;
+        return len;
+    }
+
     intptr_t to_write = len;
-    while (to_write + _offs >= _buf_size)
-    {
-        if (!_may_grow) {
-            to_write = _buf_size - _offs;
-            break;
-        }
-        grow();
+    if (to_write + _offs >= _buf_size) {
+        to_write = _buf_size - _offs;
     }
 
     if (to_write == 0) {
@@ -187,8 +310,11 @@ intptr_t WritableMemory::write(const void *buf, const intptr_t len)
 
 uint8_t *WritableMemory::release_buffer(intptr_t &len)
 {
-    len = _outward_size;
     uint8_t *result = _buf;
+    if (_segments) {
+        result = _segments->release_buffer(len);
+    }
+    len = _outward_size;
     _buf = nullptr;
     _buf_size = 0;
     _outward_size = 0;
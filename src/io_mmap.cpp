@@ -0,0 +1,182 @@
+/**********************************************************************
+File name: io_mmap.cpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#include "structstream/io_mmap.hpp"
+
+#include <cstring>
+#include <cerrno>
+#include <cassert>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "structstream/errors.hpp"
+
+namespace StructStream {
+
+/* StructStream::MappedFile */
+
+MappedFile::MappedFile(const std::string &path, AccessHint hint):
+    _buf(nullptr),
+    _len(0),
+    _offs(0)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw IOError::from_errno("Could not open file for mapping");
+    }
+
+    try {
+        map_fd(fd);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+
+    advise(hint);
+}
+
+MappedFile::MappedFile(int fd, AccessHint hint):
+    _buf(nullptr),
+    _len(0),
+    _offs(0)
+{
+    map_fd(fd);
+    advise(hint);
+}
+
+MappedFile::~MappedFile()
+{
+    if (_buf) {
+        munmap(_buf, _len);
+    }
+}
+
+void MappedFile::map_fd(int fd)
+{
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        throw IOError::from_errno("Could not stat file for mapping");
+    }
+
+    _len = info.st_size;
+    if (_len == 0) {
+        // mmap refuses empty mappings
+        return;
+    }
+
+    void *mapping = mmap(nullptr, _len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        _len = 0;
+        throw IOError::from_errno("Could not map file");
+    }
+    _buf = (uint8_t*)mapping;
+}
+
+void MappedFile::advise(AccessHint hint)
+{
+    if (!_buf) {
+        return;
+    }
+
+    int advice = MADV_NORMAL;
+    if (hint == Sequential) {
+        advice = MADV_SEQUENTIAL;
+    } else if (hint == Random) {
+        advice = MADV_RANDOM;
+    }
+
+    // this is only a hint, failing is not an error
+    madvise(_buf, _len, advice);
+}
+
+intptr_t MappedFile::read(void *buf, const intptr_t len)
+{
+    intptr_t to_read = len;
+    if (to_read > _len - _offs) {
+        to_read = _len - _offs;
+    }
+    if (to_read <= 0) {
+        // empty files are not mapped at all, _buf is null
+        return 0;
+    }
+    memcpy(buf, &_buf[_offs], to_read);
+    _offs += to_read;
+    return to_read;
+}
+
+intptr_t MappedFile::write(const void*, const intptr_t)
+{
+    return 0;
+}
+
+intptr_t MappedFile::skip(const intptr_t len)
+{
+    intptr_t to_skip = len;
+    if (to_skip > _len - _offs) {
+        to_skip = _len - _offs;
+    }
+    _offs += to_skip;
+    return to_skip;
+}
+
+intptr_t MappedFile::acquire(const uint8_t **buf, const intptr_t)
+{
+    *buf = _buf + _offs;
+    return _len - _offs;
+}
+
+void MappedFile::commit(const intptr_t len)
+{
+    assert(_offs + len <= _len);
+    _offs += len;
+}
+
+bool MappedFile::contiguous() const
+{
+    return true;
+}
+
+bool MappedFile::seekable() const
+{
+    return true;
+}
+
+intptr_t MappedFile::tell() const
+{
+    return _offs;
+}
+
+intptr_t MappedFile::seek(const intptr_t offset)
+{
+    assert(offset >= 0);
+    _offs = (offset < _len ? offset : _len);
+    return _offs;
+}
+
+}
@@ -0,0 +1,337 @@
+/**********************************************************************
+File name: io_pipe.cpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#include "structstream/io_pipe.hpp"
+
+#include <stdexcept>
+#include <thread>
+
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+
+namespace StructStream {
+
+static uint64_t round_up_to_power_of_two(intptr_t value)
+{
+    uint64_t result = 1;
+    while (result < (uint64_t)value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+/* StructStream::RingPipe */
+
+RingPipe::RingPipe(intptr_t capacity, WaitPolicy policy):
+    _buf(nullptr),
+    _capacity(round_up_to_power_of_two(capacity)),
+    _policy(policy),
+    _head(0),
+    _tail(0),
+    _write_closed(false),
+    _read_closed(false),
+    _lock(),
+    _wakeup(),
+    _reader_waiting(false),
+    _writer_waiting(false)
+{
+    _buf = (uint8_t*)malloc(_capacity);
+    if (!_buf) {
+        throw std::runtime_error("Out of memory while allocating pipe.");
+    }
+}
+
+RingPipe::~RingPipe()
+{
+    free(_buf);
+}
+
+void RingPipe::wake(std::atomic<bool> &waiting)
+{
+    // the other side sets its flag before checking the positions
+    // once more under the lock, so either it sees our update or we
+    // see the flag
+    if (_policy == Block && waiting.load()) {
+        std::lock_guard<std::mutex> guard(_lock);
+        _wakeup.notify_all();
+    }
+}
+
+uint64_t RingPipe::wait_for_data(uint64_t amount)
+{
+    const uint64_t head = _head.load(std::memory_order_relaxed);
+    uint64_t available = _tail.load(std::memory_order_acquire) - head;
+    if (available >= amount) {
+        return available;
+    }
+
+    if (_policy == Spin) {
+        while (true) {
+            // check for closing first, so that data written right
+            // before is not missed
+            const bool closed = _write_closed.load(std::memory_order_acquire);
+            available = _tail.load(std::memory_order_acquire) - head;
+            if (available >= amount || closed) {
+                return available;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    std::unique_lock<std::mutex> guard(_lock);
+    _reader_waiting.store(true);
+    while (true) {
+        const bool closed = _write_closed.load();
+        available = _tail.load() - head;
+        if (available >= amount || closed) {
+            break;
+        }
+        _wakeup.wait(guard);
+    }
+    _reader_waiting.store(false);
+    return available;
+}
+
+uint64_t RingPipe::wait_for_space()
+{
+    const uint64_t tail = _tail.load(std::memory_order_relaxed);
+    uint64_t space = _capacity - (tail - _head.load(std::memory_order_acquire));
+    if (space > 0) {
+        return space;
+    }
+
+    if (_policy == Spin) {
+        while (true) {
+            const bool closed = _read_closed.load(std::memory_order_acquire);
+            space = _capacity - (tail - _head.load(std::memory_order_acquire));
+            if (space > 0 || closed) {
+                return space;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    std::unique_lock<std::mutex> guard(_lock);
+    _writer_waiting.store(true);
+    while (true) {
+        const bool closed = _read_closed.load();
+        space = _capacity - (tail - _head.load());
+        if (space > 0 || closed) {
+            break;
+        }
+        _wakeup.wait(guard);
+    }
+    _writer_waiting.store(false);
+    return space;
+}
+
+intptr_t RingPipe::read(void *buf, const intptr_t len)
+{
+    uint8_t *dest = (uint8_t*)buf;
+    intptr_t done = 0;
+    while (done < len) {
+        const intptr_t result = read_available(&dest[done], len - done, true);
+        if (result == 0) {
+            // closed and drained
+            break;
+        }
+        done += result;
+    }
+    return done;
+}
+
+intptr_t RingPipe::read_available(void *buf, const intptr_t len, const bool wait)
+{
+    if (len <= 0) {
+        return 0;
+    }
+
+    const uint64_t available = wait_for_data(wait ? 1 : 0);
+    if (available == 0) {
+        return 0;
+    }
+
+    uint8_t *dest = (uint8_t*)buf;
+    const uint64_t head = _head.load(std::memory_order_relaxed);
+    const uint64_t offs = head & (_capacity - 1);
+    uint64_t amount = len;
+    if (amount > available) {
+        amount = available;
+    }
+    uint64_t first = _capacity - offs;
+    if (first > amount) {
+        first = amount;
+    }
+    memcpy(dest, &_buf[offs], first);
+    memcpy(&dest[first], _buf, amount - first);
+
+    _head.store(head + amount);
+    wake(_writer_waiting);
+    return amount;
+}
+
+intptr_t RingPipe::write(const void *buf, const intptr_t len)
+{
+    const uint8_t *src = (const uint8_t*)buf;
+    intptr_t done = 0;
+    while (done < len) {
+        if (_read_closed.load(std::memory_order_relaxed)) {
+            break;
+        }
+        const uint64_t space = wait_for_space();
+        if (space == 0) {
+            break;
+        }
+
+        const uint64_t tail = _tail.load(std::memory_order_relaxed);
+        const uint64_t offs = tail & (_capacity - 1);
+        uint64_t amount = len - done;
+        if (amount > space) {
+            amount = space;
+        }
+        uint64_t first = _capacity - offs;
+        if (first > amount) {
+            first = amount;
+        }
+        memcpy(&_buf[offs], &src[done], first);
+        memcpy(_buf, &src[done+first], amount - first);
+
+        _tail.store(tail + amount);
+        wake(_reader_waiting);
+        done += amount;
+    }
+    return done;
+}
+
+intptr_t RingPipe::acquire(const uint8_t **buf, const intptr_t len)
+{
+    // callers ask for more than they may need (e.g. a whole varuint
+    // word), so waiting for all of it could stall on a complete record
+    const uint64_t available = wait_for_data(len > 0 ? 1 : 0);
+
+    const uint64_t offs = _head.load(std::memory_order_relaxed) & (_capacity - 1);
+    *buf = &_buf[offs];
+    if (available > _capacity - offs) {
+        return _capacity - offs;
+    }
+    return available;
+}
+
+void RingPipe::commit(const intptr_t len)
+{
+    const uint64_t head = _head.load(std::memory_order_relaxed);
+    assert(head + len <= _tail.load());
+    _head.store(head + len);
+    wake(_writer_waiting);
+}
+
+void RingPipe::close_write()
+{
+    _write_closed.store(true);
+    wake(_reader_waiting);
+}
+
+void RingPipe::close_read()
+{
+    _read_closed.store(true);
+    wake(_writer_waiting);
+}
+
+/* StructStream::PipeReadEnd */
+
+PipeReadEnd::PipeReadEnd(RingPipeHandle pipe):
+    _pipe_h(pipe),
+    _pipe(pipe.get())
+{
+
+}
+
+PipeReadEnd::~PipeReadEnd()
+{
+    _pipe->close_read();
+}
+
+intptr_t PipeReadEnd::read(void *buf, const intptr_t len)
+{
+    return _pipe->read(buf, len);
+}
+
+intptr_t PipeReadEnd::write(const void*, const intptr_t)
+{
+    return 0;
+}
+
+intptr_t PipeReadEnd::acquire(const uint8_t **buf, const intptr_t len)
+{
+    return _pipe->acquire(buf, len);
+}
+
+void PipeReadEnd::commit(const intptr_t len)
+{
+    _pipe->commit(len);
+}
+
+bool PipeReadEnd::buffered() const
+{
+    return true;
+}
+
+intptr_t PipeReadEnd::read_available(void *buf, const intptr_t len,
+                                     const bool wait)
+{
+    return _pipe->read_available(buf, len, wait);
+}
+
+/* StructStream::PipeWriteEnd */
+
+PipeWriteEnd::PipeWriteEnd(RingPipeHandle pipe):
+    _pipe_h(pipe),
+    _pipe(pipe.get())
+{
+
+}
+
+PipeWriteEnd::~PipeWriteEnd()
+{
+    close();
+}
+
+void PipeWriteEnd::close()
+{
+    _pipe->close_write();
+}
+
+intptr_t PipeWriteEnd::read(void*, const intptr_t)
+{
+    return 0;
+}
+
+intptr_t PipeWriteEnd::write(const void *buf, const intptr_t len)
+{
+    return _pipe->write(buf, len);
+}
+
+}
@@ -0,0 +1,247 @@
+/**********************************************************************
+File name: io_segmented.cpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#include "structstream/io_segmented.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+
+namespace StructStream {
+
+/* StructStream::SegmentPool */
+
+SegmentPool::SegmentPool(intptr_t segment_size, intptr_t max_idle):
+    _segment_size(segment_size),
+    _max_idle(max_idle),
+    _lock(),
+    _idle()
+{
+    assert(segment_size > 0);
+}
+
+SegmentPool::~SegmentPool()
+{
+    for (auto segment: _idle) {
+        free(segment);
+    }
+}
+
+uint8_t *SegmentPool::allocate()
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (!_idle.empty()) {
+            uint8_t *segment = _idle.back();
+            _idle.pop_back();
+            return segment;
+        }
+    }
+
+    uint8_t *segment = (uint8_t*)malloc(_segment_size);
+    if (!segment) {
+        throw std::runtime_error("Out of memory while allocating segment.");
+    }
+    return segment;
+}
+
+void SegmentPool::release(uint8_t *segment)
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if ((intptr_t)_idle.size() < _max_idle) {
+            _idle.push_back(segment);
+            return;
+        }
+    }
+    free(segment);
+}
+
+SegmentPoolHandle SegmentPool::default_pool()
+{
+    static SegmentPoolHandle pool(new SegmentPool());
+    return pool;
+}
+
+/* StructStream::SegmentedMemory */
+
+SegmentedMemory::SegmentedMemory(SegmentPoolHandle pool):
+    _pool_h(pool),
+    _chunks(),
+    _segments(),
+    _size(0)
+{
+
+}
+
+SegmentedMemory::~SegmentedMemory()
+{
+    release_chunks();
+}
+
+void SegmentedMemory::release_chunks()
+{
+    for (auto &chunk: _chunks) {
+        if (chunk.pooled) {
+            _pool_h->release(chunk.data);
+        } else {
+            free(chunk.data);
+        }
+    }
+    _chunks.clear();
+    _segments.clear();
+}
+
+const uint8_t *SegmentedMemory::flatten()
+{
+    if (_segments.size() == 0) {
+        return nullptr;
+    }
+    if (_segments.size() == 1) {
+        return _segments[0].data;
+    }
+
+    // grow the first chunk into the block, so that its data stays in
+    // place (unless realloc() moves it) and only the other segments
+    // are copied. The capacity at least doubles, which keeps repeated
+    // write() and flatten() calls linear; writes go to the spare room
+    // of the block until it is full.
+    Chunk &first = _chunks[0];
+    const intptr_t capacity = std::max(_size, 2*first.capacity);
+    uint8_t *block = (uint8_t*)realloc(first.data, capacity);
+    if (!block) {
+        throw std::runtime_error("Out of memory during flatten().");
+    }
+    first.data = block;
+    first.capacity = capacity;
+    first.pooled = false;
+
+    uint8_t *dest = block + _segments[0].len;
+    for (size_t i = 1; i < _segments.size(); i++) {
+        memcpy(dest, _segments[i].data, _segments[i].len);
+        dest += _segments[i].len;
+
+        Chunk &chunk = _chunks[i];
+        if (chunk.pooled) {
+            _pool_h->release(chunk.data);
+        } else {
+            free(chunk.data);
+        }
+    }
+
+    _chunks.resize(1);
+    _segments.resize(1);
+    _segments[0] = MemorySegment{block, _size};
+    return block;
+}
+
+void SegmentedMemory::clear()
+{
+    release_chunks();
+    _size = 0;
+}
+
+void SegmentedMemory::splice(SegmentedMemory &other)
+{
+    for (size_t i = 0; i < other._chunks.size(); i++) {
+        Chunk &chunk = other._chunks[i];
+        const MemorySegment &segment = other._segments[i];
+        if (2*segment.len < chunk.capacity) {
+            write(segment.data, segment.len);
+            if (chunk.pooled) {
+                other._pool_h->release(chunk.data);
+            } else {
+                free(chunk.data);
+            }
+            continue;
+        }
+
+        // chunks of another pool may not fit ours, but may be freed
+        if (chunk.pooled && other._pool_h != _pool_h) {
+            chunk.pooled = false;
+        }
+        _chunks.push_back(chunk);
+        _segments.push_back(segment);
+        _size += segment.len;
+    }
+
+    other._chunks.clear();
+    other._segments.clear();
+    other._size = 0;
+}
+
+uint8_t *SegmentedMemory::release_buffer(intptr_t &len)
+{
+    flatten();
+    len = _size;
+
+    uint8_t *result = nullptr;
+    if (!_chunks.empty()) {
+        // pooled chunks come from malloc() too and may be handed out
+        result = _chunks[0].data;
+        _chunks.clear();
+        _segments.clear();
+    }
+    _size = 0;
+    return result;
+}
+
+intptr_t SegmentedMemory::read(void*, const intptr_t)
+{
+    return 0;
+}
+
+intptr_t SegmentedMemory::write(const void *buf, const intptr_t len)
+{
+    const uint8_t *src = (const uint8_t*)buf;
+    intptr_t remaining = len;
+    while (remaining > 0) {
+        intptr_t space = 0;
+        if (!_chunks.empty()) {
+            space = _chunks.back().capacity - _segments.back().len;
+        }
+        if (space == 0) {
+            uint8_t *data = _pool_h->allocate();
+            _chunks.push_back(Chunk{data, _pool_h->segment_size(), true});
+            _segments.push_back(MemorySegment{data, 0});
+            space = _pool_h->segment_size();
+        }
+
+        MemorySegment &segment = _segments.back();
+        const intptr_t to_write = (remaining < space ? remaining : space);
+        memcpy(_chunks.back().data + segment.len, src, to_write);
+        segment.len += to_write;
+        src += to_write;
+        remaining -= to_write;
+    }
+
+    _size += len;
+    return len;
+}
+
+}
@@ -38,11 +38,9 @@ StandardInputStream::StandardInputStream(std::istream &in):
 intptr_t StandardInputStream::read(void *buf, const intptr_t len)
 {
     _in.read((char*)buf, len);
-    if (!_in.good()) {
-        return 0;
-    } else {
-        return len;
-    }
+    // a short read sets eof and fail, but gcount() still tells us how
+    // much we got
+    return _in.gcount();
 }
 
 intptr_t StandardInputStream::write(const void*, const intptr_t)
@@ -50,6 +48,70 @@ intptr_t StandardInputStream::write(const void*, const intptr_t)
     return 0;
 }
 
+intptr_t StandardInputStream::read_available(void *buf, const intptr_t len,
+                                             const bool wait)
+{
+    char *dest = (char*)buf;
+    if (len <= 0) {
+        return 0;
+    }
+
+    intptr_t done = _in.readsome(dest, len);
+    if (done == 0 && wait) {
+        // nothing buffered (or the buffer does not tell): block for a
+        // single byte, which usually pulls in whatever has arrived
+        _in.read(dest, 1);
+        done = _in.gcount();
+        if (done > 0) {
+            done += _in.readsome(&dest[done], len - done);
+        }
+    }
+    return done;
+}
+
+bool StandardInputStream::seekable() const
+{
+    return tell() >= 0;
+}
+
+intptr_t StandardInputStream::tell() const
+{
+    // a short read leaves eof and fail set, which make tellg() fail;
+    // ask the buffer directly instead of clearing the caller's state
+    std::streambuf *buf = _in.rdbuf();
+    if (!buf) {
+        return -1;
+    }
+    return (intptr_t)buf->pubseekoff(0, std::ios_base::cur, std::ios_base::in);
+}
+
+intptr_t StandardInputStream::seek(const intptr_t offset)
+{
+    // like tell(), go to the buffer, which ignores the stream state
+    std::streambuf *buf = _in.rdbuf();
+    if (!buf) {
+        return -1;
+    }
+    const intptr_t end = (intptr_t)buf->pubseekoff(
+        0, std::ios_base::end, std::ios_base::in);
+    if (end < 0) {
+        return end;
+    }
+
+    const intptr_t target = (offset < end ? offset : end);
+    if ((intptr_t)buf->pubseekpos(target, std::ios_base::in) != target) {
+        return -1;
+    }
+
+    // seekg() drops eofbit as well; a short read at the end also sets
+    // failbit, which would keep further reads from succeeding. Other
+    // errors are the caller's and are kept.
+    if (_in.eof()) {
+        _in.clear(_in.rdstate() & ~(std::ios_base::eofbit | std::ios_base::failbit));
+    }
+    return target;
+}
+
 /* StructStream::StandardOutputStream */
 
 StandardOutputStream::StandardOutputStream(std::ostream &out):
@@ -73,4 +135,27 @@ intptr_t StandardOutputStream::write(const void *buf, const intptr_t len)
     }
 }
 
+bool StandardOutputStream::seekable() const
+{
+    return tell() >= 0;
+}
+
+intptr_t StandardOutputStream::tell() const
+{
+    std::streambuf *buf = _out.rdbuf();
+    if (!buf) {
+        return -1;
+    }
+    return (intptr_t)buf->pubseekoff(0, std::ios_base::cur, std::ios_base::out);
+}
+
+intptr_t StandardOutputStream::seek(const intptr_t offset)
+{
+    std::streambuf *buf = _out.rdbuf();
+    if (!buf) {
+        return -1;
+    }
+    return (intptr_t)buf->pubseekpos(offset, std::ios_base::out);
+}
+
 }
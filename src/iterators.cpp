@@ -70,7 +70,7 @@ NodeTreeIterator& NodeTreeIterator::operator++()
         delete _nested_iter;
         _nested_iter = nullptr;
     } else {
-        ContainerHandle cont = std::dynamic_pointer_cast<Container>(*_cont_iter);
+        ContainerHandle cont = node_cast<Container>(*_cont_iter);
         if (cont) {
             _nested_iter = new NodeTreeIterator(cont);
             if (_nested_iter->valid()) {
@@ -174,8 +174,7 @@ void FindMostShallow::advance()
 
 FindMostShallow& FindMostShallow::operator++()
 {
-    ContainerHandle cont = std::dynamic_pointer_cast<Container>(*_iter);
-    if (cont.get()) {
+    if ((*_iter)->is_container()) {
         // printf("fms 0x%lx: ++: is a container (skipping over)\n", (intptr_t)this);
         _iter.skip();
     } else {
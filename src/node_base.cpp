@@ -34,9 +34,11 @@ namespace StructStream {
 
 /* StructStream::Node */
 
-Node::Node(ID id):
+Node::Node(ID id, NodeKind kind):
     _self(),
     _id(id),
+    _kind(kind),
+    _class_tag(nullptr),
     _parent()
 {
 
@@ -45,6 +47,8 @@ Node::Node(ID id):
 Node::Node(const Node &ref):
     _self(),
     _id(ref._id),
+    _kind(ref._kind),
+    _class_tag(nullptr),
     _parent()
 {
 
@@ -77,8 +81,20 @@ void Node::detach_from_parent() {
 
 void Node::write_header(IOIntf *stream) const
 {
-    Utils::write_record_type(stream, record_type());
-    Utils::write_id(stream, _id);
+    uint8_t header[max_header_size];
+    swrite(stream, header, encode_header(header));
+}
+
+intptr_t Node::encode_header(uint8_t *dest) const
+{
+    return encode_header(dest, record_type(), _id);
+}
+
+intptr_t Node::encode_header(uint8_t *dest, RecordType rt, ID id)
+{
+    intptr_t len = Utils::encode_varuint(dest, rt);
+    len += Utils::encode_varuint(&dest[len], id);
+    return len;
 }
 
 NodeHandle Node::shallow_copy() const
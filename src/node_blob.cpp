@@ -46,15 +46,23 @@ void UTF8Record::read(IOIntf *stream)
 
     allocate_length(length);
 
-    sread(stream, _buf, size()-1);
+    read_payload(stream, size()-1);
     ((char*)_buf)[length-1] = 0;
 }
 
 void UTF8Record::write(IOIntf *stream) const
 {
-    write_header(stream);
-    Utils::write_varint(stream, _len-1);
-    swrite(stream, _buf, _len-1);
+    write_value(stream, _id, (const char*)_buf, _len-1);
+}
+
+void UTF8Record::write_value(IOIntf *stream, ID id,
+                             const char *data, intptr_t len)
+{
+    uint8_t header[max_header_size + Utils::max_varint_size];
+    intptr_t header_len = encode_header(header, RT_UTF8STRING, id);
+    header_len += Utils::encode_varint(&header[header_len], len);
+    swrite(stream, header, header_len);
+    swrite(stream, data, len);
 }
 
 /* StructStream::BlobRecord */
@@ -72,14 +80,22 @@ NodeHandle BlobRecord::copy() const
 void BlobRecord::read(IOIntf *stream) {
     VarInt length = read_and_check_length(stream);
     allocate_length(length);
-    sread(stream, _buf, size());
+    read_payload(stream, size());
 }
 
 void BlobRecord::write(IOIntf *stream) const
 {
-    write_header(stream);
-    Utils::write_varint(stream, _len);
-    swrite(stream, _buf, _len);
+    write_value(stream, _id, (const char*)_buf, _len);
+}
+
+void BlobRecord::write_value(IOIntf *stream, ID id,
+                             const char *data, intptr_t len)
+{
+    uint8_t header[max_header_size + Utils::max_varint_size];
+    intptr_t header_len = encode_header(header, RT_BLOB, id);
+    header_len += Utils::encode_varint(&header[header_len], len);
+    swrite(stream, header, header_len);
+    swrite(stream, data, len);
 }
 
 }
@@ -34,7 +34,7 @@ namespace StructStream {
 /* StructStream::Container */
 
 Container::Container(ID id):
-    Node::Node(id),
+    Node::Node(id, NK_CONTAINER),
     _validated(false),
     _hash_function(HT_NONE),
     _children(),
@@ -44,7 +44,7 @@ Container::Container(ID id):
 }
 
 Container::Container(ID id, std::initializer_list<NodeHandle> children):
-    Node::Node(id),
+    Node::Node(id, NK_CONTAINER),
     _validated(false),
     _hash_function(HT_NONE),
     _children(),
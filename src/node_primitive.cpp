@@ -75,6 +75,13 @@ void BoolRecord::write(IOIntf *stream) const
     write_header(stream);
 }
 
+void BoolRecord::write_value(IOIntf *stream, ID id, bool value)
+{
+    uint8_t header[max_header_size];
+    swrite(stream, header,
+           encode_header(header, (value ? RT_BOOL_TRUE : RT_BOOL_FALSE), id));
+}
+
 RecordType BoolRecord::record_type() const
 {
     return (_data ? RT_BOOL_TRUE : RT_BOOL_FALSE);
@@ -47,8 +47,16 @@ void VarIntRecord::read(IOIntf *stream)
 
 void VarIntRecord::write(IOIntf *stream) const
 {
-    write_header(stream);
-    Utils::write_varint(stream, _data);
+    write_value(stream, record_type(), _id, _data);
+}
+
+void VarIntRecord::write_value(IOIntf *stream, RecordType as_rt,
+                               ID id, VarInt value)
+{
+    uint8_t buf[max_header_size + Utils::max_varint_size];
+    intptr_t len = encode_header(buf, as_rt, id);
+    len += Utils::encode_varint(&buf[len], value);
+    swrite(stream, buf, len);
 }
 
 /* StructStream::VarUIntRecord */
@@ -71,8 +79,16 @@ void VarUIntRecord::read(IOIntf *stream)
 
 void VarUIntRecord::write(IOIntf *stream) const
 {
-    write_header(stream);
-    Utils::write_varuint(stream, _data);
+    write_value(stream, record_type(), _id, _data);
+}
+
+void VarUIntRecord::write_value(IOIntf *stream, RecordType as_rt,
+                                ID id, VarUInt value)
+{
+    uint8_t buf[max_header_size + Utils::max_varint_size];
+    intptr_t len = encode_header(buf, as_rt, id);
+    len += Utils::encode_varuint(&buf[len], value);
+    swrite(stream, buf, len);
 }
 
 
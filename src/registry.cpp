@@ -25,6 +25,8 @@ authors named in the AUTHORS file.
 **********************************************************************/
 #include "structstream/registry.hpp"
 
+#include <algorithm>
+
 #include "structstream/node_container.hpp"
 #include "structstream/node_primitive.hpp"
 #include "structstream/node_blob.hpp"
@@ -41,20 +43,25 @@ NodeHandle create_boolean(ID id)
 }
 
 Registry::Registry():
+    _flat_record_types(),
     _record_types()
 {
     register_defaults();
 }
 
 Registry::Registry(const Registry &ref):
+    _flat_record_types(),
     _record_types(ref._record_types)
 {
-
+    std::copy(&ref._flat_record_types[0],
+              &ref._flat_record_types[flat_record_types],
+              &_flat_record_types[0]);
 }
 
 Registry::Registry(
         const std::initializer_list<std::pair<RecordType, NodeConstructor>> &initial,
         bool add_defaults):
+    _flat_record_types(),
     _record_types()
 {
     if (add_defaults) {
@@ -72,24 +79,37 @@ Registry::~Registry()
 }
 
 void Registry::register_defaults() {
-    _record_types[RT_UINT32] = NodeHandleFactory<UInt32Record>::create;
-    _record_types[RT_INT32] = NodeHandleFactory<Int32Record>::create;
-    _record_types[RT_UINT64] = NodeHandleFactory<UInt64Record>::create;
-    _record_types[RT_INT64] = NodeHandleFactory<Int64Record>::create;
-    _record_types[RT_FLOAT32] = NodeHandleFactory<Float32Record>::create;
-    _record_types[RT_FLOAT64] = NodeHandleFactory<Float64Record>::create;
-    _record_types[RT_UTF8STRING] = NodeHandleFactory<UTF8Record>::create;
-    _record_types[RT_BLOB] = NodeHandleFactory<BlobRecord>::create;
-    _record_types[RT_BOOL_FALSE] = create_boolean<false>;
-    _record_types[RT_BOOL_TRUE] = create_boolean<true>;
-    _record_types[RT_CONTAINER] = NodeHandleFactory<Container>::create;
-    _record_types[RT_VARINT] = NodeHandleFactory<VarIntRecord>::create;
-    _record_types[RT_VARUINT] = NodeHandleFactory<VarUIntRecord>::create;
-    _record_types[RT_RAW128] = NodeHandleFactory<Raw128Record>::create;
+    register_record_function(RT_UINT32, construct_node<UInt32Record>);
+    register_record_function(RT_INT32, construct_node<Int32Record>);
+    register_record_function(RT_UINT64, construct_node<UInt64Record>);
+    register_record_function(RT_INT64, construct_node<Int64Record>);
+    register_record_function(RT_FLOAT32, construct_node<Float32Record>);
+    register_record_function(RT_FLOAT64, construct_node<Float64Record>);
+    register_record_function(RT_UTF8STRING, construct_node<UTF8Record>);
+    register_record_function(RT_BLOB, construct_node<BlobRecord>);
+    register_record_function(RT_BOOL_FALSE, create_boolean<false>);
+    register_record_function(RT_BOOL_TRUE, create_boolean<true>);
+    register_record_function(RT_CONTAINER, construct_node<Container>);
+    register_record_function(RT_VARINT, construct_node<VarIntRecord>);
+    register_record_function(RT_VARUINT, construct_node<VarUIntRecord>);
+    register_record_function(RT_RAW128, construct_node<Raw128Record>);
+}
+
+ConstRegistryHandle Registry::defaults()
+{
+    static const ConstRegistryHandle instance(new Registry());
+    return instance;
 }
 
 NodeHandle Registry::node_from_record_type(RecordType rt, ID id) const
 {
+    if (rt < flat_record_types) {
+        NodeConstructorFunction constructor = _flat_record_types[rt];
+        if (constructor) {
+            return constructor(id);
+        }
+    }
+
     auto found = _record_types.find(rt);
     if (found == _record_types.end()) {
         return NodeHandle();
@@ -102,7 +122,30 @@ void Registry::register_record_type(
     RecordType rt,
     const NodeConstructor &constructor)
 {
+    // plain functions can be stored in the flat table
+    const NodeConstructorFunction *function =
+        constructor.target<NodeConstructorFunction>();
+    if (function && *function) {
+        register_record_function(rt, *function);
+        return;
+    }
+
+    if (rt < flat_record_types) {
+        _flat_record_types[rt] = nullptr;
+    }
     _record_types[rt] = constructor;
 }
 
+void Registry::register_record_function(
+    RecordType rt,
+    NodeConstructorFunction constructor)
+{
+    if (rt < flat_record_types) {
+        _flat_record_types[rt] = constructor;
+        _record_types.erase(rt);
+    } else {
+        _record_types[rt] = constructor;
+    }
+}
+
 }
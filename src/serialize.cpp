@@ -53,7 +53,8 @@ static_assert(std::is_same<typename common_struct_type<B, void>::type, B>::value
 /* StructStream::DeserializerSink */
 
 DeserializerSink::DeserializerSink(deserializer_base *child):
-    _child(child)
+    _child(child),
+    _pool()
 {
 
 }
@@ -77,6 +78,7 @@ void DeserializerSink::_finalize_child()
 
 bool DeserializerSink::end_container(const ContainerFooter *foot)
 {
+    deserializer_pool::scope scope(&_pool);
     return _child->end_container();
 }
 
@@ -87,6 +89,7 @@ void DeserializerSink::end_of_stream()
 
 bool DeserializerSink::push_node(NodeHandle node)
 {
+    deserializer_pool::scope scope(&_pool);
     return _child->node(node);
 }
 
@@ -94,6 +97,7 @@ bool DeserializerSink::start_container(
     ContainerHandle cont,
     const ContainerMeta *meta)
 {
+    deserializer_pool::scope scope(&_pool);
     return _child->start_container(cont);
 }
 
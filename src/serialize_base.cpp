@@ -26,9 +26,85 @@ authors named in the AUTHORS file.
 #include "structstream/serialize_base.hpp"
 
 #include <cassert>
+#include <cstdint>
+#include <new>
 
 namespace StructStream {
 
+// room in front of each deserializer to remember the pool it came
+// from, keeping the object aligned
+static const size_t pool_header_size = alignof(std::max_align_t);
+
+static_assert(pool_header_size >= sizeof(deserializer_pool*),
+              "pool header cannot hold a pointer");
+
+static thread_local deserializer_pool *current_pool = nullptr;
+
+/* StructStream::deserializer_pool */
+
+deserializer_pool::deserializer_pool():
+    _buckets()
+{
+
+}
+
+deserializer_pool::~deserializer_pool()
+{
+    for (auto &bucket: _buckets) {
+        while (bucket) {
+            free_block *block = bucket;
+            bucket = block->next;
+            ::operator delete(block);
+        }
+    }
+}
+
+void *deserializer_pool::allocate(size_t size)
+{
+    const size_t bucket = (size - 1) / granularity;
+    if (bucket >= bucket_count) {
+        return ::operator new(size);
+    }
+
+    free_block *block = _buckets[bucket];
+    if (!block) {
+        return ::operator new((bucket + 1) * granularity);
+    }
+    _buckets[bucket] = block->next;
+    return block;
+}
+
+void deserializer_pool::release(void *block, size_t size)
+{
+    const size_t bucket = (size - 1) / granularity;
+    if (bucket >= bucket_count) {
+        ::operator delete(block);
+        return;
+    }
+
+    free_block *freed = static_cast<free_block*>(block);
+    freed->next = _buckets[bucket];
+    _buckets[bucket] = freed;
+}
+
+deserializer_pool *deserializer_pool::current()
+{
+    return current_pool;
+}
+
+/* StructStream::deserializer_pool::scope */
+
+deserializer_pool::scope::scope(deserializer_pool *pool):
+    _previous(current_pool)
+{
+    current_pool = pool;
+}
+
+deserializer_pool::scope::~scope()
+{
+    current_pool = _previous;
+}
+
 /* StructStream::deserializer_base */
 
 deserializer_base::~deserializer_base()
@@ -36,6 +112,32 @@ deserializer_base::~deserializer_base()
 
 }
 
+void *deserializer_base::operator new(size_t size)
+{
+    deserializer_pool *pool = current_pool;
+    const size_t full_size = size + pool_header_size;
+
+    uint8_t *block = static_cast<uint8_t*>(
+        pool ? pool->allocate(full_size) : ::operator new(full_size));
+    *reinterpret_cast<deserializer_pool**>(block) = pool;
+    return block + pool_header_size;
+}
+
+void deserializer_base::operator delete(void *ptr, size_t size)
+{
+    if (!ptr) {
+        return;
+    }
+
+    uint8_t *block = static_cast<uint8_t*>(ptr) - pool_header_size;
+    deserializer_pool *pool = *reinterpret_cast<deserializer_pool**>(block);
+    if (pool) {
+        pool->release(block, size + pool_header_size);
+    } else {
+        ::operator delete(block);
+    }
+}
+
 bool deserializer_base::end_container()
 {
     assert(false);
@@ -62,33 +164,46 @@ bool deserializer_base::start_container(const ContainerHandle &cont)
 /* StructStream::deserializer_nesting */
 
 deserializer_nesting::deserializer_nesting():
-    _depth(0),
-    _nested(nullptr)
+    _root(this),
+    _level(0),
+    _stack()
 {
 
 }
 
 deserializer_nesting::~deserializer_nesting()
 {
-    if (_nested) {
+    if (_root->_stack.size() > _level) {
         unnest();
     }
 }
 
 void deserializer_nesting::unnest()
 {
-    assert(_nested);
-    _nested->finalize();
-    delete _nested;
-    _nested = nullptr;
-    _depth = 0;
+    std::vector<frame> &stack = _root->_stack;
+    assert(stack.size() > _level);
+
+    deserializer_base *nested = stack[_level].handler;
+    // finalize() and the destructor unnest everything nested by
+    // *nested*, so the frame of *nested* is the top one afterwards
+    nested->finalize();
+    delete nested;
+    assert(stack.size() == _level + 1);
+    stack.pop_back();
 }
 
 void deserializer_nesting::nest(deserializer_base *obj)
 {
-    assert(!_nested);
-    _nested = obj;
-    _depth = 1;
+    std::vector<frame> &stack = _root->_stack;
+    assert(stack.size() == _level);
+
+    deserializer_nesting *nesting = dynamic_cast<deserializer_nesting*>(obj);
+    if (nesting) {
+        assert(nesting->_stack.empty());
+        nesting->_root = _root;
+        nesting->_level = _level + 1;
+    }
+    stack.push_back(frame{obj, nesting, 1});
 }
 
 bool deserializer_nesting::_end_container()
@@ -111,43 +226,63 @@ bool deserializer_nesting::_start_container(const ContainerHandle &cont)
 
 bool deserializer_nesting::end_container()
 {
-    if (_nested) {
-        _depth -= 1;
-        if (_depth == 0) {
-            unnest();
-            return _end_container();
-        } else {
-            return _nested->end_container();
-        }
-    } else {
+    if (_stack.empty()) {
         return _end_container();
     }
+
+    frame &top = _stack.back();
+    top.depth -= 1;
+    if (top.depth > 0) {
+        if (top.nesting) {
+            return top.nesting->_end_container();
+        }
+        return top.handler->end_container();
+    }
+
+    // the container which caused the nesting has ended
+    deserializer_nesting *owner = this;
+    if (_stack.size() > 1) {
+        owner = _stack[_stack.size() - 2].nesting;
+    }
+    owner->unnest();
+    if (owner != this) {
+        _stack.back().depth -= 1;
+    }
+    return owner->_end_container();
 }
 
 void deserializer_nesting::finalize()
 {
-    if (_nested) {
+    if (_root->_stack.size() > _level) {
         unnest();
     }
 }
 
 bool deserializer_nesting::node(const NodeHandle &node)
 {
-    if (_nested) {
-        return _nested->node(node);
-    } else {
+    if (_stack.empty()) {
         return _node(node);
     }
+
+    frame &top = _stack.back();
+    if (top.nesting) {
+        return top.nesting->_node(node);
+    }
+    return top.handler->node(node);
 }
 
 bool deserializer_nesting::start_container(const ContainerHandle &cont)
 {
-    if (_nested) {
-        _depth += 1;
-        return _nested->start_container(cont);
-    } else {
+    if (_stack.empty()) {
         return _start_container(cont);
     }
+
+    frame &top = _stack.back();
+    top.depth += 1;
+    if (top.nesting) {
+        return top.nesting->_start_container(cont);
+    }
+    return top.handler->start_container(cont);
 }
 
 /* StructStream::deserializer_null */
@@ -33,11 +33,12 @@ ContainerHandle bitstream_to_tree(IOIntfHandle in, RegistryHandle registry,
     ToTree *sink = new ToTree();
     StreamSink sink_h(sink);
 
-    if (registry.get() == nullptr) {
-        registry = RegistryHandle(new Registry());
+    ConstRegistryHandle registry_to_use = registry;
+    if (registry_to_use.get() == nullptr) {
+        registry_to_use = Registry::defaults();
     }
 
-    FromBitstream reader(in, registry, sink_h);
+    FromBitstream reader(in, registry_to_use, sink_h);
     reader.set_forgiving_for(forgivingness);
     reader.read_all();
     return sink->root();
@@ -38,14 +38,16 @@ namespace StructStream {
 
 FromBitstream::ContainerMeta::ContainerMeta():
     ::StructStream::ContainerMeta(),
-    has_hash(false)
+    has_hash(false),
+    body_length(-1)
 {
 
 }
 
 FromBitstream::ContainerMeta::ContainerMeta(const FromBitstream::ContainerMeta &ref):
     ::StructStream::ContainerMeta(ref),
-    has_hash(ref.has_hash)
+    has_hash(ref.has_hash),
+    body_length(ref.body_length)
 {
 
 }
@@ -57,17 +59,29 @@ ContainerMeta *FromBitstream::ContainerMeta::copy() const
 
 /* StructStream::FromBitstream */
 
-FromBitstream::FromBitstream(IOIntfHandle source, const RegistryHandle nodetypes,
-                   StreamSink sink):
-    _original_source_h(source),
-    _source_h(source),
-    _source(source.get()),
+static IOIntfHandle buffered_source(IOIntfHandle source,
+                                    const intptr_t buffer_size)
+{
+    // sources which buffer by themselves need no extra copy
+    if (buffer_size <= 0 || source->buffered()) {
+        return source;
+    }
+    return IOIntfHandle(new BufferedReader(source, buffer_size));
+}
+
+FromBitstream::FromBitstream(IOIntfHandle source, const ConstRegistryHandle nodetypes,
+                   StreamSink sink, const intptr_t buffer_size):
+    _original_source_h(buffered_source(source, buffer_size)),
+    _source_h(_original_source_h),
+    _source(_source_h.get()),
     _node_factory_h(nodetypes),
     _node_factory(nodetypes.get()),
     _sink_h(sink),
     _sink(sink.get()),
     _parent_stack(),
+    _parent_depth(0),
     _curr_parent(),
+    _skipped(),
     _forgiveness(0)
 {
     push_root();
@@ -75,16 +89,22 @@ FromBitstream::FromBitstream(IOIntfHandle source, const RegistryHandle nodetypes
 
 FromBitstream::~FromBitstream()
 {
-
+    for (auto info: _parent_stack) {
+        delete info;
+    }
 }
 
 void FromBitstream::cleanup_state()
 {
-    // drop all parent info
-    for (auto it: _parent_stack) {
-        delete it;
+    // drop all references held by the parent infos, but keep them
+    // for reuse
+    for (auto it = _parent_stack.begin();
+         it != _parent_stack.begin() + _parent_depth;
+         ++it)
+    {
+        (*it)->reset();
     }
-    _parent_stack.clear();
+    _parent_depth = 0;
     _curr_parent = nullptr;
     _sink = nullptr;
     _sink_h = StreamSink();
@@ -104,10 +124,10 @@ void FromBitstream::check_end_of_container()
 
     // printf("bitstream: %d out of %d children found\n",
     //        _curr_parent->read_child_count,
-    //        _curr_parent->meta->child_count);
+    //        _curr_parent->meta.child_count);
 
     if (!_curr_parent->armored
-        && _curr_parent->meta->child_count == _curr_parent->read_child_count)
+        && _curr_parent->meta.child_count == _curr_parent->read_child_count)
     {
         end_of_container();
     }
@@ -122,26 +142,51 @@ void FromBitstream::check_hash_length(VarUInt len)
 
 void FromBitstream::push_root()
 {
-    ParentInfo *root_pi = new ParentInfo();
-    root_pi->meta->child_count = -1;
+    ParentInfo *root_pi = next_parent_info();
     root_pi->armored = true;
-    root_pi->read_child_count = 0;
-    root_pi->cont = ContainerHandle();
-    _parent_stack.push_front(root_pi);
+    _parent_depth += 1;
     _curr_parent = root_pi;
 }
 
+FromBitstream::ParentInfo *FromBitstream::next_parent_info()
+{
+    if (_parent_depth == _parent_stack.size()) {
+        _parent_stack.push_back(new_parent_info());
+    }
+    ParentInfo *info = _parent_stack[_parent_depth];
+    info->reset();
+    return info;
+}
+
+void FromBitstream::pop_parent_info()
+{
+    _parent_depth -= 1;
+    if (_parent_depth == 0) {
+        _curr_parent = nullptr;
+    } else {
+        _curr_parent = _parent_stack[_parent_depth-1];
+    }
+}
+
 FromBitstream::ParentInfo *FromBitstream::new_parent_info() const
 {
     return new ParentInfo();
 }
 
-void FromBitstream::start_of_container(ContainerHandle cont_h)
+bool FromBitstream::skip_container(ParentInfo *info) const
+{
+    if (_skipped.empty()) {
+        return false;
+    }
+    return _skipped.count(std::pair<RecordType, ID>(
+        info->cont->record_type(), info->cont->id())) > 0;
+}
+
+bool FromBitstream::start_of_container(ContainerHandle cont_h)
 {
     VarUInt flags_int = Utils::read_varuint(_source);
-    ParentInfo *info = new_parent_info();
+    ParentInfo *info = next_parent_info();
     info->cont = cont_h;
-    info->read_child_count = 0;
 
     try {
         proc_container_flags(flags_int, info);
@@ -152,30 +197,38 @@ void FromBitstream::start_of_container(ContainerHandle cont_h)
             }
         }
 
+        if (info->meta.body_length >= 0 && skip_container(info)) {
+            sskip(_source, info->meta.body_length);
+            info->reset();
+            _curr_parent->read_child_count++;
+            return false;
+        }
+
         end_of_container_header(info);
     } catch (...) {
-        delete info;
+        info->reset();
         throw;
     }
 
-    _parent_stack.push_front(info);
+    _parent_depth += 1;
     _curr_parent = info;
-    if (!_sink->start_container(info->cont, info->meta)) {
+    if (!_sink->start_container(info->cont, &info->meta)) {
         throw SinkClosed();
     };
 
     // printf("bitstream: push 0x%lx\n", (uint64_t)_curr_parent->cont.get());
+    return true;
 }
 
 void FromBitstream::proc_container_flags(VarUInt &flags_int, FromBitstream::ParentInfo *info)
 {
-    info->meta->child_count = -1;
-    info->footer->hash_function = HT_NONE;
+    info->meta.child_count = -1;
+    info->footer.hash_function = HT_NONE;
     info->armored = false;
 
     if ((flags_int & CF_WITH_SIZE) != 0) {
         flags_int ^= CF_WITH_SIZE;
-        info->meta->child_count = Utils::read_varuint(_source);
+        info->meta.child_count = Utils::read_varuint(_source);
     }
 
     if ((flags_int & CF_ARMORED) != 0) {
@@ -183,7 +236,7 @@ void FromBitstream::proc_container_flags(VarUInt &flags_int, FromBitstream::Pare
         info->armored = true;
     }
 
-    if (!info->armored && (info->meta->child_count == -1)) {
+    if (!info->armored && (info->meta.child_count == -1)) {
         throw IllegalCombinationOfFlags("Illegal combination of container flags: no CF_WITH_SIZE, but no CF_ARMORED either -- how am I supposed to find out the length?");
     }
 
@@ -191,17 +244,27 @@ void FromBitstream::proc_container_flags(VarUInt &flags_int, FromBitstream::Pare
         HashType hash_function = static_cast<HashType>(Utils::read_varuint(_source));;
 
         flags_int ^= CF_HASHED;
-        info->meta->has_hash = true;
-        info->footer->hash_function = hash_function;
+        info->meta.has_hash = true;
+        info->footer.hash_function = hash_function;
+    }
+
+    if ((flags_int & CF_WITH_LENGTH) != 0) {
+        VarUInt body_length = Utils::read_varuint(_source);
+        if ((VarInt)body_length < 0) {
+            throw IllegalData("Container body length out of range.");
+        }
+
+        flags_int ^= CF_WITH_LENGTH;
+        info->meta.body_length = body_length;
     }
 }
 
 void FromBitstream::end_of_container_header(ParentInfo *info)
 {
-    if (info->footer->hash_function != HT_NONE) {
-        // printf("bitstream: container with hash %x\n", info->footer->hash_function);
+    if (info->footer.hash_function != HT_NONE) {
+        // printf("bitstream: container with hash %x\n", info->footer.hash_function);
 
-        IncrementalHash *hashfun = hashes.get_hash(info->footer->hash_function);
+        IncrementalHash *hashfun = hashes.get_hash(info->footer.hash_function);
         if ((hashfun == nullptr) && ((_forgiveness & UnknownHashFunction) == 0)) {
             throw UnsupportedHashFunction("Unsupported hash function.");
         }
@@ -212,15 +275,15 @@ void FromBitstream::end_of_container_header(ParentInfo *info)
             _source_h = info->pipe_h;
             _source = info->pipe;
         } else {
-            // printf("bitstream: no hash function for %x\n", info->footer->hash_function);
+            // printf("bitstream: no hash function for %x\n", info->footer.hash_function);
         }
     }
 }
 
 void FromBitstream::end_of_container_body(ParentInfo *info)
 {
-    if (info->footer->hash_function != HT_NONE) {
-        // printf("bitstream: eoc with hash %x\n", info->footer->hash_function);
+    if (info->footer.hash_function != HT_NONE) {
+        // printf("bitstream: eoc with hash %x\n", info->footer.hash_function);
         if (info->pipe) {
             _source_h = info->pipe->underlying_io();
             _source = _source_h.get();
@@ -254,7 +317,7 @@ void FromBitstream::end_of_container_body(ParentInfo *info)
                         throw HashCheckError("calculated and bitstream checksum do not match.");
                     }
                 } else {
-                    info->footer->validated = true;
+                    info->footer.validated = true;
                 }
             } catch (...) {
                 free(hash_from_stream);
@@ -265,7 +328,7 @@ void FromBitstream::end_of_container_body(ParentInfo *info)
             free(hash_calculated);
         } else {
 
-            // printf("bitstream: eoc with hash %x, but no checking\n", info->footer->hash_function);
+            // printf("bitstream: eoc with hash %x, but no checking\n", info->footer.hash_function);
 
             // hash checking has been disabled for this container for
             // some reason (e.g. forgiving mode)
@@ -276,20 +339,15 @@ void FromBitstream::end_of_container_body(ParentInfo *info)
 
     }
     info->cont->set_hashed(
-        info->footer->validated,
-        info->footer->hash_function
+        info->footer.validated,
+        info->footer.hash_function
     );
 }
 
 void FromBitstream::end_of_container()
 {
     ParentInfo *info = _curr_parent;
-    _parent_stack.pop_front();
-    if (_parent_stack.empty()) {
-        _curr_parent = nullptr;
-    } else {
-        _curr_parent = _parent_stack.front();
-    }
+    pop_parent_info();
 
     try {
         if (_curr_parent) {
@@ -297,7 +355,7 @@ void FromBitstream::end_of_container()
 
             // Do not call this virtual method for the root node
             end_of_container_body(info);
-            if (!_sink->end_container(info->footer)) {
+            if (!_sink->end_container(&info->footer)) {
                 throw SinkClosed();
             };
 
@@ -307,10 +365,10 @@ void FromBitstream::end_of_container()
             _sink->end_of_stream();
         }
     } catch (...) {
-        delete info;
+        info->reset();
         throw;
     }
-    delete info;
+    info->reset();
 
     check_end_of_container();
 }
@@ -334,8 +392,8 @@ NodeHandle FromBitstream::read_step() {
         // printf("bitstream: end of children encountered\n");
 
         if (_curr_parent->armored &&
-            (_curr_parent->meta->child_count == -1
-             || _curr_parent->meta->child_count == _curr_parent->read_child_count)
+            (_curr_parent->meta.child_count == -1
+             || _curr_parent->meta.child_count == _curr_parent->read_child_count)
             )
         {
             // EOC is only valid if container has CF_ARMORED flag
@@ -355,8 +413,8 @@ NodeHandle FromBitstream::read_step() {
     }
 
     if (_curr_parent->armored
-        && _curr_parent->meta->child_count != -1
-        && _curr_parent->meta->child_count <= _curr_parent->read_child_count)
+        && _curr_parent->meta.child_count != -1
+        && _curr_parent->meta.child_count <= _curr_parent->read_child_count)
     {
         throw MissingEndOfChildren("CF_ARMORED | CF_WITH_SIZE container without EOC marker.");
     }
@@ -392,9 +450,12 @@ NodeHandle FromBitstream::read_step() {
         }
     }
 
-    ContainerHandle new_parent = std::dynamic_pointer_cast<Container>(new_node);
-    if (new_parent.get() != nullptr) {
-        start_of_container(new_parent);
+    if (new_node->is_container()) {
+        if (!start_of_container(std::static_pointer_cast<Container>(new_node))) {
+            // skipped, like unknown appblobs
+            check_end_of_container();
+            return read_step();
+        }
     } else {
         new_node->read(_source);
         if (!_sink->push_node(new_node)) {
@@ -411,18 +472,19 @@ NodeHandle FromBitstream::read_step() {
 
 void FromBitstream::read_next()
 {
+    // containers without children may already be closed once
+    // read_step() returns, so compare against the depth from before
+    const decltype(_parent_depth) this_len = _parent_depth;
     NodeHandle node = read_step();
     if (!node) {
         return;
     }
 
-    ContainerHandle cont = std::dynamic_pointer_cast<Container>(node);
-    if (cont) {
-        typename decltype(_parent_stack)::size_type this_len = _parent_stack.size();
+    if (node->is_container()) {
         // printf("bitstream: read_next(): waiting for length %lu\n", this_len);
-        while (_parent_stack.size() >= this_len) {
+        while (_parent_depth > this_len) {
             read_step();
-            // printf("bitstream: read_next(): current length %lu\n", _parent_stack.size());
+            // printf("bitstream: read_next(): current length %lu\n", _parent_depth);
         }
     }
 }
@@ -452,21 +514,92 @@ void FromBitstream::set_forgiving_for(uint32_t forgiveness, bool forgiving)
     }
 }
 
+void FromBitstream::set_skip(RecordType rt, ID id, bool skip)
+{
+    if (skip) {
+        _skipped.insert(std::pair<RecordType, ID>(rt, id));
+    } else {
+        _skipped.erase(std::pair<RecordType, ID>(rt, id));
+    }
+}
+
+// segments of the buffers for bodies of CF_WITH_LENGTH containers;
+// most of them are small
+static const intptr_t body_segment_size = 4096;
+
+/**
+ * Encode *value* with the maximum varuint size, so that it can be
+ * overwritten later without moving the data after it.
+ */
+static intptr_t encode_fixed_varuint(uint8_t *dest, VarUInt value)
+{
+    if (value > MaxVarUInt) {
+        throw LimitError("Value out of range for varint encoding.");
+    }
+    dest[0] = 0x01;
+    for (int i = 1; i < Utils::max_varint_size; i++) {
+        dest[i] = (uint8_t)(value >> (8*(Utils::max_varint_size-1-i)));
+    }
+    return Utils::max_varint_size;
+}
+
+/* StructStream::ToBitstream::CountingWriter */
+
+struct ToBitstream::CountingWriter: public IOIntf {
+public:
+    explicit CountingWriter(IOIntfHandle dest):
+        dest_h(dest),
+        dest(dest.get()),
+        count(0)
+    {
+
+    };
+
+    IOIntfHandle dest_h;
+    IOIntf *dest;
+    intptr_t count;
+
+    intptr_t read(void *buf, const intptr_t len) override {
+        return 0;
+    };
+
+    intptr_t write(const void *buf, const intptr_t len) override {
+        const intptr_t written = dest->write(buf, len);
+        count += written;
+        return written;
+    };
+};
+
 /* StructStream::ToBitstream */
 
-ToBitstream::ToBitstream(IOIntfHandle dest):
+ToBitstream::ToBitstream(IOIntfHandle dest, const intptr_t buffer_size):
     _dest_h(dest),
     _dest(dest.get()),
+    _buffer(nullptr),
+    _output(dest.get()),
+    _body_pool(),
     _parent_stack(),
+    _parent_depth(0),
     _curr_parent(),
-    _default_armor(false)
+    _default_armor(false),
+    _default_length(false),
+    _counter(nullptr),
+    _index()
 {
-
+    // destinations which buffer by themselves need no extra copy
+    if (buffer_size > 0 && !dest->buffered()) {
+        _buffer = new BufferedWriter(dest, buffer_size);
+        _dest_h = IOIntfHandle(_buffer);
+        _dest = _buffer;
+        _output = _buffer;
+    }
 }
 
 ToBitstream::~ToBitstream()
 {
-
+    for (auto info: _parent_stack) {
+        delete info;
+    }
 }
 
 void ToBitstream::require_open() const
@@ -493,6 +626,9 @@ VarUInt ToBitstream::get_container_flags(ToBitstream::ParentInfo *info)
     if (info->hash_function != HT_NONE) {
         flags |= CF_HASHED;
     }
+    if (info->with_length) {
+        flags |= CF_WITH_LENGTH;
+    }
 
     return flags;
 }
@@ -503,22 +639,73 @@ void ToBitstream::setup_container(ToBitstream::ParentInfo *info, ContainerHandle
     info->child_count = meta->child_count;
     info->armored = _default_armor || (meta->child_count < 0);
     info->hash_function = HT_NONE;
+    info->with_length = _default_length;
 }
 
-void ToBitstream::write_container_header(VarUInt flags, ParentInfo *info)
+intptr_t ToBitstream::encode_container_header(uint8_t *dest, VarUInt flags,
+                                              ParentInfo *info,
+                                              intptr_t body_length,
+                                              intptr_t *length_pos)
 {
-    Utils::write_record_type(_dest, info->cont->record_type());
-    Utils::write_id(_dest, info->cont->id());
+    intptr_t len = info->cont->encode_header(dest);
 
-    Utils::write_varuint(_dest, flags);
+    len += Utils::encode_varuint(&dest[len], flags);
     if ((flags & CF_WITH_SIZE) != 0) {
         assert(info->child_count >= 0);
-        Utils::write_varuint(_dest, static_cast<VarUInt>(info->child_count));
+        len += Utils::encode_varuint(
+            &dest[len], static_cast<VarUInt>(info->child_count));
     }
 
     if ((flags & CF_HASHED) != 0) {
         assert(info->hash_function != HT_NONE);
-        Utils::write_varuint(_dest, static_cast<VarUInt>(info->hash_function));
+        len += Utils::encode_varuint(
+            &dest[len], static_cast<VarUInt>(info->hash_function));
+    }
+
+    if ((flags & CF_WITH_LENGTH) != 0 && length_pos) {
+        // filled in later
+        *length_pos = len;
+        len += encode_fixed_varuint(&dest[len], 0);
+    } else if ((flags & CF_WITH_LENGTH) != 0) {
+        assert(body_length >= 0);
+        len += Utils::encode_varuint(
+            &dest[len], static_cast<VarUInt>(body_length));
+    }
+
+    return len;
+}
+
+void ToBitstream::write_container_header(VarUInt flags, ParentInfo *info)
+{
+    IOIntf *top = (_counter ? static_cast<IOIntf*>(_counter) : _output);
+    if ((flags & CF_WITH_LENGTH) != 0 && _dest == top && _output->seekable()) {
+        // nothing but the output lies below us, so we can seek back
+        // to the length once the body is written
+        uint8_t header[Node::max_header_size + 4*Utils::max_varint_size];
+        intptr_t length_pos = 0;
+        const intptr_t header_len = encode_container_header(
+            header, flags, info, -1, &length_pos);
+        const intptr_t start = _output->tell();
+        swrite(_dest, header, header_len);
+        info->length_offset = start + length_pos;
+        info->body_start = start + header_len;
+    } else if ((flags & CF_WITH_LENGTH) != 0) {
+        // the header is written by write_container_footer, once the
+        // length of the body is known
+        if (!info->body) {
+            if (!_body_pool) {
+                _body_pool = SegmentPoolHandle(new SegmentPool(body_segment_size));
+            }
+            info->body = new SegmentedMemory(_body_pool);
+            info->body_h = IOIntfHandle(info->body);
+        }
+        info->flags = flags;
+        info->outer_h = _dest_h;
+        _dest_h = info->body_h;
+        _dest = info->body;
+    } else {
+        uint8_t header[Node::max_header_size + 4*Utils::max_varint_size];
+        swrite(_dest, header, encode_container_header(header, flags, info, -1));
     }
 
     if (info->hash_function != HT_NONE) {
@@ -553,14 +740,63 @@ void ToBitstream::write_container_footer(ParentInfo *info)
 
         uint8_t *hash_buffer = (uint8_t*)malloc(hash_length);
         hashfun->finish(hash_buffer);
-        swrite(_dest, hash_buffer, hash_length);
-
         delete hashfun;
+
+        try {
+            swrite(_dest, hash_buffer, hash_length);
+        } catch (...) {
+            free(hash_buffer);
+            throw;
+        }
+        free(hash_buffer);
+    }
+
+    if (info->length_offset >= 0) {
+        const intptr_t end = _output->tell();
+        uint8_t length[Utils::max_varint_size];
+        encode_fixed_varuint(length, end - info->body_start);
+        if (_output->seek(info->length_offset) != info->length_offset) {
+            throw EndOfStreamError("Could not seek back to the container length.");
+        }
+        swrite(_output, length, sizeof(length));
+        if (_output->seek(end) != end) {
+            throw EndOfStreamError("Could not seek to the end of the container.");
+        }
+        info->length_offset = -1;
+    } else if (info->outer_h) {
+        _dest_h = info->outer_h;
+        _dest = _dest_h.get();
+        info->outer_h = IOIntfHandle();
+
+        uint8_t header[Node::max_header_size + 4*Utils::max_varint_size];
+        swrite(_dest, header,
+               encode_container_header(header, info->flags, info,
+                                       info->body->size()));
+
+        // the body of a parent with CF_WITH_LENGTH takes over the
+        // chunks instead of copying them
+        SegmentedMemory *outer = dynamic_cast<SegmentedMemory*>(_dest);
+        FdOutput *fd_output = dynamic_cast<FdOutput*>(_dest);
+        if (outer) {
+            outer->splice(*info->body);
+        } else if (fd_output) {
+            // hand all chunks to the kernel at once
+            fd_output->write_segments(*info->body);
+            info->body->clear();
+        } else {
+            for (auto &segment: info->body->segments()) {
+                swrite(_dest, segment.data, segment.len);
+            }
+            info->body->clear();
+        }
     }
 }
 
 void ToBitstream::write_footer()
 {
+    if (_counter) {
+        StreamIndex::write_trailer(_dest, _index, _counter->count);
+    }
     Utils::write_record_type(_dest, RT_END_OF_CHILDREN);
 }
 
@@ -568,14 +804,23 @@ bool ToBitstream::start_container(ContainerHandle cont, const ContainerMeta *met
 {
     require_open();
 
-    ParentInfo *info = new_parent_info();
+    if (_parent_depth == _parent_stack.size()) {
+        _parent_stack.push_back(new_parent_info());
+    }
+    ParentInfo *info = _parent_stack[_parent_depth];
     setup_container(info, cont, meta);
 
+    if (_counter && _parent_depth == 0) {
+        // the header of containers with CF_WITH_LENGTH is delayed,
+        // but nothing else is written at the top level in between
+        _index.push_back(StreamIndexEntry{cont->id(), _counter->count});
+    }
+
     VarUInt flags = get_container_flags(info);
 
     write_container_header(flags, info);
 
-    _parent_stack.push_front(info);
+    _parent_depth += 1;
     _curr_parent = info;
     return true;
 }
@@ -584,6 +829,10 @@ bool ToBitstream::push_node(NodeHandle node)
 {
     require_open();
 
+    if (_counter && _parent_depth == 0) {
+        _index.push_back(StreamIndexEntry{node->id(), _counter->count});
+    }
+
     node->write(_dest);
     return true;
 }
@@ -593,16 +842,16 @@ bool ToBitstream::end_container(const ContainerFooter *foot)
     require_open();
 
     ParentInfo *old = _curr_parent;
-    _parent_stack.pop_front();
-    if (_parent_stack.empty()) {
+    _parent_depth -= 1;
+    if (_parent_depth == 0) {
         _curr_parent = nullptr;
     } else {
-        _curr_parent = _parent_stack.front();
+        _curr_parent = _parent_stack[_parent_depth-1];
     }
 
     write_container_footer(old);
 
-    delete old;
+    old->cont = ContainerHandle();
 
     return true;
 }
@@ -617,14 +866,41 @@ void ToBitstream::close()
     require_open();
 
     write_footer();
+    flush();
     _dest = nullptr;
     _dest_h = IOIntfHandle();
+    _buffer = nullptr;
+    _output = nullptr;
+    _counter = nullptr;
+}
+
+void ToBitstream::enable_index()
+{
+    require_open();
+
+    if (_counter) {
+        return;
+    }
+    assert(_parent_depth == 0);
+    _counter = new CountingWriter(_dest_h);
+    _dest_h = IOIntfHandle(_counter);
+    _dest = _counter;
+}
+
+void ToBitstream::flush()
+{
+    require_open();
+
+    if (_buffer && !_buffer->flush()) {
+        throw EndOfStreamError("Premature end-of-stream while writing.");
+    }
 }
 
 /* StructStream::ToBitstreamHashing */
 
-ToBitstreamHashing::ToBitstreamHashing(IOIntfHandle dest):
-    ToBitstream::ToBitstream(dest),
+ToBitstreamHashing::ToBitstreamHashing(IOIntfHandle dest,
+                                       const intptr_t buffer_size):
+    ToBitstream::ToBitstream(dest, buffer_size),
     _hash_functions()
 {
 
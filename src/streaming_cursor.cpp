@@ -0,0 +1,612 @@
+/**********************************************************************
+File name: streaming_cursor.cpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#include "structstream/streaming_cursor.hpp"
+
+#include <cstring>
+
+#include "structstream/utils.hpp"
+#include "structstream/errors.hpp"
+#include "structstream/io_memory.hpp"
+#include "structstream/node_blob.hpp"
+#include "structstream/node_container.hpp"
+#include "structstream/node_primitive.hpp"
+#include "structstream/node_varint.hpp"
+#include "structstream/registry.hpp"
+
+namespace StructStream {
+
+static const VarUInt max_hash_length = 1024;
+
+static IOIntfHandle buffered_source(IOIntfHandle source,
+                                    const intptr_t buffer_size)
+{
+    // same policy as in FromBitstream
+    if (buffer_size <= 0 || source->buffered()) {
+        return source;
+    }
+    return IOIntfHandle(new BufferedReader(source, buffer_size));
+}
+
+/**
+ * Cast a node created by the registry to the class the record of the
+ * current event is stored in. Registries may create any class for a
+ * record type, so this has to be checked.
+ */
+template <typename record_t>
+static inline record_t *node_of_class(Node *node)
+{
+    record_t *result = node_cast<record_t>(node);
+    if (result == nullptr) {
+        throw UnsupportedRecordType("Node class does not fit the record type.");
+    }
+    return result;
+}
+
+template <typename _T>
+static inline _T read_primitive(IOIntf *stream)
+{
+    _T value;
+    sreadv<_T>(stream, &value);
+    if (Utils::is_big_endian && (sizeof(_T) > 1)) {
+        endianess<_T>::bswap(value);
+    }
+    return value;
+}
+
+static inline void check_hash_length(VarUInt len)
+{
+    if (len > max_hash_length) {
+        throw LimitError(std::string("Max hash length violated: ") + std::to_string(len));
+    }
+}
+
+/* StructStream::BitstreamCursor */
+
+BitstreamCursor::BitstreamCursor(IOIntfHandle source,
+                                 const intptr_t buffer_size):
+    BitstreamCursor(source, Registry::defaults(), buffer_size)
+{
+
+}
+
+BitstreamCursor::BitstreamCursor(IOIntfHandle source,
+                                 const ConstRegistryHandle nodetypes,
+                                 const intptr_t buffer_size):
+    _original_source_h(buffered_source(source, buffer_size)),
+    _source_h(_original_source_h),
+    _source(_source_h.get()),
+    _node_factory_h(nodetypes),
+    _stack(),
+    _payload(),
+    _pending_commit(0),
+    _at_container_start(false),
+    _forgiveness(0)
+{
+    Frame root;
+    root.id = InvalidID;
+    root.child_count = -1;
+    root.read_child_count = 0;
+    root.armored = true;
+    root.hash_function = HT_NONE;
+    root.body_length = -1;
+    root.pipe = nullptr;
+    _stack.push_back(root);
+}
+
+BitstreamCursor::~BitstreamCursor()
+{
+
+}
+
+void BitstreamCursor::commit_pending()
+{
+    if (_pending_commit > 0) {
+        _source->commit(_pending_commit);
+        _pending_commit = 0;
+    }
+}
+
+bool BitstreamCursor::end_reached() const
+{
+    const Frame &top = _stack.back();
+    return _stack.size() > 1
+        && !top.armored
+        && top.child_count == top.read_child_count;
+}
+
+void BitstreamCursor::end_of_container(CursorEvent &ev)
+{
+    Frame &frame = _stack.back();
+    ev.kind = CE_END_CONTAINER;
+    ev.rt = RT_CONTAINER;
+    ev.id = frame.id;
+    ev.depth = _stack.size() - 2;
+    ev.data = nullptr;
+    ev.len = 0;
+    ev.child_count = frame.read_child_count;
+
+    read_footer(frame, ev);
+
+    _stack.pop_back();
+    _stack.back().read_child_count++;
+}
+
+void BitstreamCursor::proc_end_of_children()
+{
+    const Frame &top = _stack.back();
+    if (!top.armored) {
+        throw UnexpectedEndOfChildren("Non-armored container closed by End-Of-Children tag. This may also imply that some children are missing.");
+    }
+
+    if (top.child_count != -1
+        && top.child_count != top.read_child_count
+        && (_forgiveness & FromBitstream::PrematureEndOfContainer) == 0)
+    {
+        throw UnexpectedEndOfChildren("Armored container ended unexpectedly (not all announced children found).");
+    }
+}
+
+void BitstreamCursor::read_container_header(CursorEvent &ev)
+{
+    VarUInt flags_int = Utils::read_varuint(_source);
+
+    Frame frame;
+    frame.id = ev.id;
+    frame.child_count = -1;
+    frame.read_child_count = 0;
+    frame.armored = false;
+    frame.hash_function = HT_NONE;
+    frame.body_length = -1;
+    frame.pipe = nullptr;
+
+    if ((flags_int & CF_WITH_SIZE) != 0) {
+        flags_int ^= CF_WITH_SIZE;
+        frame.child_count = Utils::read_varuint(_source);
+    }
+
+    if ((flags_int & CF_ARMORED) != 0) {
+        flags_int ^= CF_ARMORED;
+        frame.armored = true;
+    }
+
+    if (!frame.armored && (frame.child_count == -1)) {
+        throw IllegalCombinationOfFlags("Illegal combination of container flags: no CF_WITH_SIZE, but no CF_ARMORED either -- how am I supposed to find out the length?");
+    }
+
+    if ((flags_int & CF_HASHED) != 0) {
+        flags_int ^= CF_HASHED;
+        frame.hash_function = static_cast<HashType>(Utils::read_varuint(_source));
+    }
+
+    if ((flags_int & CF_WITH_LENGTH) != 0) {
+        flags_int ^= CF_WITH_LENGTH;
+        VarUInt body_length = Utils::read_varuint(_source);
+        if ((VarInt)body_length < 0) {
+            throw IllegalData("Container body length out of range.");
+        }
+        frame.body_length = body_length;
+    }
+
+    if (flags_int != 0
+        && (_forgiveness & FromBitstream::UnknownContainerFlags) == 0)
+    {
+        throw UnsupportedContainerFlags("Unsupported container flags encountered.");
+    }
+
+    if (frame.hash_function != HT_NONE) {
+        IncrementalHash *hashfun = hashes.get_hash(frame.hash_function);
+        if ((hashfun == nullptr)
+            && ((_forgiveness & FromBitstream::UnknownHashFunction) == 0))
+        {
+            throw UnsupportedHashFunction("Unsupported hash function.");
+        }
+
+        if (hashfun != nullptr) {
+            frame.pipe = new HashPipe<HP_READ>(hashfun, _source_h);
+            frame.pipe_h = IOIntfHandle(frame.pipe);
+            _source_h = frame.pipe_h;
+            _source = frame.pipe;
+        }
+    }
+
+    _stack.push_back(std::move(frame));
+
+    ev.kind = CE_START_CONTAINER;
+    ev.child_count = _stack.back().child_count;
+    ev.len = _stack.back().body_length;
+    _at_container_start = true;
+}
+
+void BitstreamCursor::read_footer(Frame &frame, CursorEvent &ev)
+{
+    ev.hash_function = frame.hash_function;
+    ev.validated = false;
+
+    if (frame.hash_function == HT_NONE) {
+        return;
+    }
+
+    if (!frame.pipe) {
+        // hash checking has been disabled for this container (unknown
+        // hash function in forgiving mode)
+        VarUInt hash_length = Utils::read_varuint(_source);
+        check_hash_length(hash_length);
+        sskip(_source, hash_length);
+        return;
+    }
+
+    _source_h = frame.pipe->underlying_io();
+    _source = _source_h.get();
+
+    uint8_t hash_calculated[max_hash_length];
+    IncrementalHash *hashfun = frame.pipe->reclaim_hash();
+    const intptr_t digest_length = hashfun->len();
+    hashfun->finish(hash_calculated);
+    delete hashfun;
+
+    frame.pipe = nullptr;
+    frame.pipe_h = IOIntfHandle();
+
+    VarUInt hash_length = Utils::read_varuint(_source);
+    check_hash_length(hash_length);
+    if ((intptr_t)hash_length != digest_length) {
+        throw IllegalData("hash length does not match with what we know about the hash function.");
+    }
+
+    uint8_t hash_from_stream[max_hash_length];
+    sread(_source, hash_from_stream, hash_length);
+
+    if (memcmp(hash_from_stream, hash_calculated, hash_length) != 0) {
+        if ((_forgiveness & FromBitstream::ChecksumErrors) == 0) {
+            throw HashCheckError("calculated and bitstream checksum do not match.");
+        }
+    } else {
+        ev.validated = true;
+    }
+}
+
+void BitstreamCursor::read_span(CursorEvent &ev, intptr_t len)
+{
+    ev.kind = CE_BLOB;
+    ev.len = len;
+
+    // hand out the bytes in place if possible; they are consumed on
+    // the next call
+    const uint8_t *direct = nullptr;
+    if (len > 0 && _source->acquire(&direct, len) >= len) {
+        ev.data = direct;
+        _pending_commit = len;
+        return;
+    }
+
+    if ((intptr_t)_payload.size() < len) {
+        _payload.resize(len);
+    }
+    sread(_source, _payload.data(), len);
+    ev.data = _payload.data();
+}
+
+void BitstreamCursor::unwind_pipes()
+{
+    while (_source_h != _original_source_h) {
+        HashPipe<HP_READ> *pipe = static_cast<HashPipe<HP_READ>*>(_source);
+        _source_h = pipe->underlying_io();
+        _source = _source_h.get();
+    }
+}
+
+bool BitstreamCursor::next(CursorEvent &ev)
+{
+    commit_pending();
+    _at_container_start = false;
+
+    while (!_stack.empty()) {
+        if (end_reached()) {
+            end_of_container(ev);
+            return true;
+        }
+
+        RecordType rt = Utils::read_record_type(_source);
+        if (rt == RT_RESERVED) {
+            throw UnsupportedRecordType("RT_RESERVED encountered. This stream may have been created with a newer version of structstream.");
+        } else if (rt == RT_END_OF_CHILDREN) {
+            proc_end_of_children();
+            if (_stack.size() == 1) {
+                _stack.pop_back();
+                return false;
+            }
+            end_of_container(ev);
+            return true;
+        }
+
+        Frame &parent = _stack.back();
+        if (parent.armored
+            && parent.child_count != -1
+            && parent.child_count <= parent.read_child_count)
+        {
+            throw MissingEndOfChildren("CF_ARMORED | CF_WITH_SIZE container without EOC marker.");
+        }
+
+        ID id = Utils::read_id(_source);
+        if (id == InvalidID) {
+            throw InvalidIDError("Invalid object ID encountered.");
+        }
+
+        ev.kind = CE_VALUE;
+        ev.rt = rt;
+        ev.id = id;
+        ev.depth = _stack.size() - 1;
+        ev.data = nullptr;
+        ev.len = 0;
+        ev.child_count = -1;
+        ev.hash_function = HT_NONE;
+        ev.validated = false;
+
+        switch (rt) {
+        case RT_CONTAINER:
+        {
+            read_container_header(ev);
+            return true;
+        }
+        case RT_UINT32:
+        {
+            ev.value.u32 = read_primitive<uint32_t>(_source);
+            break;
+        }
+        case RT_INT32:
+        {
+            ev.value.i32 = read_primitive<int32_t>(_source);
+            break;
+        }
+        case RT_UINT64:
+        {
+            ev.value.u64 = read_primitive<uint64_t>(_source);
+            break;
+        }
+        case RT_INT64:
+        {
+            ev.value.i64 = read_primitive<int64_t>(_source);
+            break;
+        }
+        case RT_FLOAT32:
+        {
+            ev.value.f32 = read_primitive<float>(_source);
+            break;
+        }
+        case RT_FLOAT64:
+        {
+            ev.value.f64 = read_primitive<double>(_source);
+            break;
+        }
+        case RT_BOOL_TRUE:
+        case RT_BOOL_FALSE:
+        {
+            ev.value.b = (rt == RT_BOOL_TRUE);
+            break;
+        }
+        case RT_VARUINT:
+        {
+            ev.value.u64 = Utils::read_varuint(_source);
+            break;
+        }
+        case RT_VARINT:
+        {
+            ev.value.i64 = Utils::read_varint(_source);
+            break;
+        }
+        case RT_UTF8STRING:
+        case RT_BLOB:
+        {
+            VarInt length = Utils::read_varint(_source);
+            if (length < 0) {
+                throw IllegalData("Negative-length blob record.");
+            }
+            read_span(ev, length);
+            break;
+        }
+        case RT_RAW128:
+        {
+            read_span(ev, 16);
+            break;
+        }
+        default:
+        {
+            if ((rt < RT_APPBLOB_MIN) || (rt > RT_APPBLOB_MAX)) {
+                throw UnsupportedRecordType("Unsupported record type.");
+            }
+
+            // Appblobs are required to store their size in a varuint
+            // right after the ID.
+            VarUInt blob_size = Utils::read_varuint(_source);
+            if ((VarInt)blob_size < 0) {
+                throw IllegalData("Appblob size out of range.");
+            }
+
+            if ((_forgiveness & FromBitstream::UnknownAppblobs) != 0) {
+                sskip(_source, blob_size);
+                _stack.back().read_child_count++;
+                continue;
+            }
+
+            read_span(ev, blob_size);
+        }
+        }
+
+        _stack.back().read_child_count++;
+        return true;
+    }
+
+    return false;
+}
+
+void BitstreamCursor::skip_container()
+{
+    if (_at_container_start && _stack.back().body_length >= 0) {
+        Frame &frame = _stack.back();
+        if (frame.pipe) {
+            // the body still counts for the hashes of the parents
+            _source_h = frame.pipe->underlying_io();
+            _source = _source_h.get();
+        }
+        sskip(_source, frame.body_length);
+        _stack.pop_back();
+        _stack.back().read_child_count++;
+        _at_container_start = false;
+        return;
+    }
+
+    CursorEvent ev;
+    const std::vector<Frame>::size_type this_len = _stack.size();
+    while (_stack.size() >= this_len && next(ev)) {
+
+    }
+}
+
+intptr_t BitstreamCursor::offset()
+{
+    if (!_source) {
+        return -1;
+    }
+    commit_pending();
+    return _source->tell();
+}
+
+NodeHandle BitstreamCursor::read_node(const CursorEvent &ev)
+{
+    NodeHandle node = _node_factory_h->node_from_record_type(
+        ev.rt, ev.id);
+    if (!node) {
+        throw UnsupportedRecordType("Unsupported record type.");
+    }
+
+    switch (ev.kind) {
+    case CE_START_CONTAINER:
+    {
+        Container *cont = node_of_class<Container>(node.get());
+        CursorEvent child;
+        while (next(child)) {
+            if (child.kind == CE_END_CONTAINER) {
+                cont->set_hashed(child.validated, child.hash_function);
+                break;
+            }
+            cont->child_add(read_node(child));
+        }
+        break;
+    }
+    case CE_VALUE:
+    {
+        switch (ev.rt) {
+        case RT_INT32:
+            node_of_class<Int32Record>(node.get())->set(ev.value.i32);
+            break;
+        case RT_UINT32:
+            node_of_class<UInt32Record>(node.get())->set(ev.value.u32);
+            break;
+        case RT_INT64:
+            node_of_class<Int64Record>(node.get())->set(ev.value.i64);
+            break;
+        case RT_UINT64:
+            node_of_class<UInt64Record>(node.get())->set(ev.value.u64);
+            break;
+        case RT_FLOAT32:
+            node_of_class<Float32Record>(node.get())->set(ev.value.f32);
+            break;
+        case RT_FLOAT64:
+            node_of_class<Float64Record>(node.get())->set(ev.value.f64);
+            break;
+        case RT_BOOL_TRUE:
+        case RT_BOOL_FALSE:
+            node_of_class<BoolRecordBase>(node.get())->set(ev.value.b);
+            break;
+        case RT_VARINT:
+            node_of_class<VarIntRecord>(node.get())->set(ev.value.i64);
+            break;
+        case RT_VARUINT:
+            node_of_class<VarUIntRecord>(node.get())->set(ev.value.u64);
+            break;
+        default:
+            throw std::logic_error("Unhandled record type of value event.");
+        }
+        break;
+    }
+    case CE_BLOB:
+    {
+        if (ev.rt == RT_UTF8STRING) {
+            node_of_class<UTF8Record>(node.get())->set(
+                std::string((const char*)ev.data, ev.len));
+            break;
+        } else if (ev.rt == RT_BLOB) {
+            node_of_class<BlobRecord>(node.get())->set(
+                (const char*)ev.data, ev.len);
+            break;
+        }
+
+        // let the node decode the record as FromBitstream would;
+        // appblobs read their size themselves
+        std::vector<uint8_t> record;
+        if (ev.rt != RT_RAW128) {
+            record.resize(Utils::max_varint_size);
+            record.resize(Utils::encode_varuint(record.data(), ev.len));
+        }
+        record.insert(record.end(), ev.data, ev.data + ev.len);
+
+        MemoryView view(record.data(), record.size());
+        node->read(&view);
+        if (view.tell() != (intptr_t)record.size()) {
+            throw IllegalData("Node did not read the whole record.");
+        }
+        break;
+    }
+    case CE_END_CONTAINER:
+    {
+        throw std::logic_error("read_node() called for the end of a container.");
+    }
+    }
+
+    return node;
+}
+
+void BitstreamCursor::close()
+{
+    _pending_commit = 0;
+    unwind_pipes();
+    _stack.clear();
+    _payload.clear();
+    _source_h = nullptr;
+    _original_source_h = nullptr;
+    _source = nullptr;
+}
+
+void BitstreamCursor::set_forgiving_for(uint32_t forgiveness, bool forgiving)
+{
+    if (forgiving) {
+        _forgiveness |= forgiveness;
+    } else {
+        _forgiveness &= ~forgiveness;
+    }
+}
+
+}
@@ -0,0 +1,221 @@
+/**********************************************************************
+File name: streaming_index.cpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#include "structstream/streaming_index.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "structstream/errors.hpp"
+#include "structstream/io.hpp"
+#include "structstream/node_container.hpp"
+#include "structstream/streaming_bitstream.hpp"
+#include "structstream/streaming_tree.hpp"
+#include "structstream/utils.hpp"
+
+namespace StructStream {
+
+static const uint8_t index_magic[8] = {
+    'S', 'S', 'I', 'N', 'D', 'E', 'X', '1'
+};
+
+static inline void store_le64(uint8_t *dest, uint64_t value)
+{
+    for (int i = 0; i < 8; i++) {
+        dest[i] = (uint8_t)(value >> (8*i));
+    }
+}
+
+static inline uint64_t load_le64(const uint8_t *src)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= (uint64_t)src[i] << (8*i);
+    }
+    return value;
+}
+
+/* StructStream::StreamIndex */
+
+StreamIndex::StreamIndex(IOIntfHandle source):
+    _source_h(source),
+    _base(0),
+    _entries(),
+    _by_id()
+{
+    IOIntf *io = _source_h.get();
+    if (!io->seekable()) {
+        throw UnsupportedInput("A stream index requires a seekable source.");
+    }
+
+    // footer plus the end-of-children marker of the stream
+    uint8_t footer[footer_size + 1];
+    const intptr_t end = io->seek(std::numeric_limits<intptr_t>::max());
+    if (end < (intptr_t)sizeof(footer)
+        || io->seek(end - sizeof(footer)) < 0
+        || io->read(footer, sizeof(footer)) != (intptr_t)sizeof(footer)
+        || memcmp(&footer[16], index_magic, sizeof(index_magic)) != 0
+        || footer[footer_size] != (RT_END_OF_CHILDREN | 0x80))
+    {
+        throw IllegalData("No stream index found.");
+    }
+
+    const uint64_t offset = load_le64(&footer[0]);
+    const uint64_t length = load_le64(&footer[8]);
+    const intptr_t position = end - 1 - (intptr_t)length;
+    if (length > (uint64_t)end || position < (intptr_t)offset) {
+        throw IllegalData("Stream index footer points outside of the source.");
+    }
+    _base = position - offset;
+
+    io->seek(position);
+    RecordType rt = Utils::read_record_type(io);
+    ID id = Utils::read_id(io);
+    VarInt payload_length = Utils::read_varint(io);
+    // the footer has to describe exactly this record, not just any
+    // blob which happens to end with the magic
+    const intptr_t header_length = io->tell() - position;
+    if (rt != RT_BLOB || id != IndexTrailerID
+        || payload_length < footer_size
+        || header_length + payload_length != (VarInt)length)
+    {
+        throw IllegalData("Malformed stream index record.");
+    }
+
+    std::vector<uint8_t> payload(payload_length - footer_size);
+    sread(io, payload.data(), payload.size());
+
+    MemoryView view(payload.data(), payload.size());
+    const VarUInt count = Utils::read_varuint(&view);
+    if (count > payload.size()) {
+        throw IllegalData("Malformed stream index record.");
+    }
+
+    _entries.reserve(count);
+    intptr_t node_offset = 0;
+    for (VarUInt i = 0; i < count; i++) {
+        StreamIndexEntry entry;
+        entry.id = Utils::read_id(&view);
+        node_offset += Utils::read_varuint(&view);
+        entry.offset = node_offset;
+        _entries.push_back(entry);
+    }
+
+    _by_id.resize(_entries.size());
+    for (size_t i = 0; i < _by_id.size(); i++) {
+        _by_id[i] = i;
+    }
+    std::stable_sort(
+        _by_id.begin(), _by_id.end(),
+        [this](size_t a, size_t b) {
+            return _entries[a].id < _entries[b].id;
+        });
+}
+
+StreamIndex::~StreamIndex()
+{
+
+}
+
+intptr_t StreamIndex::find(ID id) const
+{
+    auto it = std::lower_bound(
+        _by_id.begin(), _by_id.end(), id,
+        [this](size_t a, ID id) {
+            return _entries[a].id < id;
+        });
+    if (it == _by_id.end() || _entries[*it].id != id) {
+        return -1;
+    }
+    return *it;
+}
+
+void StreamIndex::seek(size_t n)
+{
+    const intptr_t offset = position(n);
+    if (_source_h->seek(offset) != offset) {
+        throw EndOfStreamError("Indexed node lies beyond the end of the source.");
+    }
+}
+
+void StreamIndex::read_node(size_t n, StreamSink sink,
+                            ConstRegistryHandle nodetypes)
+{
+    seek(n);
+    FromBitstream reader(_source_h, nodetypes, sink);
+    reader.read_next();
+}
+
+NodeHandle StreamIndex::read_node(size_t n, ConstRegistryHandle nodetypes)
+{
+    ToTree *sink = new ToTree();
+    StreamSink sink_h(sink);
+    read_node(n, sink_h, nodetypes);
+    return *sink->root()->children_begin();
+}
+
+bool StreamIndex::is_trailer(const uint8_t *data, intptr_t len,
+                             intptr_t offset, intptr_t record_len)
+{
+    if (len < footer_size) {
+        return false;
+    }
+    const uint8_t *footer = &data[len - footer_size];
+    return memcmp(&footer[16], index_magic, sizeof(index_magic)) == 0
+        && load_le64(&footer[0]) == (uint64_t)offset
+        && load_le64(&footer[8]) == (uint64_t)record_len;
+}
+
+void StreamIndex::write_trailer(IOIntf *dest,
+                                const std::vector<StreamIndexEntry> &entries,
+                                intptr_t offset)
+{
+    std::vector<uint8_t> payload(
+        (1 + 2*entries.size())*Utils::max_varint_size + footer_size);
+
+    intptr_t len = Utils::encode_varuint(&payload[0], entries.size());
+    intptr_t prev_offset = 0;
+    for (auto &entry: entries) {
+        len += Utils::encode_varuint(&payload[len], entry.id);
+        len += Utils::encode_varuint(&payload[len], entry.offset - prev_offset);
+        prev_offset = entry.offset;
+    }
+
+    uint8_t header[Node::max_header_size + Utils::max_varint_size];
+    intptr_t header_len = Utils::encode_varuint(&header[0], RT_BLOB);
+    header_len += Utils::encode_varuint(&header[header_len], IndexTrailerID);
+    header_len += Utils::encode_varint(&header[header_len], len + footer_size);
+
+    store_le64(&payload[len], offset);
+    store_le64(&payload[len+8], header_len + len + footer_size);
+    memcpy(&payload[len+16], index_magic, sizeof(index_magic));
+    len += footer_size;
+
+    swrite(dest, header, header_len);
+    swrite(dest, payload.data(), len);
+}
+
+}
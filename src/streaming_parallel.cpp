@@ -0,0 +1,284 @@
+/**********************************************************************
+File name: streaming_parallel.cpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#include "structstream/streaming_parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "structstream/errors.hpp"
+#include "structstream/io_memory.hpp"
+#include "structstream/static.hpp"
+#include "structstream/streaming_bitstream.hpp"
+#include "structstream/streaming_cursor.hpp"
+
+namespace StructStream {
+
+/* StructStream::ParallelReader */
+
+ParallelReader::ParallelReader(IOIntfHandle source,
+                               ConstRegistryHandle nodetypes):
+    _source_h(source),
+    _origin(0),
+    _data(nullptr),
+    _len(0),
+    _node_factory_h(nodetypes),
+    _scanned(false),
+    _offsets(),
+    _forgiveness(0)
+{
+    map_source();
+}
+
+ParallelReader::ParallelReader(const StreamIndex &index,
+                               ConstRegistryHandle nodetypes):
+    _source_h(index.source()),
+    _origin(0),
+    _data(nullptr),
+    _len(0),
+    _node_factory_h(nodetypes),
+    _scanned(true),
+    _offsets(),
+    _forgiveness(0)
+{
+    _source_h->seek(0);
+    map_source();
+
+    _offsets.reserve(index.size());
+    for (size_t i = 0; i < index.size(); i++) {
+        const intptr_t position = index.position(i);
+        if (position < _origin || position >= _origin + _len) {
+            throw IllegalData("Stream index points outside of the source.");
+        }
+        _offsets.push_back(position);
+    }
+}
+
+ParallelReader::~ParallelReader()
+{
+
+}
+
+void ParallelReader::map_source()
+{
+    if (!_source_h->contiguous()) {
+        throw UnsupportedInput("Parallel decoding requires a contiguous source.");
+    }
+    _origin = _source_h->seekable() ? _source_h->tell() : 0;
+    _len = _source_h->acquire(&_data, std::numeric_limits<intptr_t>::max());
+}
+
+void ParallelReader::scan()
+{
+    IOIntfHandle view(new MemoryView(_data, _len));
+    BitstreamCursor cursor(view, 0);
+    cursor.set_forgiving_for(_forgiveness);
+
+    CursorEvent ev;
+    // offset of a blob which looks like the index, which it only is
+    // if nothing follows it
+    intptr_t trailer = -1;
+    for (;;) {
+        const intptr_t start = cursor.offset();
+        if (!cursor.next(ev)) {
+            break;
+        }
+        if (trailer >= 0) {
+            _offsets.push_back(_origin + trailer);
+            trailer = -1;
+        }
+        if (ev.kind == CE_START_CONTAINER) {
+            cursor.skip_container();
+        } else if (ev.rt == RT_BLOB && ev.id == IndexTrailerID) {
+            // the payload stays valid as the view does not copy
+            const uint8_t *payload = ev.data;
+            const intptr_t payload_len = ev.len;
+            const intptr_t record_len = cursor.offset() - start;
+            if (StreamIndex::is_trailer(payload, payload_len,
+                                        start, record_len)) {
+                trailer = start;
+                continue;
+            }
+        }
+        _offsets.push_back(_origin + start);
+    }
+    _scanned = true;
+}
+
+void ParallelReader::decode_chunk(const ParallelChunk &chunk,
+                                  StreamSink sink)
+{
+    const intptr_t start = _offsets[chunk.first_node] - _origin;
+    IOIntfHandle view(new MemoryView(_data + start, _len - start));
+    FromBitstream reader(view, _node_factory_h, sink, 0);
+    reader.set_forgiving_for(_forgiveness);
+    for (size_t i = 0; i < chunk.node_count; i++) {
+        reader.read_next();
+    }
+    sink->end_of_stream();
+}
+
+size_t ParallelReader::node_count()
+{
+    if (!_scanned) {
+        scan();
+    }
+    return _offsets.size();
+}
+
+void ParallelReader::read_all(unsigned int threads,
+                              const SinkFactory &make_sink,
+                              const ChunkHandler &handler,
+                              bool ordered,
+                              size_t nodes_per_chunk)
+{
+    const size_t nodes = node_count();
+    if (nodes == 0) {
+        return;
+    }
+
+    if (threads == 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    if (nodes_per_chunk == 0) {
+        nodes_per_chunk = std::max<size_t>(nodes / (threads * 8), 1);
+    }
+    const size_t chunk_count = (nodes + nodes_per_chunk - 1) / nodes_per_chunk;
+    // amount of chunks which may be decoded ahead of the next one to
+    // deliver, in ordered mode
+    const size_t window = 4 * threads;
+
+    std::atomic<size_t> next_chunk(0);
+    std::mutex mutex;
+    std::condition_variable delivered;
+    size_t next_delivery = 0;
+    std::map<size_t, std::pair<ParallelChunk, StreamSink> > pending;
+    std::exception_ptr error;
+    bool abort = false;
+
+    auto worker = [&]() {
+        for (;;) {
+            const size_t index = next_chunk++;
+            if (index >= chunk_count) {
+                return;
+            }
+
+            try {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (ordered) {
+                        delivered.wait(lock, [&]() {
+                            return abort || index < next_delivery + window;
+                        });
+                    }
+                    if (abort) {
+                        return;
+                    }
+                }
+
+                ParallelChunk chunk;
+                chunk.index = index;
+                chunk.first_node = index * nodes_per_chunk;
+                chunk.node_count = std::min(nodes_per_chunk,
+                                            nodes - chunk.first_node);
+
+                StreamSink sink = make_sink(chunk);
+                decode_chunk(chunk, sink);
+
+                std::unique_lock<std::mutex> lock(mutex);
+                if (abort) {
+                    return;
+                }
+                if (!ordered) {
+                    handler(chunk, sink);
+                    continue;
+                }
+
+                pending.insert(std::make_pair(index, std::make_pair(chunk, sink)));
+                auto it = pending.begin();
+                while (it != pending.end() && it->first == next_delivery) {
+                    handler(it->second.first, it->second.second);
+                    it = pending.erase(it);
+                    next_delivery++;
+                }
+                delivered.notify_all();
+            } catch (...) {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                abort = true;
+                delivered.notify_all();
+                return;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    const unsigned int extra = std::min<size_t>(threads, chunk_count) - 1;
+    pool.reserve(extra);
+    try {
+        for (unsigned int i = 0; i < extra; i++) {
+            pool.push_back(std::thread(worker));
+        }
+    } catch (...) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            abort = true;
+            delivered.notify_all();
+        }
+        for (auto &thread: pool) {
+            thread.join();
+        }
+        throw;
+    }
+
+    // the calling thread works too
+    worker();
+    for (auto &thread: pool) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ParallelReader::set_forgiving_for(uint32_t forgiveness, bool forgiving)
+{
+    if (forgiving) {
+        _forgiveness |= forgiveness;
+    } else {
+        _forgiveness &= ~forgiveness;
+    }
+}
+
+}
@@ -0,0 +1,476 @@
+/**********************************************************************
+File name: streaming_push.cpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#include "structstream/streaming_push.hpp"
+
+#include <cassert>
+#include <cstring>
+
+#include "structstream/errors.hpp"
+#include "structstream/io_memory.hpp"
+#include "structstream/node_container.hpp"
+#include "structstream/utils.hpp"
+
+namespace StructStream {
+
+// same limit as in FromBitstream
+static const VarUInt max_hash_length = 1024;
+
+/* StructStream::PushParser */
+
+PushParser::PushParser(const ConstRegistryHandle nodetypes, StreamSink sink):
+    _node_factory_h(nodetypes),
+    _node_factory(nodetypes.get()),
+    _sink_h(sink),
+    _sink(sink.get()),
+    _stack(),
+    _buffer(),
+    _needed(0),
+    _skip_remaining(0),
+    _finished(false),
+    _input(nullptr),
+    _record_start(0),
+    _skipped(),
+    _forgiveness(0)
+{
+    push_frame(ContainerHandle());
+    _stack.back().armored = true;
+}
+
+PushParser::~PushParser()
+{
+    for (auto &frame: _stack) {
+        delete frame.hash;
+    }
+}
+
+void PushParser::check_end_of_container()
+{
+    Frame &frame = _stack.back();
+    if (!frame.armored
+        && frame.meta.child_count == frame.read_child_count)
+    {
+        frame.ended = true;
+    }
+}
+
+void PushParser::consume_record(const MemoryView &view)
+{
+    const intptr_t end = view.tell();
+    hash_input(&_input[_record_start], end - _record_start);
+    _record_start = end;
+}
+
+void PushParser::end_of_stream()
+{
+    _finished = true;
+    _sink->end_of_stream();
+}
+
+void PushParser::hash_input(const uint8_t *data, intptr_t len)
+{
+    for (auto &frame: _stack) {
+        if (frame.hash) {
+            frame.hash->feed(data, len);
+        }
+    }
+}
+
+intptr_t PushParser::parse(const uint8_t *data, intptr_t len)
+{
+    MemoryView view(data, len);
+    _input = data;
+    _record_start = 0;
+    _needed = 0;
+
+    while (!_finished) {
+        if (_skip_remaining > 0) {
+            if (_record_start == len) {
+                break;
+            }
+            const intptr_t available = len - _record_start;
+            const intptr_t to_skip =
+                (_skip_remaining < (VarUInt)available
+                 ? (intptr_t)_skip_remaining
+                 : available);
+            view.seek(_record_start + to_skip);
+            consume_record(view);
+            _skip_remaining -= to_skip;
+            continue;
+        }
+
+        // footers of containers without hash take no bytes
+        if (_record_start == len && !_stack.back().ended) {
+            break;
+        }
+
+        try {
+            if (!read_step(view)) {
+                break;
+            }
+        } catch (EndOfStreamError &err) {
+            // at least one more byte is needed to make progress
+            _needed = len - _record_start + 1;
+            break;
+        } catch (SinkClosed &err) {
+            close();
+            return view.tell();
+        }
+    }
+
+    return _record_start;
+}
+
+void PushParser::pop_frame()
+{
+    delete _stack.back().hash;
+    _stack.pop_back();
+}
+
+void PushParser::push_frame(ContainerHandle cont_h)
+{
+    _stack.push_back(Frame());
+    Frame &frame = _stack.back();
+    frame.cont = cont_h;
+    frame.footer.validated = false;
+    frame.footer.hash_function = HT_NONE;
+    frame.hash = nullptr;
+    frame.read_child_count = 0;
+    frame.armored = false;
+    frame.ended = false;
+}
+
+void PushParser::read_container(MemoryView &view, ContainerHandle cont_h)
+{
+    VarUInt flags_int = Utils::read_varuint(&view);
+
+    intptr_t child_count = -1;
+    HashType hash_function = HT_NONE;
+    intptr_t body_length = -1;
+    bool armored = false;
+
+    if ((flags_int & CF_WITH_SIZE) != 0) {
+        flags_int ^= CF_WITH_SIZE;
+        child_count = Utils::read_varuint(&view);
+    }
+
+    if ((flags_int & CF_ARMORED) != 0) {
+        flags_int ^= CF_ARMORED;
+        armored = true;
+    }
+
+    if (!armored && (child_count == -1)) {
+        throw IllegalCombinationOfFlags("Illegal combination of container flags: no CF_WITH_SIZE, but no CF_ARMORED either -- how am I supposed to find out the length?");
+    }
+
+    if ((flags_int & CF_HASHED) != 0) {
+        flags_int ^= CF_HASHED;
+        hash_function = static_cast<HashType>(Utils::read_varuint(&view));
+    }
+
+    if ((flags_int & CF_WITH_LENGTH) != 0) {
+        flags_int ^= CF_WITH_LENGTH;
+        body_length = Utils::read_varuint(&view);
+        if (body_length < 0) {
+            throw IllegalData("Container body length out of range.");
+        }
+    }
+
+    if (flags_int != 0) {
+        if ((_forgiveness & FromBitstream::UnknownContainerFlags) == 0) {
+            throw UnsupportedContainerFlags("Unsupported container flags encountered.");
+        }
+    }
+
+    // the header is complete, everything below consumes it
+    consume_record(view);
+
+    if (body_length >= 0 && !_skipped.empty()
+        && _skipped.count(std::pair<RecordType, ID>(
+                              cont_h->record_type(), cont_h->id())) > 0)
+    {
+        _stack.back().read_child_count++;
+        check_end_of_container();
+        _skip_remaining = body_length;
+        return;
+    }
+
+    IncrementalHash *hash = nullptr;
+    if (hash_function != HT_NONE) {
+        hash = hashes.get_hash(hash_function);
+        if ((hash == nullptr)
+            && ((_forgiveness & FromBitstream::UnknownHashFunction) == 0))
+        {
+            throw UnsupportedHashFunction("Unsupported hash function.");
+        }
+    }
+
+    push_frame(cont_h);
+    Frame &frame = _stack.back();
+    frame.meta.child_count = child_count;
+    frame.meta.has_hash = (hash_function != HT_NONE);
+    frame.meta.body_length = body_length;
+    frame.footer.hash_function = hash_function;
+    frame.hash = hash;
+    frame.armored = armored;
+
+    if (!_sink->start_container(cont_h, &frame.meta)) {
+        throw SinkClosed();
+    }
+
+    check_end_of_container();
+}
+
+void PushParser::read_footer(MemoryView &view)
+{
+    Frame &frame = _stack.back();
+
+    if (frame.footer.hash_function != HT_NONE) {
+        VarUInt hash_length = Utils::read_varuint(&view);
+        if (hash_length > max_hash_length) {
+            throw LimitError(std::string("Max hash length violated: ") + std::to_string(hash_length));
+        }
+
+        uint8_t hash_from_stream[max_hash_length];
+        sread(&view, hash_from_stream, hash_length);
+
+        // hash checking may be disabled for this container (e.g.
+        // forgiving mode)
+        if (frame.hash) {
+            if ((intptr_t)hash_length != frame.hash->len()) {
+                throw IllegalData("hash length does not match with what we know about the hash function.");
+            }
+
+            uint8_t hash_calculated[max_hash_length];
+            frame.hash->finish(hash_calculated);
+
+            if (memcmp(hash_from_stream, hash_calculated, hash_length) != 0) {
+                if ((_forgiveness & FromBitstream::ChecksumErrors) == 0) {
+                    throw HashCheckError("calculated and bitstream checksum do not match.");
+                }
+            } else {
+                frame.footer.validated = true;
+            }
+        }
+    }
+
+    frame.cont->set_hashed(
+        frame.footer.validated,
+        frame.footer.hash_function
+    );
+
+    ContainerFooter footer(frame.footer);
+    pop_frame();
+    // the footer belongs to the surrounding containers
+    consume_record(view);
+
+    if (!_sink->end_container(&footer)) {
+        throw SinkClosed();
+    }
+
+    _stack.back().read_child_count++;
+    check_end_of_container();
+}
+
+bool PushParser::read_step(MemoryView &view)
+{
+    if (_stack.back().ended) {
+        read_footer(view);
+        return true;
+    }
+
+    RecordType rt = Utils::read_record_type(&view);
+    Frame &curr = _stack.back();
+    if (rt == RT_RESERVED) {
+        throw UnsupportedRecordType("RT_RESERVED encountered. This stream may have been created with a newer version of structstream.");
+    } else if (rt == RT_END_OF_CHILDREN) {
+        if (!curr.armored) {
+            throw UnexpectedEndOfChildren("Non-armored container closed by End-Of-Children tag. This may also imply that some children are missing.");
+        }
+        if (curr.meta.child_count != -1
+            && curr.meta.child_count != curr.read_child_count
+            && (_forgiveness & FromBitstream::PrematureEndOfContainer) == 0)
+        {
+            throw UnexpectedEndOfChildren("Armored container ended unexpectedly (not all announced children found).");
+        }
+
+        consume_record(view);
+        if (_stack.size() == 1) {
+            end_of_stream();
+        } else {
+            curr.ended = true;
+        }
+        return true;
+    }
+
+    if (curr.armored
+        && curr.meta.child_count != -1
+        && curr.meta.child_count <= curr.read_child_count)
+    {
+        throw MissingEndOfChildren("CF_ARMORED | CF_WITH_SIZE container without EOC marker.");
+    }
+
+    ID id = Utils::read_id(&view);
+    if (id == InvalidID) {
+        throw InvalidIDError("Invalid object ID encountered.");
+    }
+
+    const bool appblob = (rt >= RT_APPBLOB_MIN) && (rt <= RT_APPBLOB_MAX);
+    NodeHandle new_node = _node_factory->node_from_record_type(rt, id);
+    if (!new_node.get()) {
+        if (appblob && ((_forgiveness & FromBitstream::UnknownAppblobs) != 0)) {
+            // skipped as if it didn't exist, see FromBitstream
+            VarUInt blob_size = Utils::read_varuint(&view);
+            consume_record(view);
+            curr.read_child_count++;
+            check_end_of_container();
+            _skip_remaining = blob_size;
+            return true;
+        } else {
+            throw UnsupportedRecordType("Unsupported record type.");
+        }
+    }
+
+    if (new_node->is_container()) {
+        read_container(view, std::static_pointer_cast<Container>(new_node));
+        return true;
+    }
+
+    if (appblob || rt == RT_UTF8STRING || rt == RT_BLOB) {
+        // wait for the whole payload instead of trying again on each
+        // piece of it
+        const intptr_t payload_start = view.tell();
+        const VarInt length = (appblob
+                               ? (VarInt)Utils::read_varuint(&view)
+                               : Utils::read_varint(&view));
+        const intptr_t available = view.size() - view.tell();
+        if (length > available) {
+            _needed = view.tell() - _record_start + length;
+            return false;
+        }
+        view.seek(payload_start);
+    }
+
+    new_node->read(&view);
+    consume_record(view);
+    if (!_sink->push_node(new_node)) {
+        throw SinkClosed();
+    }
+
+    curr.read_child_count++;
+    check_end_of_container();
+    return true;
+}
+
+intptr_t PushParser::feed(const uint8_t *data, intptr_t len)
+{
+    if (_finished) {
+        return 0;
+    }
+
+    // bytes of *data* which have been moved into the buffer
+    intptr_t offset = 0;
+    const intptr_t kept = _buffer.size();
+    while (!_buffer.empty()) {
+        // complete the record left over from the last piece, taking
+        // only as many bytes as it needs at least
+        intptr_t amount = _needed - (intptr_t)_buffer.size();
+        if (amount < 1) {
+            amount = 1;
+        }
+        if (amount > len - offset) {
+            amount = len - offset;
+        }
+        if (amount == 0) {
+            return len;
+        }
+        _buffer.insert(_buffer.end(), data + offset, data + offset + amount);
+        offset += amount;
+        if ((intptr_t)_buffer.size() < _needed) {
+            return len;
+        }
+
+        const intptr_t consumed = parse(_buffer.data(), _buffer.size());
+        if (_finished) {
+            _buffer.clear();
+            return consumed - kept;
+        }
+        if (consumed > 0) {
+            // the pending record ends within *data*; whatever follows
+            // it is parsed in place below
+            assert(consumed > kept);
+            offset = consumed - kept;
+            _buffer.clear();
+        }
+    }
+
+    const intptr_t consumed = parse(data + offset, len - offset);
+    if (_finished) {
+        return offset + consumed;
+    }
+    _buffer.assign(data + offset + consumed, data + len);
+    return len;
+}
+
+void PushParser::finish()
+{
+    if (!_finished) {
+        throw EndOfStreamError("Premature end-of-stream while reading.");
+    }
+}
+
+void PushParser::close()
+{
+    for (auto &frame: _stack) {
+        delete frame.hash;
+    }
+    _stack.clear();
+    _buffer.clear();
+    _needed = 0;
+    _skip_remaining = 0;
+    _sink = nullptr;
+    _sink_h = StreamSink();
+    _finished = true;
+}
+
+void PushParser::set_forgiving_for(uint32_t forgiveness, bool forgiving)
+{
+    if (forgiving) {
+        _forgiveness |= forgiveness;
+    } else {
+        _forgiveness &= ~forgiveness;
+    }
+}
+
+void PushParser::set_skip(RecordType rt, ID id, bool skip)
+{
+    if (skip) {
+        _skipped.insert(std::pair<RecordType, ID>(rt, id));
+    } else {
+        _skipped.erase(std::pair<RecordType, ID>(rt, id));
+    }
+}
+
+}
@@ -36,9 +36,10 @@ namespace StructStream {
 /* StructStream::SinkTree */
 
 SinkTree::SinkTree():
-    _nested(),
+    _root(this),
+    _level(0),
     _handling_container(false),
-    _depth(0)
+    _stack()
 {
 
 }
@@ -50,58 +51,80 @@ SinkTree::~SinkTree()
 
 void SinkTree::nest(StreamSink other)
 {
-    assert(_nested.get() == nullptr);
+    std::vector<Frame> &stack = _root->_stack;
+    assert(stack.size() == _level);
     if (!_handling_container) {
         throw std::logic_error("nest() can only be called inside of start_container() handler.");
     }
 
-    _nested = other;
-    // printf("sinktree: nested %lx\n", (uint64_t)_nested.get());
-    _depth = 1;
+    SinkTree *tree = dynamic_cast<SinkTree*>(other.get());
+    if (tree) {
+        assert(tree->_stack.empty());
+        tree->_root = _root;
+        tree->_level = _level + 1;
+    }
+    stack.push_back(Frame{other, tree, 1});
 }
 
 bool SinkTree::start_container(ContainerHandle cont, const ContainerMeta *meta)
 {
-    if (_nested.get() != nullptr) {
-        _depth += 1;
-        // printf("sinktree: forwarding to nested %lx\n", (uint64_t)_nested.get());
-        return _nested->start_container(cont, meta);
-    } else {
-        _handling_container = true;
-        // printf("sinktree: handling start_container\n");
-        bool result = _start_container(cont, meta);
-        _handling_container = false;
-        return result;
+    SinkTree *handler = this;
+    if (!_stack.empty()) {
+        Frame &top = _stack.back();
+        top.depth += 1;
+        if (!top.tree) {
+            return top.sink->start_container(cont, meta);
+        }
+        handler = top.tree;
     }
+
+    handler->_handling_container = true;
+    bool result = handler->_start_container(cont, meta);
+    handler->_handling_container = false;
+    return result;
 }
 
 bool SinkTree::push_node(NodeHandle node)
 {
-    if (_nested.get() != nullptr) {
-        // printf("sinktree: forwarding to nested %lx\n", (uint64_t)_nested.get());
-        return _nested->push_node(node);
-    } else {
-        // printf("sinktree: handling push_node\n");
+    if (_stack.empty()) {
         return _push_node(node);
     }
+
+    Frame &top = _stack.back();
+    if (top.tree) {
+        return top.tree->_push_node(node);
+    }
+    return top.sink->push_node(node);
 }
 
 bool SinkTree::end_container(const ContainerFooter *foot)
 {
-    if (_nested.get() != nullptr) {
-        _depth -= 1;
-        if (_depth == 0) {
-            // printf("sinktree: ended nested %lx\n", (uint64_t)_nested.get());
-            _nested = StreamSink();
-            return _end_container(foot);
-        } else {
-            // printf("sinktree: forwarding to nested %lx\n", (uint64_t)_nested.get());
-            return _nested->end_container(foot);
-        }
-    } else {
-        // printf("sinktree: handling end_of_container\n");
+    if (_stack.empty()) {
         return _end_container(foot);
     }
+
+    Frame &top = _stack.back();
+    top.depth -= 1;
+    if (top.depth > 0) {
+        if (top.tree) {
+            return top.tree->_end_container(foot);
+        }
+        return top.sink->end_container(foot);
+    }
+
+    // the container which caused the nesting has ended
+    if (top.tree) {
+        top.tree->_root = top.tree;
+        top.tree->_level = 0;
+    }
+    _stack.pop_back();
+
+    SinkTree *owner = this;
+    if (!_stack.empty()) {
+        owner = _stack.back().tree;
+        _stack.back().depth -= 1;
+    }
+    return owner->_end_container(foot);
 }
 
 void SinkTree::end_of_stream()
@@ -221,7 +244,7 @@ void SinkDebug::node_info(const NodeHandle &node)
 bool SinkDebug::start_container(ContainerHandle cont, const ContainerMeta *meta)
 {
     _dest << _indent << "|- cont ";
-    node_info(std::dynamic_pointer_cast<Node>(cont));
+    node_info(cont);
     _dest << std::endl;
     _indent += "|   ";
     return true;
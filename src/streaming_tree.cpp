@@ -129,7 +129,7 @@ bool ToTree::end_container(const ContainerFooter *foot)
 
 bool subtree_to_sink(StreamSink sink, NodeHandle subtree)
 {
-    Container *cont = dynamic_cast<Container*>(subtree.get());
+    Container *cont = node_cast<Container>(subtree.get());
     if (cont != nullptr) {
         ContainerMeta meta;
         meta.child_count = cont->child_count();
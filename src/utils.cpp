@@ -28,9 +28,15 @@ authors named in the AUTHORS file.
 #include <cassert>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 
 #include "structstream/errors.hpp"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STRUCTSTREAM_BATCH_X86
+#include <immintrin.h>
+#endif
+
 namespace StructStream { namespace Utils {
 
 template <typename int_type>
@@ -80,57 +86,121 @@ struct platform_utils<long long unsigned int>
 
 using namespace StructStream;
 
-VarUInt read_varuint_ex(IOIntf *stream, intptr_t *overlen, uint_fast8_t *bytecount)
+/**
+ * Return the number of bytes following the *leading* byte of a
+ * varuint.
+ */
+static inline uint_fast8_t varuint_tail_length(const uint8_t leading)
+{
+    if (leading == 0x00) {
+        throw InvalidVarIntError("0x00 is not a valid Var(U)Int.");
+    }
+    // GCC rulez
+    return __builtin_clz(leading)-24;
+}
+
+/**
+ * Assemble a varuint from its *leading* byte and the *count* bytes
+ * at *tail*.
+ */
+static inline VarUInt decode_varuint(const uint8_t leading,
+                                     const uint8_t *tail,
+                                     const uint_fast8_t count,
+                                     intptr_t *overlen,
+                                     uint_fast8_t *bytecount)
 {
-    VarUInt result = 0;
-    uint8_t leading = 0;
-    sread(stream, &leading, sizeof(uint8_t));
     if (overlen) {
         *overlen = 0;
     }
-    if (leading == 0x00) {
-        throw InvalidVarIntError("0x00 is not a valid Var(U)Int.");
+    if (bytecount) {
+        *bytecount = count+1;
     }
     if (leading == 0x80) {
-        if (bytecount) {
-            *bytecount = 1;
-        }
         return 0;
     }
 
-    // GCC rulez
-    uint8_t count = __builtin_clz(leading)-24;
-    result |= ((uint64_t)(leading & (0xFF >> (count+1))) << count*8);
-    if (bytecount) {
-        *bytecount = count+1;
-    }
+    VarUInt result = ((uint64_t)(leading & (0xFF >> (count+1))) << count*8);
     if (overlen && (result == 0))  {
         *overlen += 1;
     }
-    if (count == 0) {
-        return result;
-    }
-
-    // this size must be increased if we ever support more than 8-byte
-    // varuints.
-    uint8_t buffer[7];
-    assert(count <= 7);
-    sread(stream, buffer, count);
 
     for (int idx = 0; idx < count; idx++) {
         if (overlen) {
-            if (buffer[idx] == 0) {
+            if (tail[idx] == 0) {
                 *overlen += 1;
             } else {
                 *overlen = 0;
             }
         }
-        result |= ((uint64_t)(buffer[idx]) << ((count-idx)-1)*8);
+        result |= ((uint64_t)(tail[idx]) << ((count-idx)-1)*8);
     }
 
     return result;
 }
 
+/**
+ * Decode the varuint at *buf*, which must have at least eight
+ * readable bytes, with a single load. Return the number of bytes the
+ * varuint occupies.
+ */
+static inline uint_fast8_t decode_varuint_word(const uint8_t *buf,
+                                               VarUInt *result)
+{
+    uint64_t word = 0;
+    memcpy(&word, buf, sizeof(uint64_t));
+    if (!is_big_endian) {
+        word = __builtin_bswap64(word);
+    }
+    if ((word >> 56) == 0) {
+        throw InvalidVarIntError("0x00 is not a valid Var(U)Int.");
+    }
+
+    // the marker bit of the leading byte determines the length
+    const uint_fast8_t length = __builtin_clzll(word) + 1;
+    const uint64_t mask = ((uint64_t)1 << (7*length)) - 1;
+    *result = (word >> (64 - 8*length)) & mask;
+    return length;
+}
+
+VarUInt read_varuint_ex(IOIntf *stream, intptr_t *overlen, uint_fast8_t *bytecount)
+{
+    // decode in place if the source lets us look at its buffer
+    const uint8_t *direct = nullptr;
+    const intptr_t available = stream->acquire(&direct, sizeof(uint64_t));
+    if (available >= (intptr_t)sizeof(uint64_t) && !overlen) {
+        VarUInt result = 0;
+        const uint_fast8_t length = decode_varuint_word(direct, &result);
+        stream->commit(length);
+        if (bytecount) {
+            *bytecount = length;
+        }
+        return result;
+    }
+    if (available >= 1) {
+        const uint_fast8_t count = varuint_tail_length(direct[0]);
+        if (available > count) {
+            const VarUInt result = decode_varuint(
+                direct[0], &direct[1], count, overlen, bytecount);
+            stream->commit(count+1);
+            return result;
+        }
+    }
+
+    uint8_t leading = 0;
+    sread(stream, &leading, sizeof(uint8_t));
+    const uint_fast8_t count = varuint_tail_length(leading);
+
+    // this size must be increased if we ever support more than 8-byte
+    // varuints.
+    uint8_t buffer[7];
+    assert(count <= 7);
+    if (count > 0) {
+        sread(stream, buffer, count);
+    }
+
+    return decode_varuint(leading, buffer, count, overlen, bytecount);
+}
+
 VarInt read_varint(IOIntf *stream)
 {
     uint_fast8_t bytecount = 0;
@@ -169,16 +239,19 @@ inline uint_fast8_t bytecount_from_varuint(VarUInt value)
     return bytecount;
 }
 
-void write_varbuf_ex(IOIntf *stream, VarUInt buf, uint_fast8_t bytecount)
+intptr_t encode_varbuf_ex(uint8_t *dest, VarUInt buf, uint_fast8_t bytecount)
 {
     if (buf == 0) {
-        swritev<uint8_t>(stream, 0x80);
-        return;
+        dest[0] = 0x80;
+        return 1;
     }
 
     // printf("serializing varint 0x%lx; maxbit = %d; bytes = %d\n", value, bitcount, bytecount);
 
     assert(bytecount > 0);
+    if (bytecount > max_varint_size) {
+        throw LimitError("Value out of range for varint encoding.");
+    }
 
     uint8_t leading = ((uint8_t)0x80 >> (bytecount-1));
     const VarUInt leading_premask = (VarUInt)0xff << ((bytecount-1)*8);
@@ -193,22 +266,25 @@ void write_varbuf_ex(IOIntf *stream, VarUInt buf, uint_fast8_t bytecount)
 
     // printf("  => leading = 0x%x\n", leading);
 
-    swritev<uint8_t>(stream, leading);
+    dest[0] = leading;
 
     for (int_fast8_t i = bytecount - 2;
          i >= 0;
          i--)
     {
-        const VarUInt mask = (VarUInt)0xff << (i*8);
-        // printf("  i = %d\n", i);
-        // printf("    mask = %lx\n", mask);
-        const uint8_t masked = (buf & mask) >> (i*8);
-        // printf("    masked = %x\n", masked);
-        swritev<uint8_t>(stream, masked);
+        dest[bytecount-1-i] = (buf >> (i*8)) & 0xff;
     }
+
+    return bytecount;
 }
 
-void write_varint(IOIntf *stream, VarInt value)
+void write_varbuf_ex(IOIntf *stream, VarUInt buf, uint_fast8_t bytecount)
+{
+    uint8_t encoded[max_varint_size];
+    swrite(stream, encoded, encode_varbuf_ex(encoded, buf, bytecount));
+}
+
+intptr_t encode_varint(uint8_t *dest, VarInt value)
 {
     VarUInt enc_value = 0;
     if (value < 0) {
@@ -228,12 +304,24 @@ void write_varint(IOIntf *stream, VarInt value)
         enc_value |= (VarUInt(1) << (bytecount*7-1));
     }
 
-    write_varbuf_ex(stream, enc_value, bytecount);
+    return encode_varbuf_ex(dest, enc_value, bytecount);
+}
+
+intptr_t encode_varuint(uint8_t *dest, VarUInt value)
+{
+    return encode_varbuf_ex(dest, value, bytecount_from_varuint(value));
+}
+
+void write_varint(IOIntf *stream, VarInt value)
+{
+    uint8_t encoded[max_varint_size];
+    swrite(stream, encoded, encode_varint(encoded, value));
 }
 
 void write_varuint(IOIntf *stream, VarUInt value)
 {
-    write_varbuf_ex(stream, value, bytecount_from_varuint(value));
+    uint8_t encoded[max_varint_size];
+    swrite(stream, encoded, encode_varuint(encoded, value));
 }
 
 void write_id(IOIntf *stream, ID value)
@@ -246,5 +334,214 @@ void write_record_type(IOIntf *stream, RecordType value)
     write_varuint(stream, static_cast<RecordType>(value));
 }
 
+/* batch varuint coding */
+
+/**
+ * Decode varuints one by one, starting at *pos*. Used on its own if
+ * no vector unit is available and for the tail of the buffer
+ * otherwise.
+ */
+static size_t read_varuints_scalar(const uint8_t *buf, size_t len,
+                                   VarUInt *out, size_t n, size_t pos)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (pos + sizeof(uint64_t) <= len) {
+            pos += decode_varuint_word(&buf[pos], &out[i]);
+            continue;
+        }
+
+        if (pos >= len) {
+            throw EndOfStreamError("Premature end-of-buffer while decoding varuints.");
+        }
+        const uint_fast8_t count = varuint_tail_length(buf[pos]);
+        if (pos + 1 + count > len) {
+            throw EndOfStreamError("Premature end-of-buffer while decoding varuints.");
+        }
+        out[i] = decode_varuint(buf[pos], &buf[pos+1], count, nullptr, nullptr);
+        pos += count + 1;
+    }
+    return pos;
+}
+
+#ifdef STRUCTSTREAM_BATCH_X86
+
+/**
+ * Shuffle control and value masks to decode two varuints of given
+ * lengths from one 16 byte vector into two 64 bit lanes.
+ */
+struct varuint_pair_decoder {
+    alignas(16) uint8_t shuffle[16];
+    alignas(16) uint64_t mask[2];
+};
+
+struct varuint_pair_table {
+    varuint_pair_table()
+    {
+        for (int l0 = 1; l0 <= 8; l0++) {
+            for (int l1 = 1; l1 <= 8; l1++) {
+                varuint_pair_decoder &entry = entries[(l0-1)*8+(l1-1)];
+                // byte-reverse each varuint into its lane, zero the rest
+                for (int j = 0; j < 8; j++) {
+                    entry.shuffle[j] = (j < l0 ? l0-1-j : 0x80);
+                    entry.shuffle[8+j] = (j < l1 ? l0+l1-1-j : 0x80);
+                }
+                // strip the length marker
+                entry.mask[0] = ((uint64_t)1 << (7*l0)) - 1;
+                entry.mask[1] = ((uint64_t)1 << (7*l1)) - 1;
+            }
+        }
+    };
+
+    varuint_pair_decoder entries[64];
+};
+
+static const varuint_pair_table &pair_table()
+{
+    static const varuint_pair_table table;
+    return table;
+}
+
+static inline uint_fast8_t varuint_length(const uint8_t leading)
+{
+    return varuint_tail_length(leading) + 1;
+}
+
+/**
+ * Decode pairs of varuints while at least 16 bytes are left.
+ */
+__attribute__((target("sse4.1")))
+static inline size_t read_varuint_pairs_sse41(
+    const varuint_pair_table &table,
+    const uint8_t *buf, size_t len,
+    VarUInt *out, size_t *i, size_t n, size_t pos)
+{
+    while (*i + 2 <= n && pos + 16 <= len) {
+        const uint_fast8_t l0 = varuint_length(buf[pos]);
+        const uint_fast8_t l1 = varuint_length(buf[pos+l0]);
+        const varuint_pair_decoder &entry = table.entries[(l0-1)*8+(l1-1)];
+
+        __m128i data = _mm_loadu_si128((const __m128i*)&buf[pos]);
+        data = _mm_shuffle_epi8(
+            data, _mm_load_si128((const __m128i*)entry.shuffle));
+        data = _mm_and_si128(
+            data, _mm_load_si128((const __m128i*)entry.mask));
+        _mm_storeu_si128((__m128i*)&out[*i], data);
+
+        *i += 2;
+        pos += l0 + l1;
+    }
+    return pos;
+}
+
+__attribute__((target("sse4.1")))
+static size_t read_varuints_sse41(const uint8_t *buf, size_t len,
+                                  VarUInt *out, size_t n)
+{
+    size_t i = 0;
+    const size_t pos = read_varuint_pairs_sse41(
+        pair_table(), buf, len, out, &i, n, 0);
+    return read_varuints_scalar(buf, len, &out[i], n - i, pos);
+}
+
+__attribute__((target("avx2")))
+static size_t read_varuints_avx2(const uint8_t *buf, size_t len,
+                                 VarUInt *out, size_t n)
+{
+    const varuint_pair_table &table = pair_table();
+    size_t i = 0;
+    size_t pos = 0;
+
+    // two pairs per iteration; the second pair starts at most 16
+    // bytes in, so 32 bytes must be left
+    while (i + 4 <= n && pos + 32 <= len) {
+        const uint_fast8_t l0 = varuint_length(buf[pos]);
+        const uint_fast8_t l1 = varuint_length(buf[pos+l0]);
+        const size_t pos_hi = pos + l0 + l1;
+        const uint_fast8_t l2 = varuint_length(buf[pos_hi]);
+        const uint_fast8_t l3 = varuint_length(buf[pos_hi+l2]);
+        const varuint_pair_decoder &entry_lo = table.entries[(l0-1)*8+(l1-1)];
+        const varuint_pair_decoder &entry_hi = table.entries[(l2-1)*8+(l3-1)];
+
+        __m256i data = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(
+                _mm_loadu_si128((const __m128i*)&buf[pos])),
+            _mm_loadu_si128((const __m128i*)&buf[pos_hi]), 1);
+        const __m256i shuffle = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(
+                _mm_load_si128((const __m128i*)entry_lo.shuffle)),
+            _mm_load_si128((const __m128i*)entry_hi.shuffle), 1);
+        const __m256i mask = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(
+                _mm_load_si128((const __m128i*)entry_lo.mask)),
+            _mm_load_si128((const __m128i*)entry_hi.mask), 1);
+
+        data = _mm256_and_si256(_mm256_shuffle_epi8(data, shuffle), mask);
+        _mm256_storeu_si256((__m256i*)&out[i], data);
+
+        i += 4;
+        pos = pos_hi + l2 + l3;
+    }
+
+    pos = read_varuint_pairs_sse41(table, buf, len, out, &i, n, pos);
+    return read_varuints_scalar(buf, len, &out[i], n - i, pos);
+}
+
+#endif
+
+static size_t read_varuints_generic(const uint8_t *buf, size_t len,
+                                    VarUInt *out, size_t n)
+{
+    return read_varuints_scalar(buf, len, out, n, 0);
+}
+
+typedef size_t (*varuint_batch_decoder)(const uint8_t*, size_t, VarUInt*, size_t);
+
+static varuint_batch_decoder select_batch_decoder()
+{
+#ifdef STRUCTSTREAM_BATCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return &read_varuints_avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return &read_varuints_sse41;
+    }
+#endif
+    return &read_varuints_generic;
+}
+
+size_t read_varuints(const uint8_t *buf, size_t len, VarUInt *out, size_t n)
+{
+    static const varuint_batch_decoder decoder = select_batch_decoder();
+    return decoder(buf, len, out, n);
+}
+
+size_t encode_varuints(uint8_t *dest, const VarUInt *values, size_t n)
+{
+    size_t pos = 0;
+    for (size_t i = 0; i < n; i++) {
+        const VarUInt value = values[i];
+        uint_fast8_t length = 1;
+        if (value != 0) {
+            length = bytecount_from_varuint(value);
+            if (length > max_varint_size) {
+                throw LimitError("Value out of range for varint encoding.");
+            }
+        }
+
+        // place the marker bit above the value, move the encoded
+        // bytes to the top and store all eight of them; the next
+        // value overwrites the surplus
+        const uint64_t marker = (uint64_t)1 << (7*length);
+        uint64_t word = (value | marker) << (64 - 8*length);
+        if (!is_big_endian) {
+            word = __builtin_bswap64(word);
+        }
+        memcpy(&dest[pos], &word, sizeof(uint64_t));
+        pos += length;
+    }
+    return pos;
+}
+
 }
 }
@@ -193,6 +193,23 @@ public:
     UnsupportedHashFunction(const UnsupportedHashFunction &ref) = default;
 };
 
+/**
+ * The operating system reported an error while accessing a file or
+ * descriptor.
+ */
+class IOError: public std::runtime_error {
+public:
+    IOError(const std::string& what_arg): std::runtime_error(what_arg) {};
+    IOError(const char *what_arg): std::runtime_error(what_arg) {};
+    IOError(const IOError &ref) = default;
+
+    /**
+     * Create an error from *what_arg* and the description of the
+     * current errno value.
+     */
+    static IOError from_errno(const std::string& what_arg);
+};
+
 /**
  * The input data violated a limit set by the application or
  * defaults.
@@ -30,6 +30,14 @@ authors named in the AUTHORS file.
 #include "structstream/io_memory.hpp"
 #include "structstream/io_std.hpp"
 #include "structstream/io_hash.hpp"
+#include "structstream/io_buffered.hpp"
+#include "structstream/io_mmap.hpp"
+#include "structstream/io_segmented.hpp"
+#include "structstream/io_fd.hpp"
+#include "structstream/io_async.hpp"
+#include "structstream/io_pipe.hpp"
+
+#include <cstring>
 
 namespace StructStream {
 
@@ -46,6 +54,12 @@ inline void swritev(IOIntf *io, const _T value)
 template <class _T>
 inline void sreadv(IOIntf *io, _T *value)
 {
+    const uint8_t *direct = nullptr;
+    if (io->acquire(&direct, sizeof(_T)) >= (intptr_t)sizeof(_T)) {
+        memcpy(value, direct, sizeof(_T));
+        io->commit(sizeof(_T));
+        return;
+    }
     sread(io, value, sizeof(_T));
 }
 
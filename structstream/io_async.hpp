@@ -0,0 +1,205 @@
+/**********************************************************************
+File name: io_async.hpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#ifndef _STRUCTSTREAM_IO_ASYNC_H
+#define _STRUCTSTREAM_IO_ASYNC_H
+
+#include <string>
+#include <exception>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "structstream/io_base.hpp"
+
+namespace StructStream {
+
+class AsyncBackend;
+
+/**
+ * Read a file with several blocks read ahead asynchronously, so that
+ * decoding the current block overlaps with the disk latency of the
+ * following ones.
+ *
+ * Requests are passed to io_uring if the kernel supports it (and
+ * structstream++ was built with its headers available). Otherwise,
+ * or if *try_io_uring* is false, blocks are read synchronously with
+ * pread().
+ *
+ * The descriptor must refer to a seekable file; reading starts at
+ * its current offset. Errors throw IOError.
+ */
+struct AsyncFileInput: public IOIntf {
+public:
+    static const intptr_t default_block_size = 262144;
+    static const intptr_t default_depth = 4;
+
+public:
+    /**
+     * Read from *fd*, which is closed on destruction if *owns_fd* is
+     * true. Up to *depth* blocks of *block_size* bytes are in flight.
+     */
+    AsyncFileInput(int fd, bool owns_fd = false,
+                   intptr_t block_size = default_block_size,
+                   intptr_t depth = default_depth,
+                   bool try_io_uring = true);
+
+    /**
+     * Open and read the file at *path*.
+     */
+    AsyncFileInput(const std::string &path,
+                   intptr_t block_size = default_block_size,
+                   intptr_t depth = default_depth,
+                   bool try_io_uring = true);
+    AsyncFileInput(const AsyncFileInput &ref) = delete;
+    virtual ~AsyncFileInput();
+    AsyncFileInput &operator=(const AsyncFileInput &ref) = delete;
+private:
+    struct Block {
+        uint8_t *data;
+        off_t offset;
+        intptr_t len;
+        intptr_t offs;
+        bool pending;
+    };
+
+private:
+    int _fd;
+    bool _owns_fd;
+    intptr_t _block_size;
+    AsyncBackend *_backend;
+    std::vector<Block> _blocks;
+    intptr_t _current;
+    off_t _next_offset;
+    bool _eof;
+    off_t _eof_offset;
+
+private:
+    void setup(bool try_io_uring);
+    void teardown();
+    void submit(intptr_t index);
+    void complete(intptr_t index, intptr_t result);
+    void wait_for(intptr_t index);
+    std::exception_ptr drain();
+    void restart(off_t offset);
+    Block *current_block();
+public:
+    /**
+     * Return true if requests go through io_uring.
+     */
+    bool uses_io_uring() const;
+
+    virtual intptr_t read(void *buf, const intptr_t len);
+    virtual intptr_t write(const void *buf, const intptr_t len);
+    virtual intptr_t acquire(const uint8_t **buf, const intptr_t len);
+    virtual void commit(const intptr_t len);
+    virtual bool buffered() const;
+
+    /**
+     * Seeking outside of the current block restarts the read-ahead
+     * at the new offset.
+     */
+    virtual bool seekable() const;
+    virtual intptr_t tell() const;
+    virtual intptr_t seek(const intptr_t offset);
+};
+
+/**
+ * Write a file asynchronously. Output is collected in blocks, and
+ * full blocks are submitted without waiting for them. Only when all
+ * *depth* blocks are in flight, writing blocks until the oldest one
+ * has completed.
+ *
+ * Uses io_uring or pwrite() like AsyncFileInput. The descriptor must
+ * be seekable; writing starts at its current offset, and flush()
+ * moves the offset behind the data written. Errors throw IOError.
+ */
+struct AsyncFileOutput: public IOIntf {
+public:
+    static const intptr_t default_block_size = 262144;
+    static const intptr_t default_depth = 4;
+
+public:
+    AsyncFileOutput(int fd, bool owns_fd = false,
+                    intptr_t block_size = default_block_size,
+                    intptr_t depth = default_depth,
+                    bool try_io_uring = true);
+
+    /**
+     * Create or truncate the file at *path* and write to it.
+     */
+    AsyncFileOutput(const std::string &path,
+                    intptr_t block_size = default_block_size,
+                    intptr_t depth = default_depth,
+                    bool try_io_uring = true);
+    AsyncFileOutput(const AsyncFileOutput &ref) = delete;
+
+    /**
+     * Flush and, if owned, close the descriptor. Errors while flushing
+     * are lost; call flush() beforehand to see them.
+     */
+    virtual ~AsyncFileOutput();
+    AsyncFileOutput &operator=(const AsyncFileOutput &ref) = delete;
+private:
+    struct Block {
+        uint8_t *data;
+        off_t offset;
+        intptr_t len;
+        bool pending;
+    };
+
+private:
+    int _fd;
+    bool _owns_fd;
+    intptr_t _block_size;
+    AsyncBackend *_backend;
+    std::vector<Block> _blocks;
+    intptr_t _current;
+    off_t _next_offset;
+
+private:
+    void setup(bool try_io_uring);
+    void teardown();
+    void submit_current();
+    void complete(intptr_t index, intptr_t result);
+    void wait_for(intptr_t index);
+    std::exception_ptr drain();
+public:
+    bool uses_io_uring() const;
+
+    /**
+     * Submit the partially filled block and wait until all data has
+     * been written.
+     */
+    void flush();
+
+    virtual intptr_t read(void *buf, const intptr_t len);
+    virtual intptr_t write(const void *buf, const intptr_t len);
+    virtual bool buffered() const;
+};
+
+}
+
+#endif
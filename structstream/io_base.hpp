@@ -37,7 +37,91 @@ public:
     virtual ~IOIntf() {};
     virtual intptr_t read(void *buf, const intptr_t len) = 0;
     virtual intptr_t write(const void *buf, const intptr_t len) = 0;
+
+    /**
+     * Skip *len* bytes of input and return how many were actually
+     * there.
+     *
+     * The default implementation seeks on seekable sources and reads
+     * the data in chunks otherwise.
+     */
     virtual intptr_t skip(const intptr_t len);
+
+    /**
+     * Return true if the source supports tell() and seek().
+     */
+    virtual bool seekable() const;
+
+    /**
+     * Return the current read offset, or -1 if the source is not
+     * seekable.
+     */
+    virtual intptr_t tell() const;
+
+    /**
+     * Move the read offset to *offset*, but not beyond the end of the
+     * source.
+     *
+     * @return The new read offset, or -1 if the source is not
+     * seekable.
+     */
+    virtual intptr_t seek(const intptr_t offset);
+
+    /**
+     * Grant direct access to the next bytes of input, without
+     * consuming them.
+     *
+     * Point *buf* at the next unread bytes and return how many bytes
+     * are available there, which may be more than *len*. If less
+     * than *len* bytes can be provided in one piece, the return value
+     * is smaller than *len* and the caller has to fall back to
+     * read(). The pointer stays valid until the next call of any
+     * other method of the IOIntf.
+     *
+     * The default implementation does not support direct access and
+     * always returns 0.
+     *
+     * @param buf Receives the pointer to the data.
+     * @param len Amount of bytes the caller needs.
+     * @return Amount of bytes available at *buf*.
+     */
+    virtual intptr_t acquire(const uint8_t **buf, const intptr_t len);
+
+    /**
+     * Consume *len* bytes previously made available by acquire().
+     */
+    virtual void commit(const intptr_t len);
+
+    /**
+     * Return true if acquire() can always provide all remaining
+     * bytes of the source, as is the case for memory buffers. Such
+     * sources gain nothing from an additional buffer.
+     */
+    virtual bool contiguous() const;
+
+    /**
+     * Return true if the IOIntf keeps a buffer of its own, so that
+     * wrapping it into a BufferedReader or BufferedWriter only adds a
+     * copy.
+     *
+     * The default implementation returns contiguous().
+     */
+    virtual bool buffered() const;
+
+    /**
+     * Read up to *len* bytes, but only as many as the source can
+     * deliver right away. If nothing is available and *wait* is true,
+     * block until at least one byte arrives or the end is reached.
+     * Return 0 at the end, or if *wait* is false and nothing is
+     * available.
+     *
+     * This lets buffers fill up from pipes and interactive streams
+     * without waiting for data which has not been written yet. The
+     * default implementation is read(), which suits sources whose
+     * data is all there.
+     */
+    virtual intptr_t read_available(void *buf, const intptr_t len,
+                                    const bool wait = true);
 };
 
 typedef std::shared_ptr<IOIntf> IOIntfHandle;
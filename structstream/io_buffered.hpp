@@ -0,0 +1,155 @@
+/**********************************************************************
+File name: io_buffered.hpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#ifndef _STRUCTSTREAM_IO_BUFFERED_H
+#define _STRUCTSTREAM_IO_BUFFERED_H
+
+#include "structstream/io_base.hpp"
+
+namespace StructStream {
+
+/**
+ * Serve reads from a block-sized buffer which is refilled from the
+ * underlying IOIntf.
+ *
+ * This turns the many tiny reads issued while parsing record headers
+ * into a few large reads on the underlying source. Note that the
+ * reader consumes up to one block more from the underlying source
+ * than has been requested from it. The buffer is filled with
+ * IOIntf::read_available(), so it never waits for more data than
+ * the caller needs.
+ *
+ * @param underlying_io Source to read from.
+ * @param block_size Amount of bytes to request from the source at once.
+ */
+struct BufferedReader: public IOIntf {
+public:
+    static constexpr intptr_t default_block_size = 4096;
+public:
+    BufferedReader(IOIntfHandle underlying_io,
+                   const intptr_t block_size = default_block_size);
+    BufferedReader(const BufferedReader &ref) = delete;
+    virtual ~BufferedReader();
+    BufferedReader &operator=(const BufferedReader &ref) = delete;
+private:
+    IOIntfHandle _io_h;
+    IOIntf *_io;
+    uint8_t *_buf;
+    const intptr_t _block_size;
+    intptr_t _offs;
+    intptr_t _len;
+public:
+    virtual intptr_t read(void *buf, const intptr_t len);
+    virtual intptr_t write(const void *buf, const intptr_t len);
+    virtual intptr_t skip(const intptr_t len);
+
+    /**
+     * Provide direct access to the buffer. Requests of up to the block
+     * size are satisfied by refilling the buffer if neccessary, as far
+     * as the source can deliver without waiting.
+     */
+    virtual intptr_t acquire(const uint8_t **buf, const intptr_t len);
+    virtual void commit(const intptr_t len);
+    virtual bool buffered() const;
+
+    /**
+     * Seekable if the underlying source is. Seeking within the
+     * buffered data keeps the buffer.
+     */
+    virtual bool seekable() const;
+    virtual intptr_t tell() const;
+    virtual intptr_t seek(const intptr_t offset);
+
+    inline intptr_t block_size() const {
+        return _block_size;
+    };
+
+    IOIntfHandle underlying_io() const {
+        return _io_h;
+    };
+};
+
+/**
+ * Collect writes in a block-sized buffer and forward them to the
+ * underlying IOIntf in large chunks.
+ *
+ * Data is forwarded once the buffer is full, on flush() and on
+ * destruction. Errors of the underlying IOIntf are reported by the
+ * call which triggers the forwarding.
+ *
+ * If the underlying IOIntf is seekable, so is the writer: seeking
+ * back into data which is still buffered just moves the write
+ * position, so that small parts of the output can be overwritten
+ * without touching the underlying IOIntf.
+ *
+ * @param underlying_io Destination to write to.
+ * @param block_size Size of the buffer.
+ */
+struct BufferedWriter: public IOIntf {
+public:
+    static constexpr intptr_t default_block_size = 4096;
+public:
+    BufferedWriter(IOIntfHandle underlying_io,
+                   const intptr_t block_size = default_block_size);
+    BufferedWriter(const BufferedWriter &ref) = delete;
+    virtual ~BufferedWriter();
+    BufferedWriter &operator=(const BufferedWriter &ref) = delete;
+private:
+    IOIntfHandle _io_h;
+    IOIntf *_io;
+    uint8_t *_buf;
+    const intptr_t _block_size;
+    intptr_t _len;
+    intptr_t _offs;
+    // offset of the buffer in the underlying IOIntf, -1 if unknown
+    intptr_t _pos;
+public:
+    virtual intptr_t read(void *buf, const intptr_t len);
+    virtual intptr_t write(const void *buf, const intptr_t len);
+    virtual bool buffered() const;
+
+    virtual bool seekable() const;
+    virtual intptr_t tell() const;
+    virtual intptr_t seek(const intptr_t offset);
+
+    /**
+     * Forward all buffered data to the underlying IOIntf.
+     *
+     * @return false if the underlying IOIntf did not accept all data.
+     */
+    bool flush();
+
+    inline intptr_t block_size() const {
+        return _block_size;
+    };
+
+    IOIntfHandle underlying_io() const {
+        return _io_h;
+    };
+};
+
+}
+
+#endif
@@ -0,0 +1,162 @@
+/**********************************************************************
+File name: io_fd.hpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#ifndef _STRUCTSTREAM_IO_FD_H
+#define _STRUCTSTREAM_IO_FD_H
+
+#include <string>
+
+#include "structstream/io_base.hpp"
+#include "structstream/io_segmented.hpp"
+
+struct iovec;
+
+namespace StructStream {
+
+/**
+ * Read from a POSIX file descriptor.
+ *
+ * Reads go through an internal buffer, which is refilled in the same
+ * readv() call that serves the caller, so small reads cost no system
+ * call and large reads no extra copy. As FdInput buffers by itself,
+ * pass a buffer size of zero to FromBitstream.
+ *
+ * Short reads and EINTR are retried; read() only returns less than
+ * requested at the end of the input. Other errors throw IOError.
+ * Regular files are seekable, so skip() is cheap on them.
+ */
+struct FdInput: public IOIntf {
+public:
+    static const intptr_t default_buffer_size = 65536;
+
+public:
+    /**
+     * Read from *fd*, which is closed on destruction if *owns_fd* is
+     * true.
+     */
+    FdInput(int fd, bool owns_fd = false,
+            intptr_t buffer_size = default_buffer_size);
+
+    /**
+     * Open and read the file at *path*.
+     */
+    FdInput(const std::string &path,
+            intptr_t buffer_size = default_buffer_size);
+    FdInput(const FdInput &ref) = delete;
+    virtual ~FdInput();
+    FdInput &operator=(const FdInput &ref) = delete;
+private:
+    int _fd;
+    bool _owns_fd;
+    bool _seekable;
+    uint8_t *_buf;
+    intptr_t _buf_size;
+    intptr_t _len;
+    intptr_t _offs;
+private:
+    intptr_t read_some(uint8_t *dest, intptr_t len);
+    void fill_buffer(intptr_t len);
+public:
+    inline int fd() const { return _fd; };
+
+    virtual intptr_t read(void *buf, const intptr_t len);
+    virtual intptr_t write(const void *buf, const intptr_t len);
+    virtual intptr_t skip(const intptr_t len);
+    virtual intptr_t acquire(const uint8_t **buf, const intptr_t len);
+    virtual void commit(const intptr_t len);
+    virtual bool buffered() const;
+
+    /**
+     * Seekable on regular files.
+     */
+    virtual bool seekable() const;
+    virtual intptr_t tell() const;
+    virtual intptr_t seek(const intptr_t offset);
+};
+
+/**
+ * Write to a POSIX file descriptor.
+ *
+ * Small writes are coalesced in an internal buffer. When it is full,
+ * or the write is too large to fit, the buffer and the new data are
+ * passed to the kernel together with one writev() call.
+ *
+ * Partial writes and EINTR are retried; errors throw IOError.
+ */
+struct FdOutput: public IOIntf {
+public:
+    static const intptr_t default_buffer_size = 65536;
+
+public:
+    /**
+     * Write to *fd*, which is closed on destruction if *owns_fd* is
+     * true.
+     */
+    FdOutput(int fd, bool owns_fd = false,
+             intptr_t buffer_size = default_buffer_size);
+
+    /**
+     * Create or truncate the file at *path* and write to it.
+     */
+    FdOutput(const std::string &path,
+             intptr_t buffer_size = default_buffer_size);
+    FdOutput(const FdOutput &ref) = delete;
+
+    /**
+     * Flush and, if owned, close the descriptor. Errors while flushing
+     * are lost; call flush() beforehand to see them.
+     */
+    virtual ~FdOutput();
+    FdOutput &operator=(const FdOutput &ref) = delete;
+private:
+    int _fd;
+    bool _owns_fd;
+    uint8_t *_buf;
+    intptr_t _buf_size;
+    intptr_t _len;
+private:
+    void write_iov(struct iovec *iov, int count);
+public:
+    inline int fd() const { return _fd; };
+
+    /**
+     * Pass all buffered data to the kernel.
+     */
+    void flush();
+
+    /**
+     * Write all segments of *mem* with as few writev() calls as
+     * possible, without flattening it first.
+     */
+    void write_segments(const SegmentedMemory &mem);
+
+    virtual intptr_t read(void *buf, const intptr_t len);
+    virtual intptr_t write(const void *buf, const intptr_t len);
+    virtual bool buffered() const;
+};
+
+}
+
+#endif
@@ -42,7 +42,8 @@ public:
     HashPipe(IncrementalHash *hash, IOIntfHandle underlying_io):
         _hash(hash),
         _io_h(underlying_io),
-        _io(_io_h.get())
+        _io(_io_h.get()),
+        _acquired(nullptr)
     {
     };
 
@@ -56,6 +57,7 @@ private:
     IncrementalHash *_hash;
     IOIntfHandle _io_h;
     IOIntf *_io;
+    const uint8_t *_acquired;
 public:
     virtual intptr_t read(void *buf, const intptr_t len) {
         if (_hash == nullptr) {
@@ -83,6 +85,28 @@ public:
         }
     };
 
+    virtual intptr_t acquire(const uint8_t **buf, const intptr_t len) {
+        if (_hash == nullptr || dir != HP_READ) {
+            return 0;
+        }
+        intptr_t available = _io->acquire(buf, len);
+        _acquired = *buf;
+        return available;
+    };
+
+    virtual void commit(const intptr_t len) {
+        // only the bytes actually consumed go into the hash
+        if (_hash != nullptr) {
+            _hash->feed(_acquired, len);
+        }
+        _io->commit(len);
+        _acquired = nullptr;
+    };
+
+    virtual bool contiguous() const {
+        return dir == HP_READ && _io->contiguous();
+    };
+
     IncrementalHash *get_hash() {
         return _hash;
     };
@@ -27,11 +27,18 @@ authors named in the AUTHORS file.
 #define _STRUCTSTREAM_IO_MEMORY_H
 
 #include "structstream/io_base.hpp"
+#include "structstream/io_segmented.hpp"
 
 namespace StructStream {
 
 struct WritableMemory;
 
+/**
+ * Read from a private copy of a memory buffer.
+ *
+ * All constructors copy the source data. Use MemoryView to read from
+ * a buffer in place.
+ */
 struct ReadableMemory: public IOIntf {
 public:
     ReadableMemory(const uint8_t *srcbuf, const intptr_t len);
@@ -39,10 +46,18 @@ public:
     ReadableMemory(const WritableMemory &ref);
     virtual ~ReadableMemory();
 
-private:
-    uint8_t *_buf;
+protected:
+    ReadableMemory(const uint8_t *srcbuf, const intptr_t len, bool copy);
+
+    // access the data of a WritableMemory without merging its segments
+    static const uint8_t *copy_segments(const WritableMemory &ref);
+    static const uint8_t *view_segments(const WritableMemory &ref);
+
+protected:
+    const uint8_t *_buf;
     intptr_t _len;
     intptr_t _offs;
+    bool _owned;
 
 public:
     ReadableMemory& operator=(const ReadableMemory &ref);
@@ -52,13 +67,51 @@ public:
 
     virtual intptr_t read(void *buf, const intptr_t len);
     virtual intptr_t write(const void *buf, const intptr_t len);
+    virtual intptr_t acquire(const uint8_t **buf, const intptr_t len);
+    virtual void commit(const intptr_t len);
+    virtual bool contiguous() const;
+    virtual bool seekable() const;
+    virtual intptr_t tell() const;
+    virtual intptr_t seek(const intptr_t offset);
 };
 
+/**
+ * Read from a memory buffer in place, without copying it.
+ *
+ * The caller must keep the buffer alive and unmodified for the
+ * lifetime of the view. Copies of a view share the buffer.
+ *
+ * A growing WritableMemory can only be viewed while its data is in
+ * one piece; UnsupportedInput is thrown if it spans several segments
+ * (see WritableMemory::buffer()).
+ */
+struct MemoryView: public ReadableMemory {
+public:
+    MemoryView(const uint8_t *srcbuf, const intptr_t len);
+    MemoryView(const MemoryView &ref);
+    explicit MemoryView(const ReadableMemory &ref);
+    explicit MemoryView(const WritableMemory &ref);
+    virtual ~MemoryView() = default;
+
+public:
+    MemoryView& operator=(const MemoryView &ref);
+};
+
+/**
+ * Write into a memory buffer.
+ *
+ * Either writes into a fixed caller-provided buffer, or, if
+ * constructed without one, collects the output in a SegmentedMemory
+ * so that growing never copies data already written. In that case
+ * the segments are merged when buffer() or release_buffer() is
+ * called; use segmented() to access the data without merging.
+ */
 struct WritableMemory: public IOIntf {
 public:
     WritableMemory();
     WritableMemory(uint8_t *buf, const intptr_t len);
     WritableMemory(const uint32_t blank_pattern);
+    explicit WritableMemory(SegmentPoolHandle pool);
     WritableMemory(const ReadableMemory &ref);
     WritableMemory(const WritableMemory &ref);
     virtual ~WritableMemory();
@@ -69,18 +122,41 @@ private:
     intptr_t _offs;
     uint32_t _blank_pattern;
     bool _may_grow;
-private:
-    void grow();
+    SegmentedMemory *_segments;
 public:
     WritableMemory& operator=(const WritableMemory &ref);
 
-    inline const uint8_t *buffer() const { return _buf; };
+    /**
+     * Return the data written so far as one block. For growing
+     * buffers, the pointer is valid until the next write.
+     *
+     * Growing buffers are merged by this call if they span several
+     * segments (see SegmentedMemory::flatten()), which is why it is
+     * not const: pointers returned earlier and the segments of
+     * segmented() are invalidated by merging. The merged block is
+     * kept, so that further calls are cheap until more data is
+     * written, and merging again only copies the new data.
+     */
+    const uint8_t *buffer();
     inline intptr_t size() const { return _outward_size; };
 
+    /**
+     * Return the underlying segmented buffer, or nullptr if writing
+     * into a fixed buffer.
+     */
+    inline const SegmentedMemory *segmented() const { return _segments; };
+
     virtual intptr_t read(void *buf, const intptr_t len);
     virtual intptr_t write(const void *buf, const intptr_t len);
 
+    /**
+     * Pass ownership of the data to the caller, who must free() it.
+     * Growing buffers are merged first, see
+     * SegmentedMemory::release_buffer().
+     */
     uint8_t *release_buffer(intptr_t &len);
+
+    friend struct ReadableMemory;
 };
 
 }
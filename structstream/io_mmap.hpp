@@ -0,0 +1,95 @@
+/**********************************************************************
+File name: io_mmap.hpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#ifndef _STRUCTSTREAM_IO_MMAP_H
+#define _STRUCTSTREAM_IO_MMAP_H
+
+#include <string>
+
+#include "structstream/io_base.hpp"
+
+namespace StructStream {
+
+/**
+ * Read a file through a read-only memory mapping.
+ *
+ * Reads copy straight out of the mapping and skip() only moves the
+ * read offset, so skipped data is never paged in. Pages are loaded
+ * on demand by the kernel, which keeps the resident memory bounded
+ * for large files, especially with the Sequential hint.
+ *
+ * Throws IOError if the file cannot be opened or mapped.
+ */
+struct MappedFile: public IOIntf {
+public:
+    enum AccessHint {
+        Normal,
+        Sequential,
+        Random
+    };
+public:
+    /**
+     * Map the file at *path*.
+     */
+    MappedFile(const std::string &path, AccessHint hint = Sequential);
+
+    /**
+     * Map the file behind *fd*. The descriptor is not taken over and
+     * may be closed right after construction.
+     */
+    MappedFile(int fd, AccessHint hint = Sequential);
+    MappedFile(const MappedFile &ref) = delete;
+    virtual ~MappedFile();
+    MappedFile &operator=(const MappedFile &ref) = delete;
+private:
+    uint8_t *_buf;
+    intptr_t _len;
+    intptr_t _offs;
+private:
+    void map_fd(int fd);
+public:
+    /**
+     * Pass an access pattern hint for the whole mapping to the kernel.
+     */
+    void advise(AccessHint hint);
+
+    inline const uint8_t *buffer() const { return _buf; };
+    inline intptr_t size() const { return _len; };
+    inline intptr_t offset() const { return _offs; };
+
+    virtual intptr_t read(void *buf, const intptr_t len);
+    virtual intptr_t write(const void *buf, const intptr_t len);
+    virtual intptr_t skip(const intptr_t len);
+    virtual intptr_t acquire(const uint8_t **buf, const intptr_t len);
+    virtual void commit(const intptr_t len);
+    virtual bool contiguous() const;
+    virtual bool seekable() const;
+    virtual intptr_t tell() const;
+    virtual intptr_t seek(const intptr_t offset);
+};
+
+}
+
+#endif
@@ -0,0 +1,193 @@
+/**********************************************************************
+File name: io_pipe.hpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#ifndef _STRUCTSTREAM_IO_PIPE_H
+#define _STRUCTSTREAM_IO_PIPE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "structstream/io_base.hpp"
+
+namespace StructStream {
+
+/**
+ * In-process pipe for a single producer and a single consumer thread,
+ * backed by a lock-free ring buffer.
+ *
+ * Access it through a PipeWriteEnd and a PipeReadEnd, for example to
+ * run ToBitstream in one thread and FromBitstream in another. Closing
+ * the write end is seen as end-of-stream by the reader once all data
+ * has been read; closing the read end makes further writes fail.
+ */
+class RingPipe {
+public:
+    static const intptr_t default_capacity = 65536;
+
+    /**
+     * What to do while waiting for the other end.
+     */
+    enum WaitPolicy {
+        /**
+         * Sleep on a condition variable. The other end only takes the
+         * lock when someone is actually waiting.
+         */
+        Block,
+        /**
+         * Busy wait, yielding the processor in between. Lowest
+         * latency, but burns a core.
+         */
+        Spin
+    };
+
+public:
+    /**
+     * Create a pipe which buffers up to *capacity* bytes, rounded up
+     * to a power of two.
+     */
+    RingPipe(intptr_t capacity = default_capacity,
+             WaitPolicy policy = Block);
+    RingPipe(const RingPipe &ref) = delete;
+    RingPipe& operator=(const RingPipe &ref) = delete;
+    virtual ~RingPipe();
+
+private:
+    uint8_t *_buf;
+    uint64_t _capacity;
+    const WaitPolicy _policy;
+
+    // written by the reader only
+    std::atomic<uint64_t> _head;
+    // written by the writer only
+    std::atomic<uint64_t> _tail;
+
+    std::atomic<bool> _write_closed;
+    std::atomic<bool> _read_closed;
+
+    std::mutex _lock;
+    std::condition_variable _wakeup;
+    std::atomic<bool> _reader_waiting;
+    std::atomic<bool> _writer_waiting;
+
+private:
+    void wake(std::atomic<bool> &waiting);
+    uint64_t wait_for_data(uint64_t amount);
+    uint64_t wait_for_space();
+
+public:
+    inline intptr_t capacity() const {
+        return _capacity;
+    };
+
+    /**
+     * Wait until *len* bytes have been read or the write end has been
+     * closed. Returns the amount of bytes read.
+     */
+    intptr_t read(void *buf, const intptr_t len);
+
+    /**
+     * Wait until *len* bytes have been written. Returns less if the
+     * read end has been closed.
+     */
+    intptr_t write(const void *buf, const intptr_t len);
+
+    /**
+     * Read what is buffered, up to *len* bytes. If *wait* is true,
+     * wait until at least one byte is buffered or the write end has
+     * been closed.
+     */
+    intptr_t read_available(void *buf, const intptr_t len, const bool wait);
+
+    /**
+     * Wait until at least one byte is buffered or the write end has
+     * been closed, and point *buf* at the buffered data up to the
+     * point where the ring wraps around. Less than *len* bytes may be
+     * returned while the writer is still busy.
+     */
+    intptr_t acquire(const uint8_t **buf, const intptr_t len);
+    void commit(const intptr_t len);
+
+    void close_write();
+    void close_read();
+};
+
+typedef std::shared_ptr<RingPipe> RingPipeHandle;
+
+/**
+ * The consuming end of a RingPipe. Destroying it closes the read
+ * side.
+ *
+ * Reads block until the requested amount is available. The ring
+ * serves as read buffer, so FromBitstream does not add another one
+ * and decodes whatever has arrived.
+ */
+struct PipeReadEnd: public IOIntf {
+public:
+    PipeReadEnd(RingPipeHandle pipe);
+    PipeReadEnd(const PipeReadEnd &ref) = delete;
+    virtual ~PipeReadEnd();
+    PipeReadEnd& operator=(const PipeReadEnd &ref) = delete;
+private:
+    RingPipeHandle _pipe_h;
+    RingPipe *_pipe;
+public:
+    virtual intptr_t read(void *buf, const intptr_t len);
+    virtual intptr_t write(const void *buf, const intptr_t len);
+    virtual intptr_t acquire(const uint8_t **buf, const intptr_t len);
+    virtual void commit(const intptr_t len);
+    virtual bool buffered() const;
+    virtual intptr_t read_available(void *buf, const intptr_t len,
+                                    const bool wait = true);
+};
+
+/**
+ * The producing end of a RingPipe. Destroying it closes the write
+ * side, which signals end-of-stream to the reader.
+ */
+struct PipeWriteEnd: public IOIntf {
+public:
+    PipeWriteEnd(RingPipeHandle pipe);
+    PipeWriteEnd(const PipeWriteEnd &ref) = delete;
+    virtual ~PipeWriteEnd();
+    PipeWriteEnd& operator=(const PipeWriteEnd &ref) = delete;
+private:
+    RingPipeHandle _pipe_h;
+    RingPipe *_pipe;
+public:
+    /**
+     * Signal end-of-stream to the reader. No more data may be written
+     * afterwards.
+     */
+    void close();
+
+    virtual intptr_t read(void *buf, const intptr_t len);
+    virtual intptr_t write(const void *buf, const intptr_t len);
+};
+
+}
+
+#endif
@@ -0,0 +1,185 @@
+/**********************************************************************
+File name: io_segmented.hpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#ifndef _STRUCTSTREAM_IO_SEGMENTED_H
+#define _STRUCTSTREAM_IO_SEGMENTED_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "structstream/io_base.hpp"
+
+namespace StructStream {
+
+/**
+ * Keep fixed-size memory chunks around for reuse, so that repeated
+ * encoding into SegmentedMemory does not hit the allocator.
+ *
+ * Pools may be shared between threads.
+ */
+class SegmentPool {
+public:
+    static const intptr_t default_segment_size = 65536;
+    static const intptr_t default_max_idle = 64;
+
+public:
+    /**
+     * Create a pool of chunks of *segment_size* bytes, which keeps up
+     * to *max_idle* released chunks for reuse.
+     */
+    SegmentPool(intptr_t segment_size = default_segment_size,
+                intptr_t max_idle = default_max_idle);
+    SegmentPool(const SegmentPool &ref) = delete;
+    SegmentPool& operator=(const SegmentPool &ref) = delete;
+    virtual ~SegmentPool();
+
+private:
+    const intptr_t _segment_size;
+    const intptr_t _max_idle;
+    std::mutex _lock;
+    std::vector<uint8_t*> _idle;
+
+public:
+    /**
+     * Return a chunk of segment_size() bytes. Chunks are allocated
+     * using malloc(), thus it is legal to free() them instead of
+     * returning them with release().
+     */
+    uint8_t *allocate();
+
+    /**
+     * Return a chunk obtained from allocate() to the pool.
+     */
+    void release(uint8_t *segment);
+
+    inline intptr_t segment_size() const {
+        return _segment_size;
+    };
+
+    /**
+     * The pool used by default by SegmentedMemory and WritableMemory.
+     */
+    static std::shared_ptr<SegmentPool> default_pool();
+};
+
+typedef std::shared_ptr<SegmentPool> SegmentPoolHandle;
+
+/**
+ * A contiguous piece of a SegmentedMemory buffer.
+ */
+struct MemorySegment {
+    const uint8_t *data;
+    intptr_t len;
+};
+
+/**
+ * Collect output in a list of fixed-size chunks instead of one
+ * growing block, so that data written once is never copied again.
+ *
+ * The contents can be handed to writev() and friends segment by
+ * segment, or merged into a single block using flatten().
+ */
+struct SegmentedMemory: public IOIntf {
+public:
+    SegmentedMemory(SegmentPoolHandle pool = SegmentPool::default_pool());
+    SegmentedMemory(const SegmentedMemory &ref) = delete;
+    SegmentedMemory& operator=(const SegmentedMemory &ref) = delete;
+    virtual ~SegmentedMemory();
+
+private:
+    struct Chunk {
+        uint8_t *data;
+        intptr_t capacity;
+        bool pooled;
+    };
+
+private:
+    SegmentPoolHandle _pool_h;
+    std::vector<Chunk> _chunks;
+    std::vector<MemorySegment> _segments;
+    intptr_t _size;
+
+private:
+    void release_chunks();
+
+public:
+    inline intptr_t size() const {
+        return _size;
+    };
+
+    /**
+     * Return the list of segments holding the data written so far,
+     * in order. The list is invalidated by the next write.
+     */
+    inline const std::vector<MemorySegment> &segments() const {
+        return _segments;
+    };
+
+    /**
+     * Merge all segments into a single block and return a pointer to
+     * it. The pointer stays valid until the next write or flatten().
+     *
+     * The first segment is grown in place with realloc() and the
+     * others are appended, so the first merge of a large buffer
+     * temporarily needs about twice its size; use segments() to avoid
+     * the copy. The block keeps spare room for further writes and
+     * merging again only copies what has been written since, so
+     * alternating write() and flatten() takes amortized linear time.
+     */
+    const uint8_t *flatten();
+
+    /**
+     * Discard all data and return the chunks to the pool.
+     */
+    void clear();
+
+    /**
+     * Move the data of *other* to the end of this buffer and leave
+     * *other* empty. Chunks which are at least half full are taken
+     * over as they are, only the others are copied.
+     */
+    void splice(SegmentedMemory &other);
+
+    /**
+     * Flatten the buffer and pass ownership of the resulting block
+     * to the caller, who must free() it. The buffer is empty
+     * afterwards.
+     *
+     * This copies the data unless it is in a single segment already,
+     * see flatten(). Callers which can deal with several blocks
+     * should use segments() before clear() instead.
+     *
+     * @param len Receives the amount of bytes in the block.
+     */
+    uint8_t *release_buffer(intptr_t &len);
+
+    virtual intptr_t read(void *buf, const intptr_t len);
+    virtual intptr_t write(const void *buf, const intptr_t len);
+};
+
+}
+
+#endif
@@ -40,6 +40,21 @@ private:
 public:
     virtual intptr_t read(void *buf, const intptr_t len);
     virtual intptr_t write(const void *buf, const intptr_t len);
+
+    /**
+     * Take what the stream buffer holds (see std::istream::readsome),
+     * reading a single byte first if it is empty and *wait* is set.
+     */
+    virtual intptr_t read_available(void *buf, const intptr_t len,
+                                    const bool wait = true);
+
+    /**
+     * Seekable if the stream reports a position, as file and string
+     * streams do.
+     */
+    virtual bool seekable() const;
+    virtual intptr_t tell() const;
+    virtual intptr_t seek(const intptr_t offset);
 };
 
 struct StandardOutputStream: public IOIntf {
@@ -50,6 +65,14 @@ private:
 public:
     virtual intptr_t read(void *buf, const intptr_t len);
     virtual intptr_t write(const void *buf, const intptr_t len);
+
+    /**
+     * Seekable if the stream reports a position. Seeking moves the
+     * write position within the data written so far.
+     */
+    virtual bool seekable() const;
+    virtual intptr_t tell() const;
+    virtual intptr_t seek(const intptr_t offset);
 };
 
 }
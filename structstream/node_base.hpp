@@ -28,6 +28,7 @@ authors named in the AUTHORS file.
 
 #include "structstream/io.hpp"
 #include "structstream/node_factory.hpp"
+#include "structstream/utils.hpp"
 
 namespace StructStream {
 
@@ -35,6 +36,15 @@ class Container;
 typedef std::shared_ptr<Container> ContainerHandle;
 typedef std::weak_ptr<Container> ContainerWeakHandle;
 
+/**
+ * Coarse classification of nodes, stored in every node so that it can
+ * be tested without RTTI.
+ */
+enum NodeKind {
+    NK_RECORD,
+    NK_CONTAINER
+};
+
 /**
  * Base class for all nodes which can written into a structstream
  * file. You may derive from this or DataRecord or Container depending
@@ -48,13 +58,16 @@ typedef std::weak_ptr<Container> ContainerWeakHandle;
  */
 class Node {
 protected:
-    explicit Node(ID id);
+    explicit Node(ID id, NodeKind kind = NK_RECORD);
     Node(const Node &ref);
 public:
     virtual ~Node();
 protected:
     NodeWeakHandle _self;
     const ID _id;
+    const NodeKind _kind;
+    // set by NodeHandleFactory to the tag of the class it created
+    NodeClassTag _class_tag;
     ContainerWeakHandle _parent;
 protected:
     void set_parent(ContainerHandle parent);
@@ -63,6 +76,27 @@ public:
         return  _id;
     };
 
+    inline NodeKind kind() const {
+        return _kind;
+    };
+
+    /**
+     * Return NodeClass<T>::tag() for the class T the node has been
+     * created as by NodeHandleFactory<T>, or nullptr for nodes which
+     * have been created otherwise.
+     */
+    inline NodeClassTag class_tag() const {
+        return _class_tag;
+    };
+
+    /**
+     * Return true if the node is a Container. This is equivalent to,
+     * but cheaper than, a dynamic_cast to Container.
+     */
+    inline bool is_container() const {
+        return _kind == NK_CONTAINER;
+    };
+
     inline ContainerHandle parent() const {
         return _parent.lock();
     };
@@ -117,6 +151,26 @@ public:
      */
     void write_header(IOIntf *stream) const;
 
+    /**
+     * Maximum amount of bytes encode_header() produces.
+     */
+    static const intptr_t max_header_size = 2*Utils::max_varint_size;
+
+    /**
+     * Encode the record type and the id into a buffer, so that they
+     * can be written together with the payload.
+     *
+     * @param dest Buffer with room for at least max_header_size bytes.
+     * @return Amount of bytes written.
+     */
+    intptr_t encode_header(uint8_t *dest) const;
+
+    /**
+     * Encode a header for a record of type *rt* with *id*, without
+     * requiring a node.
+     */
+    static intptr_t encode_header(uint8_t *dest, RecordType rt, ID id);
+
     // If you want to make your node constructible using the
     // NodeHandleFactory, include this line and adapt it
     // appropriately.
@@ -92,6 +92,20 @@ protected:
             _buf = newbuf;
 	}
     };
+
+    /**
+     * Fill the first *len* bytes of the buffer from *stream*, taking
+     * them straight from the source buffer if possible.
+     */
+    inline void read_payload(IOIntf *stream, intptr_t len) {
+        const uint8_t *direct = nullptr;
+        if (stream->acquire(&direct, len) >= len) {
+            memcpy(_buf, direct, len);
+            stream->commit(len);
+        } else {
+            sread(stream, _buf, len);
+        }
+    };
 public:
     virtual void raw_get(void *to) const {
         memcpy(to, _buf, size());
@@ -144,6 +158,13 @@ public:
     virtual void read(IOIntf *stream);
     virtual void write(IOIntf *stream) const;
 
+    /**
+     * Write a string record with *id* from *len* bytes at *data*
+     * (without terminating zero), exactly like write() would.
+     */
+    static void write_value(IOIntf *stream, ID id,
+                            const char *data, intptr_t len);
+
     std::string get() const {
         return datastr();
     };
@@ -180,6 +201,13 @@ public:
     virtual void read(IOIntf *stream);
     virtual void write(IOIntf *stream) const;
 
+    /**
+     * Write a blob record with *id* from *len* bytes at *data*,
+     * exactly like write() would.
+     */
+    static void write_value(IOIntf *stream, ID id,
+                            const char *data, intptr_t len);
+
     friend struct NodeHandleFactory<BlobRecord>;
 };
 
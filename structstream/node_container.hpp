@@ -28,6 +28,7 @@ authors named in the AUTHORS file.
 
 #include <vector>
 #include <map>
+#include <type_traits>
 
 #include "structstream/node_base.hpp"
 
@@ -41,8 +42,9 @@ class idpath_find_most_shallow;
  * The base class for all containers.
  *
  * If you implement a container, you /must/ inherit from this
- * class. There are dynamic_casts at several places, because Readers
- * and Writers need information about containers.
+ * class. Readers and Writers tell containers apart by
+ * Node::is_container(), which is set up by the constructors of this
+ * class.
  */
 class Container: public Node {
 public:
@@ -190,6 +192,60 @@ public:
     friend struct NodeHandleFactory<Container>;
 };
 
+/**
+ * Cast *node* to NodeT if it is a NodeT and return nullptr
+ * otherwise, like dynamic_cast does.
+ *
+ * The node kind is checked first. Nodes which have been created as
+ * NodeT are recognized by their class tag (see Node::class_tag()) and
+ * cast statically. Only nodes of a subclass of NodeT and nodes of
+ * other classes require the RTTI lookup of dynamic_cast.
+ */
+template <class NodeT>
+inline NodeT *node_cast(Node *node)
+{
+    static_assert(std::is_base_of<Node, NodeT>::value,
+                  "node_cast can only cast to Node subclasses.");
+
+    if (node == nullptr) {
+        return nullptr;
+    }
+    if (std::is_base_of<Container, NodeT>::value) {
+        if (!node->is_container()) {
+            return nullptr;
+        }
+        if (std::is_same<Container, NodeT>::value) {
+            return static_cast<NodeT*>(node);
+        }
+    } else if (!std::is_base_of<NodeT, Container>::value
+               && node->is_container())
+    {
+        return nullptr;
+    }
+
+    if (node->class_tag() == NodeClass<NodeT>::tag()) {
+        return static_cast<NodeT*>(node);
+    }
+    return dynamic_cast<NodeT*>(node);
+}
+
+template <class NodeT>
+inline const NodeT *node_cast(const Node *node)
+{
+    return node_cast<NodeT>(const_cast<Node*>(node));
+}
+
+template <class NodeT>
+inline std::shared_ptr<NodeT> node_cast(const NodeHandle &node)
+{
+    if (node_cast<NodeT>(node.get()) == nullptr) {
+        return std::shared_ptr<NodeT>();
+    }
+    // node_cast succeeded, thus this is equivalent to a
+    // dynamic_pointer_cast
+    return std::static_pointer_cast<NodeT>(node);
+}
+
 }
 
 #endif
@@ -36,6 +36,27 @@ class Node;
 typedef std::shared_ptr<Node> NodeHandle;
 typedef std::weak_ptr<Node> NodeWeakHandle;
 
+typedef const void *NodeClassTag;
+
+/**
+ * Provide a tag which identifies the node class NodeT. The factory
+ * stores it in every node it creates, so that node_cast<>() can
+ * recognize nodes of exactly that class without RTTI.
+ */
+template <class NodeT>
+struct NodeClass {
+    static inline NodeClassTag tag() {
+        return &_tag;
+    };
+private:
+    // only the address matters; not const, so that it is never merged
+    // with the tag of another class
+    static char _tag;
+};
+
+template <class NodeT>
+char NodeClass<NodeT>::_tag = 0;
+
 template <class NodeT>
 struct NodeHandleFactory {
     typedef std::shared_ptr<NodeT> NodeTHandle;
@@ -46,6 +67,7 @@ struct NodeHandleFactory {
         NodeT *node = new NodeT(id, args...);
         NodeTHandle handle = NodeTHandle(node);
         node->_self = NodeTWeakHandle(handle);
+        node->_class_tag = NodeClass<NodeT>::tag();
         return handle;
     }
 
@@ -64,6 +86,7 @@ struct NodeHandleFactory {
         NodeT *node = new NodeT(ref);
         NodeTHandle handle = NodeTHandle(node);
         node->_self = NodeTWeakHandle(handle);
+        node->_class_tag = NodeClass<NodeT>::tag();
         return handle;
     };
 private:
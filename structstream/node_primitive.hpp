@@ -190,23 +190,29 @@ public:
     };
 
     virtual void read(IOIntf *stream) {
+        sreadv<_T>(stream, &_data);
         if (Utils::is_big_endian && (sizeof(_T) > 1)) {
-            sread(stream, &_data, sizeof(_T));
             endian_helper::bswap(_data);
-        } else {
-            sreadv<_T>(stream, &_data);
         }
     };
 
     virtual void write(IOIntf *stream) const {
-        write_header(stream);
+        write_value(stream, record_type(), _id, _data);
+    };
+
+    /**
+     * Write a record of type *as_rt* with *id* and *value*, exactly
+     * like write() would, but without a node.
+     */
+    static inline void write_value(IOIntf *stream, RecordType as_rt,
+                                   ID id, _T value) {
+        uint8_t buf[max_header_size + sizeof(_T)];
+        const intptr_t header_len = encode_header(buf, as_rt, id);
         if (Utils::is_big_endian) {
-            _T tmp = _data;
-            endian_helper::bswap(tmp);
-            swrite(stream, &tmp, sizeof(_T));
-        } else {
-            swritev<_T>(stream, _data);
+            endian_helper::bswap(value);
         }
+        memcpy(&buf[header_len], &value, sizeof(_T));
+        swrite(stream, buf, header_len + sizeof(_T));
     };
 
     virtual RecordType record_type() const {
@@ -330,8 +336,18 @@ public:
     };
 
     void write(IOIntf *stream) const override {
-        write_header(stream);
-        swrite(stream, &_data[0], len);
+        write_value(stream, record_type(), _id, _data);
+    };
+
+    /**
+     * See PrimitiveDataRecord::write_value().
+     */
+    static inline void write_value(IOIntf *stream, RecordType as_rt,
+                                   ID id, const char_t *data) {
+        uint8_t buf[max_header_size + len];
+        const intptr_t header_len = encode_header(buf, as_rt, id);
+        memcpy(&buf[header_len], data, len);
+        swrite(stream, buf, header_len + len);
     };
 
     RecordType record_type() const override {
@@ -356,6 +372,12 @@ public:
     virtual void read(IOIntf *stream);
     virtual void write(IOIntf *stream) const;
     virtual RecordType record_type() const;
+
+    /**
+     * See PrimitiveDataRecord::write_value(). The record type follows
+     * from *value*.
+     */
+    static void write_value(IOIntf *stream, ID id, bool value);
 public:
     friend struct NodeHandleFactory< BoolRecord >;
 };
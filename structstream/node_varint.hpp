@@ -41,6 +41,12 @@ public:
     virtual void read(IOIntf *stream);
     virtual void write(IOIntf *stream) const;
 
+    /**
+     * See PrimitiveDataRecord::write_value().
+     */
+    static void write_value(IOIntf *stream, RecordType as_rt,
+                            ID id, VarInt value);
+
     friend struct NodeHandleFactory<VarIntRecord>;
 };
 
@@ -55,6 +61,12 @@ public:
     virtual void read(IOIntf *stream);
     virtual void write(IOIntf *stream) const;
 
+    /**
+     * See PrimitiveDataRecord::write_value().
+     */
+    static void write_value(IOIntf *stream, RecordType as_rt,
+                            ID id, VarUInt value);
+
     friend struct NodeHandleFactory<VarUIntRecord>;
 };
 
@@ -34,6 +34,22 @@ authors named in the AUTHORS file.
 namespace StructStream {
 
 typedef std::function< NodeHandle(ID) > NodeConstructor;
+typedef NodeHandle (*NodeConstructorFunction)(ID);
+
+/**
+ * Plain constructor function for nodes of type *record_type*, usable
+ * with Registry::register_record_function.
+ */
+template <class record_type>
+NodeHandle construct_node(ID id)
+{
+    return NodeHandleFactory<record_type>::create(id);
+}
+
+class Registry;
+
+typedef std::shared_ptr<Registry> RegistryHandle;
+typedef std::shared_ptr<const Registry> ConstRegistryHandle;
 
 /**
  * Manage association of RecordType:s with classes representing them.
@@ -43,6 +59,13 @@ typedef std::function< NodeHandle(ID) > NodeConstructor;
  * you don't need to do anything if you don't implement custom types.
  */
 class Registry {
+public:
+    /**
+     * Record types below this value are looked up in a flat table of
+     * plain function pointers. Others and constructors which are not
+     * plain functions go through a hash map.
+     */
+    static const RecordType flat_record_types = 0x80;
 public:
     Registry();
     Registry(const Registry &ref);
@@ -51,9 +74,16 @@ public:
         bool add_defaults = true);
     virtual ~Registry();
 private:
+    NodeConstructorFunction _flat_record_types[flat_record_types];
     std::unordered_map<RecordType, NodeConstructor> _record_types;
 private:
     void register_defaults();
+public:
+    /**
+     * Return a shared, immutable registry with only the default types
+     * registered. It is created on first use.
+     */
+    static ConstRegistryHandle defaults();
 public:
     /**
      * Create a node for the given record type with the given id.
@@ -71,15 +101,16 @@ public:
     void register_record_type(RecordType rt,
                               const NodeConstructor &constructor);
 
+    void register_record_function(RecordType rt,
+                                  NodeConstructorFunction constructor);
+
     template <class record_type>
     void register_record_class(RecordType rt)
     {
-        register_record_type(rt, [](ID id){ return NodeHandleFactory<record_type>::create(id); });
+        register_record_function(rt, &construct_node<record_type>);
     }
 };
 
-typedef std::shared_ptr<Registry> RegistryHandle;
-
 }
 
 #endif
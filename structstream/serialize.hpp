@@ -74,6 +74,24 @@ struct value_decl
                 value_helper<record_t, dest_t>::to_record(
                     src, selector_t::first));
         }
+
+        static inline void encode(arg_t src, IOIntf *dest)
+        {
+            value_helper<record_t, dest_t>::write(
+                src, selector_t::first, dest);
+        }
+    };
+
+    struct decoder
+    {
+        typedef dest_t& arg_t;
+
+        static inline void decode(BitstreamCursor &cursor,
+                                  const CursorEvent &ev,
+                                  arg_t dest)
+        {
+            value_helper<record_t, dest_t>::from_event(ev, dest);
+        }
     };
 };
 
@@ -103,25 +121,10 @@ struct only
         bool _found;
         bool _thrown;
 
-        deserializer_base *match_node(const NodeHandle &node)
-        {
-            if (object_selector_t::test(node->id())) {
-                object_record_t *rec = dynamic_cast<object_record_t*>(
-                    node.get());
-                if (rec) {
-                    return new typename object_decl::deserializer(_dest);
-                }
-            }
-            return nullptr;
-        }
-
-        deserializer_base *match_cont(const ContainerHandle &cont)
+        bool matches(const NodeHandle &node)
         {
-            deserializer_base *result = match_node(cont);
-            if (result) {
-                nest(result);
-            }
-            return result;
+            return object_selector_t::test(node->id())
+                && record_matches<object_record_t>(node.get());
         }
 
         void throw_record_not_found()
@@ -159,25 +162,23 @@ struct only
 
         bool _node(const NodeHandle &node) override
         {
-            deserializer_base *handler = match_node(node);
-            if (!handler) {
+            if (!matches(node)) {
                 return handle_unknown_node(node);
             } else {
                 _found = true;
-                handler->node(node);
-                delete handler;
+                typename object_decl::deserializer handler(_dest);
+                handler.node(node);
                 return false;
             }
         };
 
         bool _start_container(const ContainerHandle &cont) override
         {
-            deserializer_base *handler = match_node(cont);
-            if (!handler) {
+            if (!matches(cont)) {
                 return handle_unknown_cont(cont);
             } else {
                 _found = true;
-                nest(handler);
+                nest(new typename object_decl::deserializer(_dest));
             }
             return true;
         }
@@ -200,6 +201,31 @@ struct only
     };
 
     typedef typename object_decl::serializer serializer;
+
+    struct decoder
+    {
+        typedef dest_t& arg_t;
+
+        static inline void decode_children(BitstreamCursor &cursor,
+                                           arg_t dest)
+        {
+            // stops reading right after the record, like the
+            // deserializer stops the stream
+            CursorEvent ev;
+            while (cursor.next(ev) && ev.kind != CE_END_CONTAINER) {
+                if (event_matches<object_decl>(ev)) {
+                    object_decl::decoder::decode(cursor, ev, dest);
+                    return;
+                }
+                if (require && first) {
+                    break;
+                }
+                skip_event(cursor, ev);
+            }
+            throw RecordNotFound("Record required to be first by only<>"
+                                 " was not found.");
+        }
+    };
 };
 
 template <typename object_decl,
@@ -245,11 +271,46 @@ struct iterator
                                         &*curr));
             }
         }
+
+        static inline void encode(
+            input_iterator curr,
+            input_iterator end,
+            IOIntf *dest)
+        {
+            for (; curr != end; ++curr) {
+                object_decl::serializer::encode(
+                    iterator_helper<const typename object_decl::dest_t,
+                                    const element_type>::get_raw_reference(
+                                        &*curr),
+                    dest);
+            }
+        }
+    };
+
+    struct decoder
+    {
+        typedef output_iterator arg_t;
+
+        static inline void decode_children(BitstreamCursor &cursor,
+                                           arg_t dest)
+        {
+            decoder_sequence<object_decl, element_type>::decode_children(
+                cursor,
+                [&dest](element_type &&item) {
+                    *dest = std::move(item);
+                    ++dest;
+                });
+        }
     };
 };
 
 /* stream sink adapter */
 
+/**
+ * Forward the events of a stream to a deserializer, which is owned
+ * by the sink. The deserializers nested by *child* while the sink
+ * forwards events are allocated from a pool owned by the sink.
+ */
 class DeserializerSink: public StreamSinkIntf
 {
 public:
@@ -258,6 +319,7 @@ public:
 
 private:
     deserializer_base *_child;
+    deserializer_pool _pool;
 
 private:
     void _finalize_child();
@@ -307,6 +369,57 @@ inline void serialize_to_sink(
     serializer_t::serializer::to_sink(src, sink);
 }
 
+/**
+ * Encode *src* into *dest* like serialize_to_sink() into a
+ * ToBitstream with default settings would, but without creating any
+ * nodes. Only the records are written; the end of the stream is left
+ * to the caller.
+ */
+template <typename serializer_t>
+inline void encode_to(
+    typename serializer_t::serializer::arg_t src,
+    IOIntf *dest)
+{
+    serializer_t::serializer::encode(src, dest);
+}
+
+/**
+ * Decode the records at the current level of *cursor* into *dest*,
+ * like deserialize() does with the nodes of a FromBitstream, but
+ * straight from the bitstream: apart from member_record and
+ * member_direct, no nodes and no deserializer objects are created.
+ *
+ * The cursor is left behind the end of the current container, or,
+ * for only<>, right behind the record which has been found. Only the
+ * built-in record types are supported; records are matched by their
+ * record type instead of by node_cast(). The nodes for member_record
+ * and member_direct are created by the registry of the cursor (or
+ * *nodetypes*) and are only assigned if they are of the declared
+ * class.
+ *
+ * Matching by record type differs for EnumRecordTpl members: they
+ * are decoded from every record of their record type, whereas
+ * deserialize() only accepts nodes of the enum class. FromBitstream
+ * creates those only if the class is registered for the record type.
+ */
+template <typename serializer_t>
+inline void decode_from(
+    typename serializer_t::decoder::arg_t dest,
+    BitstreamCursor &cursor)
+{
+    serializer_t::decoder::decode_children(cursor, dest);
+}
+
+template <typename serializer_t>
+inline void decode_from(
+    typename serializer_t::decoder::arg_t dest,
+    IOIntfHandle source,
+    ConstRegistryHandle nodetypes = Registry::defaults())
+{
+    BitstreamCursor cursor(source, nodetypes);
+    decode_from<serializer_t>(dest, cursor);
+}
+
 template <typename serializer_t>
 inline typename serializer_t::deserializer *deserializer_obj(
     typename serializer_t::deserializer::arg_t dest)
@@ -26,7 +26,9 @@ authors named in the AUTHORS file.
 #ifndef _STRUCTSTREAM_SERIALIZE_BASE_H
 #define _STRUCTSTREAM_SERIALIZE_BASE_H
 
+#include <cstddef>
 #include <memory>
+#include <vector>
 
 namespace StructStream {
 
@@ -35,23 +37,103 @@ class Container;
 typedef std::shared_ptr<Node> NodeHandle;
 typedef std::shared_ptr<Container> ContainerHandle;
 
+/**
+ * Freelists for the memory of deserializer objects, bucketed by size.
+ *
+ * While a pool is installed with a deserializer_pool::scope, all
+ * deserializers created on that thread take their memory from the
+ * pool, and the memory returns to the pool when they are deleted.
+ * The pool must outlive all deserializers allocated from it.
+ * DeserializerSink owns one pool and installs it while it forwards
+ * events.
+ */
+class deserializer_pool
+{
+public:
+    deserializer_pool();
+    deserializer_pool(const deserializer_pool &ref) = delete;
+    deserializer_pool &operator=(const deserializer_pool &ref) = delete;
+    ~deserializer_pool();
+
+    /**
+     * Install a pool for the current thread for the lifetime of the
+     * scope object. Scopes may be nested.
+     */
+    class scope
+    {
+    public:
+        explicit scope(deserializer_pool *pool);
+        scope(const scope &ref) = delete;
+        scope &operator=(const scope &ref) = delete;
+        ~scope();
+
+    private:
+        deserializer_pool *_previous;
+    };
+
+private:
+    struct free_block {
+        free_block *next;
+    };
+
+    static constexpr size_t granularity = 16;
+    static constexpr size_t bucket_count = 16;
+
+    free_block *_buckets[bucket_count];
+
+public:
+    /**
+     * Allocate a block for an object of *size* bytes. Blocks larger
+     * than the largest bucket are taken from the heap.
+     */
+    void *allocate(size_t size);
+    void release(void *block, size_t size);
+
+    static deserializer_pool *current();
+};
+
 struct deserializer_base
 {
     virtual ~deserializer_base();
+
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr, size_t size);
+
     virtual bool end_container();
     virtual void finalize();
     virtual bool node(const NodeHandle &node);
     virtual bool start_container(const ContainerHandle &cont);
 };
 
+/**
+ * Base for deserializers which hand containers to other
+ * deserializers with nest().
+ *
+ * The outermost deserializer_nesting keeps all nested deserializers
+ * on one stack, so that each event is dispatched to the innermost
+ * active handler directly instead of being forwarded through every
+ * level. Nested handlers are finalized and deleted innermost first,
+ * right before the _end_container() of the handler which nested
+ * them.
+ */
 struct deserializer_nesting: public deserializer_base
 {
     deserializer_nesting();
     virtual ~deserializer_nesting();
 
 private:
-    size_t _depth;
-    deserializer_base *_nested;
+    struct frame {
+        deserializer_base *handler;
+        // handler, if it is a deserializer_nesting
+        deserializer_nesting *nesting;
+        size_t depth;
+    };
+
+    // the handler which owns the stack and the position of this
+    // handler on it; the root has level zero
+    deserializer_nesting *_root;
+    size_t _level;
+    std::vector<frame> _stack;
 
     void unnest();
 
@@ -27,7 +27,8 @@ authors named in the AUTHORS file.
 #define _STRUCTSTREAM_SERIALIZE_ITERABLES_H
 
 #include "structstream/serialize_base.hpp"
-#include "structstream/node_base.hpp"
+#include "structstream/serialize_utils.hpp"
+#include "structstream/node_container.hpp"
 
 namespace StructStream {
 
@@ -185,28 +186,18 @@ private:
 
     element_t _buf;
 
-    deserializer_base *match_node(const NodeHandle &node)
+    bool matches(const NodeHandle &node)
     {
-        if (item_selector_t::test(node->id())) {
-            item_record_t *rec = dynamic_cast<item_record_t*>(
-                node.get());
-            if (rec) {
-                _buf = helper::construct();
-                item_t *item_ptr;
-                helper::get_ptr(&_buf, &item_ptr);
-                return new typename item_decl::deserializer(*item_ptr);
-            }
-        }
-        return nullptr;
+        return item_selector_t::test(node->id())
+            && record_matches<item_record_t>(node.get());
     };
 
-    deserializer_base *match_cont(const ContainerHandle &cont)
+    item_t &next_item()
     {
-        deserializer_base *result = match_node(cont);
-        if (result) {
-            nest(result);
-        }
-        return result;
+        _buf = helper::construct();
+        item_t *item_ptr;
+        helper::get_ptr(&_buf, &item_ptr);
+        return *item_ptr;
     };
 
     bool handle_unknown_node(const NodeHandle &node)
@@ -232,12 +223,13 @@ protected:
 
     bool _node(const NodeHandle &node) override
     {
-        deserializer_base *handler = match_node(node);
-        if (handler == nullptr) {
+        if (!matches(node)) {
             return handle_unknown_node(node);
         } else {
-            handler->node(node);
-            delete handler;
+            {
+                typename item_decl::deserializer handler(next_item());
+                handler.node(node);
+            }
             _submit_item(std::move(_buf));
         }
         return true;
@@ -245,16 +237,46 @@ protected:
 
     bool _start_container(const ContainerHandle &cont) override
     {
-        deserializer_base *handler = match_cont(cont);
-        if (handler == nullptr) {
+        if (!matches(cont)) {
             return handle_unknown_cont(cont);
         }
+        nest(new typename item_decl::deserializer(next_item()));
         return true;
     };
 
     virtual void _submit_item(element_t &&item) = 0;
 };
 
+/**
+ * Decode the children of the current container (or the remainder of
+ * the stream) as items of *item_decl* and pass each item to
+ * *submit*. Children which do not match are skipped.
+ */
+template <typename item_decl, typename element_t>
+struct decoder_sequence
+{
+    typedef typename item_decl::dest_t item_t;
+    typedef iterator_helper<item_t, element_t> helper;
+
+    template <typename submit_t>
+    static inline void decode_children(BitstreamCursor &cursor,
+                                       submit_t submit)
+    {
+        CursorEvent ev;
+        while (cursor.next(ev) && ev.kind != CE_END_CONTAINER) {
+            if (!event_matches<item_decl>(ev)) {
+                skip_event(cursor, ev);
+                continue;
+            }
+            element_t buf = helper::construct();
+            item_t *item_ptr;
+            helper::get_ptr(&buf, &item_ptr);
+            item_decl::decoder::decode(cursor, ev, *item_ptr);
+            submit(std::move(buf));
+        }
+    }
+};
+
 template <typename item_decl, typename element_t>
 struct deserialize_sequence_cb
 {
@@ -278,6 +300,22 @@ struct deserialize_sequence_cb
             _cb(std::move(item));
         }
     };
+
+    struct decoder
+    {
+        typedef std::function<void(element_t &&item)> callback_t;
+        typedef const callback_t& arg_t;
+
+        static inline void decode_children(BitstreamCursor &cursor,
+                                           arg_t cb)
+        {
+            decoder_sequence<item_decl, element_t>::decode_children(
+                cursor,
+                [&cb](element_t &&item) {
+                    cb(std::move(item));
+                });
+        }
+    };
 };
 
 
@@ -350,6 +388,48 @@ public:
             ContainerFooter foot;
             sink->end_container(&foot);
         }
+
+        static inline void encode(
+            input_iterator_t curr,
+            input_iterator_t end,
+            IOIntf *dest)
+        {
+            typedef iterator_helper<
+                const typename item_decl::dest_t,
+                const typename output_iterator_t::container_type::value_type> helper;
+
+            write_container_start(dest, selector_t::first);
+            for (; curr != end; ++curr) {
+                item_decl::serializer::encode(
+                    helper::get_raw_reference(&*curr),
+                    dest);
+            }
+            write_container_end(dest);
+        }
+    };
+
+    struct decoder
+    {
+        typedef output_iterator_t arg_t;
+        typedef typename output_iterator_t::container_type::value_type element_t;
+
+        static inline void decode(BitstreamCursor &cursor,
+                                  const CursorEvent &ev,
+                                  arg_t dest)
+        {
+            decode_children(cursor, dest);
+        }
+
+        static inline void decode_children(BitstreamCursor &cursor,
+                                           arg_t dest)
+        {
+            decoder_sequence<item_decl, element_t>::decode_children(
+                cursor,
+                [&dest](element_t &&item) {
+                    *dest = std::move(item);
+                    ++dest;
+                });
+        }
     };
 };
 
@@ -398,6 +478,32 @@ public:
             iterable_base::serializer::to_sink(
                 src.cbegin(), src.cend(), sink);
         }
+
+        static inline void encode(arg_t src, IOIntf *dest)
+        {
+            iterable_base::serializer::encode(
+                src.cbegin(), src.cend(), dest);
+        }
+    };
+
+    struct decoder
+    {
+        typedef dest_t& arg_t;
+
+        static inline void decode(BitstreamCursor &cursor,
+                                  const CursorEvent &ev,
+                                  arg_t dest)
+        {
+            decode_children(cursor, dest);
+        }
+
+        static inline void decode_children(BitstreamCursor &cursor,
+                                           arg_t dest)
+        {
+            iterable_base::decoder::decode_children(
+                cursor,
+                iterator_initializer<output_iterator>::init(dest));
+        }
     };
 
 };
@@ -481,6 +587,52 @@ struct static_array
             ContainerFooter foot;
             sink->end_container(&foot);
         }
+
+        static inline void encode(arg_t src, IOIntf *dest)
+        {
+            write_container_start(dest, selector_t::first);
+            for (unsigned int i = 0; i < item_count; i++) {
+                item_decl::serializer::encode(src[i], dest);
+            }
+            write_container_end(dest);
+        }
+    };
+
+    struct decoder
+    {
+        typedef dest_t& arg_t;
+
+        static inline void decode(BitstreamCursor &cursor,
+                                  const CursorEvent &ev,
+                                  arg_t dest)
+        {
+            decode_children(cursor, dest);
+        }
+
+        static inline void decode_children(BitstreamCursor &cursor,
+                                           arg_t dest)
+        {
+            unsigned int offs = 0;
+            decoder_sequence<item_decl, _dest_t>::decode_children(
+                cursor,
+                [&dest, &offs](_dest_t &&item) {
+                    if (offs >= item_count) {
+                        if (fail_on_overflow) {
+                            throw UnexpectedRecord("static_array overflew.");
+                        } else {
+                            return;
+                        }
+                    }
+                    dest[offs] = std::move(item);
+                    ++offs;
+                });
+            if (require_all) {
+                if (offs != item_count) {
+                    throw RecordNotFound("static_array did not find all"
+                                         " children.");
+                }
+            }
+        }
     };
 };
 
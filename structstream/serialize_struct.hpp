@@ -31,6 +31,8 @@ authors named in the AUTHORS file.
 #include "structstream/serialize_base.hpp"
 #include "structstream/serialize_utils.hpp"
 
+#include "structstream/node_container.hpp"
+#include "structstream/streaming_bitstream.hpp"
 #include "structstream/streaming_tree.hpp"
 
 namespace StructStream {
@@ -64,8 +66,8 @@ struct member
     public:
         bool node(const NodeHandle &node) override
         {
-            record_t *rec = dynamic_cast<record_t*>(node.get());
-            assert(rec);
+            assert(record_matches<record_t>(node.get()));
+            record_t *rec = static_cast<record_t*>(node.get());
             value_helper<record_t, _value_t>::from_record(
                 rec,
                 _dest.*_value_ptr);
@@ -84,6 +86,25 @@ struct member
                 value_helper<record_t, _value_t>::to_record(
                     src.*_value_ptr, selector_t::first));
         };
+
+        static inline void encode(arg_t src, IOIntf *dest)
+        {
+            value_helper<record_t, _value_t>::write(
+                src.*_value_ptr, selector_t::first, dest);
+        };
+    };
+
+    struct decoder
+    {
+        typedef dest_t& arg_t;
+
+        static inline void decode(BitstreamCursor &cursor,
+                                  const CursorEvent &ev,
+                                  arg_t dest)
+        {
+            value_helper<record_t, _value_t>::from_event(
+                ev, dest.*_value_ptr);
+        };
     };
 };
 
@@ -149,6 +170,37 @@ struct member_record
             }
             FromTree(sink, {node}, false);
         }
+
+        static inline void encode(arg_t src, IOIntf *dest)
+        {
+            const std::shared_ptr<record_t> &node = src.*_value_ptr;
+            if (!node) {
+                return;
+            }
+            // the tree exists already, so there is nothing to save
+            // by bypassing the writer
+            ToBitstream *writer = new ToBitstream(
+                IOIntfHandle(dest, [](IOIntf*){}), 0);
+            FromTree(StreamSink(writer), {node}, false);
+        }
+    };
+
+    struct decoder
+    {
+        typedef dest_t& arg_t;
+
+        static inline void decode(BitstreamCursor &cursor,
+                                  const CursorEvent &ev,
+                                  arg_t dest)
+        {
+            // the caller wants a tree, so there is nothing to save
+            // here either; custom registries may create other classes
+            std::shared_ptr<record_t> node = node_cast<record_t>(
+                cursor.read_node(ev));
+            if (node) {
+                dest.*_value_ptr = node;
+            }
+        }
     };
 };
 
@@ -200,6 +252,27 @@ struct member_direct
             sink->push_node(
                 (src.*get_record)(selector_t::first));
         }
+
+        static inline void encode(arg_t src, IOIntf *dest)
+        {
+            (src.*get_record)(selector_t::first)->write(dest);
+        }
+    };
+
+    struct decoder
+    {
+        typedef dest_t& arg_t;
+
+        static inline void decode(BitstreamCursor &cursor,
+                                  const CursorEvent &ev,
+                                  arg_t dest)
+        {
+            std::shared_ptr<record_t> node = node_cast<record_t>(
+                cursor.read_node(ev));
+            if (node) {
+                (dest.*set_record)(node);
+            }
+        }
     };
 };
 
@@ -231,16 +304,13 @@ struct member_struct_wrap
         dest_t &_dest;
         bool _found;
 
-        deserializer_base *match_node(const NodeHandle &node)
+        void check_match(const NodeHandle &node)
         {
-            if (value_selector_t::test(node->id())) {
-                value_record_t *rec = dynamic_cast<value_record_t*>(
-                    node.get());
-                if (rec) {
-                    _found = true;
-                    return new typename _value_decl::deserializer(
-                        _dest.*_value_ptr);
-                }
+            if (value_selector_t::test(node->id())
+                && record_matches<value_record_t>(node.get()))
+            {
+                _found = true;
+                return;
             }
             throw RecordNotFound(
                 "Mandatory child in member_struct_wrap container has "
@@ -249,8 +319,9 @@ struct member_struct_wrap
 
         void match_cont(const ContainerHandle &cont)
         {
-            deserializer_base *result = match_node(cont);
-            nest(result);
+            check_match(cont);
+            nest(new typename _value_decl::deserializer(
+                     _dest.*_value_ptr));
         }
 
         void check_found()
@@ -271,9 +342,9 @@ struct member_struct_wrap
         bool _node(const NodeHandle &node) override
         {
             check_found();
-            deserializer_base *handler = match_node(node);
-            handler->node(node);
-            delete handler;
+            check_match(node);
+            typename _value_decl::deserializer handler(_dest.*_value_ptr);
+            handler.node(node);
             return true;
         }
 
@@ -312,6 +383,52 @@ struct member_struct_wrap
             sink->end_container(&foot);
         }
 
+        static inline void encode(arg_t src, IOIntf *dest)
+        {
+            write_container_start(dest, selector_t::first);
+            _value_decl::serializer::encode(src.*_value_ptr, dest);
+            write_container_end(dest);
+        }
+
+    };
+
+    struct decoder
+    {
+        typedef dest_t& arg_t;
+
+        static inline void decode(BitstreamCursor &cursor,
+                                  const CursorEvent &ev,
+                                  arg_t dest)
+        {
+            decode_children(cursor, dest);
+        }
+
+        static inline void decode_children(BitstreamCursor &cursor,
+                                           arg_t dest)
+        {
+            bool found = false;
+            CursorEvent child;
+            while (cursor.next(child) && child.kind != CE_END_CONTAINER) {
+                if (found) {
+                    throw UnexpectedRecord(
+                        "More than one child in member_struct_wrap "
+                        "container.");
+                }
+                if (!event_matches<_value_decl>(child)) {
+                    throw RecordNotFound(
+                        "Mandatory child in member_struct_wrap container "
+                        "has incorrect header (does not match)!");
+                }
+                found = true;
+                _value_decl::decoder::decode(
+                    cursor, child, dest.*_value_ptr);
+            }
+            if (!found) {
+                throw RecordNotFound(
+                    "Mandatory child in member_struct_wrap container "
+                    "was not found.");
+            }
+        }
     };
 
 };
@@ -346,6 +463,23 @@ struct member_struct
             _value_decl::serializer::to_sink(src.*_value_ptr, sink);
         }
 
+        static inline void encode(arg_t src, IOIntf *dest)
+        {
+            _value_decl::serializer::encode(src.*_value_ptr, dest);
+        }
+
+    };
+
+    struct decoder
+    {
+        typedef dest_t& arg_t;
+
+        static inline void decode(BitstreamCursor &cursor,
+                                  const CursorEvent &ev,
+                                  arg_t dest)
+        {
+            _value_decl::decoder::decode(cursor, ev, dest.*_value_ptr);
+        }
     };
 };
 
@@ -371,17 +505,138 @@ public:
     static constexpr size_t member_count =
         other_members::member_count + 1;
 
+    template <typename outer_dest_t>
+    using handler_table_t = member_table<
+        deserializer_base *(*)(const Node *node, outer_dest_t &dest)>;
+
+    template <typename outer_dest_t>
+    using leaf_table_t = member_table<
+        bool (*)(const NodeHandle &node, outer_dest_t &dest)>;
+
+    template <typename outer_dest_t>
+    using decoder_table_t = member_table<
+        bool (*)(BitstreamCursor &cursor, const CursorEvent &ev,
+                 outer_dest_t &dest)>;
+
+private:
+    template <typename outer_dest_t>
+    static deserializer_base *create_handler(
+        const Node *node, outer_dest_t &dest)
+    {
+        if (!record_matches<member_record_t>(node)) {
+            return nullptr;
+        }
+        return new typename member_t::deserializer(dest);
+    }
+
+    template <typename outer_dest_t>
+    static bool handle_leaf(const NodeHandle &node, outer_dest_t &dest)
+    {
+        if (!record_matches<member_record_t>(node.get())) {
+            return false;
+        }
+        // the handler does not outlive the node, no need for the heap
+        typename member_t::deserializer handler(dest);
+        handler.node(node);
+        return true;
+    }
+
+    template <typename outer_dest_t>
+    static bool decode_record(
+        BitstreamCursor &cursor, const CursorEvent &ev, outer_dest_t &dest)
+    {
+        if (!record_traits<member_record_t>::test(ev.rt)) {
+            return false;
+        }
+        member_t::decoder::decode(cursor, ev, dest);
+        return true;
+    }
+
+    // the tables are built once per struct, on first use
+
+    static const handler_table_t<dest_t> &handler_table()
+    {
+        static const handler_table_t<dest_t> table = [] {
+            handler_table_t<dest_t> result;
+            add_handlers<dest_t>(result);
+            return result;
+        }();
+        return table;
+    }
+
+    static const leaf_table_t<dest_t> &leaf_table()
+    {
+        static const leaf_table_t<dest_t> table = [] {
+            leaf_table_t<dest_t> result;
+            add_leaves<dest_t>(result);
+            return result;
+        }();
+        return table;
+    }
+
+    static const decoder_table_t<dest_t> &decoder_table()
+    {
+        static const decoder_table_t<dest_t> table = [] {
+            decoder_table_t<dest_t> result;
+            add_decoders<dest_t>(result);
+            return result;
+        }();
+        return table;
+    }
+
+public:
+    template <typename outer_dest_t>
+    static inline void add_handlers(handler_table_t<outer_dest_t> &table)
+    {
+        table.template add<member_selector_t>(
+            &create_handler<outer_dest_t>);
+        other_members::template add_handlers<outer_dest_t>(table);
+    }
+
+    template <typename outer_dest_t>
+    static inline void add_leaves(leaf_table_t<outer_dest_t> &table)
+    {
+        table.template add<member_selector_t>(
+            &handle_leaf<outer_dest_t>);
+        other_members::template add_leaves<outer_dest_t>(table);
+    }
+
+    template <typename outer_dest_t>
+    static inline void add_decoders(decoder_table_t<outer_dest_t> &table)
+    {
+        table.template add<member_selector_t>(
+            &decode_record<outer_dest_t>);
+        other_members::template add_decoders<outer_dest_t>(table);
+    }
+
     static inline deserializer_base *dispatch_node(
         const Node *node, dest_t &dest)
     {
-        if (member_selector_t::test(node->id())) {
-            const member_record_t *rec =
-                dynamic_cast<const member_record_t*>(node);
-            if (rec) {
-                return new typename member_t::deserializer(dest);
-            }
-        }
-        return other_members::dispatch_node(node, dest);
+        deserializer_base *result = nullptr;
+        handler_table().dispatch(
+            node->id(),
+            [node, &dest, &result](
+                deserializer_base *(*create)(const Node*, dest_t&))
+            {
+                result = create(node, dest);
+                return result != nullptr;
+            });
+        return result;
+    };
+
+    /**
+     * Pass a node which is not a container to the first member which
+     * accepts it.
+     *
+     * @return false if no member accepts the node.
+     */
+    static inline bool dispatch_leaf(const NodeHandle &node, dest_t &dest)
+    {
+        return leaf_table().dispatch(
+            node->id(),
+            [&node, &dest](bool (*handle)(const NodeHandle&, dest_t&)) {
+                return handle(node, dest);
+            });
     };
 
     static inline void to_sink(
@@ -391,6 +646,25 @@ public:
         member_t::serializer::to_sink(src, sink);
         other_members::to_sink(src, sink);
     };
+
+    static inline void encode(const dest_t &src, IOIntf *dest)
+    {
+        member_t::serializer::encode(src, dest);
+        other_members::encode(src, dest);
+    };
+
+    static inline bool decode_member(
+        BitstreamCursor &cursor, const CursorEvent &ev, dest_t &dest)
+    {
+        return decoder_table().dispatch(
+            ev.id,
+            [&cursor, &ev, &dest](
+                bool (*decode)(BitstreamCursor&, const CursorEvent&,
+                               dest_t&))
+            {
+                return decode(cursor, ev, dest);
+            });
+    };
 };
 
 template <>
@@ -400,6 +674,30 @@ public:
     typedef void dest_t;
     static constexpr size_t member_count = 0;
 
+    template <typename outer_dest_t, typename table_t>
+    static inline void add_handlers(table_t &table)
+    {
+
+    }
+
+    template <typename outer_dest_t, typename table_t>
+    static inline void add_leaves(table_t &table)
+    {
+
+    }
+
+    template <typename outer_dest_t, typename table_t>
+    static inline void add_decoders(table_t &table)
+    {
+
+    }
+
+    template <typename U>
+    static inline bool dispatch_leaf(const NodeHandle &node, U &dest)
+    {
+        return false;
+    }
+
     template <typename U>
     static inline deserializer_base *dispatch_node(
         const Node *node, U dest)
@@ -412,6 +710,19 @@ public:
     {
 
     }
+
+    template <typename U>
+    static inline void encode(const U &src, IOIntf *dest)
+    {
+
+    }
+
+    template <typename U>
+    static inline bool decode_member(
+        BitstreamCursor &cursor, const CursorEvent &ev, U &dest)
+    {
+        return false;
+    }
 };
 
 template <typename _record_t, typename _selector_t, typename members_t>
@@ -462,13 +773,8 @@ struct struct_decl
 
         bool _node(const NodeHandle &node) override
         {
-            deserializer_base *handler = members_t::dispatch_node(
-                node.get(), _dest);
-            if (handler == nullptr) {
+            if (!members_t::dispatch_leaf(node, _dest)) {
                 return handle_unknown_node(node);
-            } else {
-                handler->node(node);
-                delete handler;
             }
             return true;
         };
@@ -505,6 +811,36 @@ struct struct_decl
             ContainerFooter foot;
             sink->end_container(&foot);
         };
+
+        static inline void encode(arg_t src, IOIntf *dest)
+        {
+            write_container_start(dest, selector_t::first);
+            members_t::encode(src, dest);
+            write_container_end(dest);
+        };
+    };
+
+    struct decoder
+    {
+        typedef dest_t& arg_t;
+
+        static inline void decode(BitstreamCursor &cursor,
+                                  const CursorEvent &ev,
+                                  arg_t dest)
+        {
+            decode_children(cursor, dest);
+        };
+
+        static inline void decode_children(BitstreamCursor &cursor,
+                                           arg_t dest)
+        {
+            CursorEvent child;
+            while (cursor.next(child) && child.kind != CE_END_CONTAINER) {
+                if (!members_t::decode_member(cursor, child, dest)) {
+                    skip_event(cursor, child);
+                }
+            }
+        };
     };
 };
 
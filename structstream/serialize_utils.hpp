@@ -26,10 +26,17 @@ authors named in the AUTHORS file.
 #ifndef _STRUCTSTREAM_SERIALIZE_UTILS_H
 #define _STRUCTSTREAM_SERIALIZE_UTILS_H
 
+#include <algorithm>
+#include <vector>
+
 #include "structstream/static.hpp"
+#include "structstream/errors.hpp"
 #include "structstream/node_factory.hpp"
 #include "structstream/node_blob.hpp"
+#include "structstream/node_container.hpp"
+#include "structstream/node_varint.hpp"
 #include "structstream/streaming_base.hpp"
+#include "structstream/streaming_cursor.hpp"
 
 namespace StructStream {
 
@@ -103,6 +110,396 @@ struct id_selector<>
     };
 };
 
+/**
+ * Enumerate the IDs accepted by a selector, for the dispatch tables
+ * of member_table. Selectors other than id_selector only provide
+ * test() and are marked as not enumerable.
+ */
+template <typename selector_t>
+struct selector_ids
+{
+    static constexpr bool enumerable = false;
+
+    static inline void append(std::vector<ID> &dest)
+    {
+
+    };
+};
+
+template <ID... matches>
+struct selector_ids<id_selector<matches...>>
+{
+    static constexpr bool enumerable = true;
+
+    static inline void append(std::vector<ID> &dest)
+    {
+        dest.insert(dest.end(), {matches...});
+    };
+};
+
+/* direct encoding */
+
+/**
+ * Write a record of type record_t straight to an IOIntf, producing the
+ * same bytes as creating the node, calling set() and write(). Record
+ * types without a specialization take exactly that route.
+ */
+template <typename record_t>
+struct record_writer
+{
+    template <typename value_t>
+    static inline void write(IOIntf *dest, ID id, const value_t &value)
+    {
+        std::shared_ptr<record_t> rec =
+            NodeHandleFactory<record_t>::create(id);
+        rec->set(value);
+        rec->write(dest);
+    }
+};
+
+template <typename _T, RecordType rt>
+struct record_writer<PrimitiveDataRecord<_T, rt>>
+{
+    static inline void write(IOIntf *dest, ID id, _T value)
+    {
+        PrimitiveDataRecord<_T, rt>::write_value(dest, rt, id, value);
+    };
+};
+
+template <>
+struct record_writer<VarIntRecord>
+{
+    static inline void write(IOIntf *dest, ID id, VarInt value)
+    {
+        VarIntRecord::write_value(dest, RT_VARINT, id, value);
+    };
+};
+
+template <>
+struct record_writer<VarUIntRecord>
+{
+    static inline void write(IOIntf *dest, ID id, VarUInt value)
+    {
+        VarUIntRecord::write_value(dest, RT_VARUINT, id, value);
+    };
+};
+
+template <>
+struct record_writer<BoolRecord>
+{
+    static inline void write(IOIntf *dest, ID id, bool value)
+    {
+        BoolRecord::write_value(dest, id, value);
+    };
+};
+
+template <typename enum_t, RecordType rt, typename underlying_record_type>
+struct record_writer<EnumRecordTpl<enum_t, rt, underlying_record_type>>
+{
+    typedef typename EnumRecordTpl<enum_t, rt, underlying_record_type>::int_t int_t;
+
+    static inline void write(IOIntf *dest, ID id, enum_t value)
+    {
+        underlying_record_type::write_value(dest, rt, id, (int_t)value);
+    };
+};
+
+template <>
+struct record_writer<BlobRecord>
+{
+    static inline void write(IOIntf *dest, ID id, const std::string &value)
+    {
+        // BlobRecord::set(std::string) keeps the terminating zero
+        BlobRecord::write_value(dest, id, value.c_str(), value.size()+1);
+    };
+};
+
+/**
+ * Write the header of an armored container, as ToBitstream does for
+ * containers started without child count.
+ */
+inline void write_container_start(IOIntf *dest, ID id)
+{
+    uint8_t header[Node::max_header_size + Utils::max_varint_size];
+    intptr_t len = Node::encode_header(header, RT_CONTAINER, id);
+    len += Utils::encode_varuint(&header[len], CF_ARMORED);
+    swrite(dest, header, len);
+}
+
+inline void write_container_end(IOIntf *dest)
+{
+    Utils::write_record_type(dest, RT_END_OF_CHILDREN);
+}
+
+/* direct decoding */
+
+template <typename value_t>
+struct cursor_value;
+
+#define STRUCTSTREAM_CURSOR_VALUE(type, field)                    \
+    template <>                                                 \
+    struct cursor_value<type>                                   \
+    {                                                           \
+        static inline type get(const CursorEvent &ev)           \
+        {                                                       \
+            return ev.value.field;                              \
+        };                                                      \
+    }
+
+STRUCTSTREAM_CURSOR_VALUE(uint32_t, u32);
+STRUCTSTREAM_CURSOR_VALUE(int32_t, i32);
+STRUCTSTREAM_CURSOR_VALUE(uint64_t, u64);
+STRUCTSTREAM_CURSOR_VALUE(int64_t, i64);
+STRUCTSTREAM_CURSOR_VALUE(float, f32);
+STRUCTSTREAM_CURSOR_VALUE(double, f64);
+STRUCTSTREAM_CURSOR_VALUE(bool, b);
+
+#undef STRUCTSTREAM_CURSOR_VALUE
+
+/**
+ * Compile-time knowledge about the built-in record types: test()
+ * checks a record type from the bitstream against the record class,
+ * get() extracts the value of a CE_VALUE event. Together they replace
+ * the node_cast<>() and get() of the node based deserializers.
+ */
+template <typename record_t, typename enable = void>
+struct record_traits
+{
+
+};
+
+template <typename _T, RecordType rt>
+struct record_traits<PrimitiveDataRecord<_T, rt>>
+{
+    static inline bool test(RecordType to_test)
+    {
+        return to_test == rt;
+    };
+
+    static inline _T get(const CursorEvent &ev)
+    {
+        return cursor_value<_T>::get(ev);
+    };
+};
+
+template <>
+struct record_traits<VarIntRecord>
+{
+    static inline bool test(RecordType to_test)
+    {
+        return to_test == RT_VARINT;
+    };
+
+    static inline VarInt get(const CursorEvent &ev)
+    {
+        return ev.value.i64;
+    };
+};
+
+template <>
+struct record_traits<VarUIntRecord>
+{
+    static inline bool test(RecordType to_test)
+    {
+        return to_test == RT_VARUINT;
+    };
+
+    static inline VarUInt get(const CursorEvent &ev)
+    {
+        return ev.value.u64;
+    };
+};
+
+template <>
+struct record_traits<BoolRecord>
+{
+    static inline bool test(RecordType to_test)
+    {
+        return (to_test == RT_BOOL_TRUE) || (to_test == RT_BOOL_FALSE);
+    };
+
+    static inline bool get(const CursorEvent &ev)
+    {
+        return ev.value.b;
+    };
+};
+
+template <typename enum_t, RecordType rt, typename underlying_record_type>
+struct record_traits<EnumRecordTpl<enum_t, rt, underlying_record_type>>
+{
+    static inline bool test(RecordType to_test)
+    {
+        return to_test == rt;
+    };
+
+    static inline enum_t get(const CursorEvent &ev)
+    {
+        return (enum_t)record_traits<underlying_record_type>::get(ev);
+    };
+};
+
+template <size_t len, RecordType rt, typename char_t>
+struct record_traits<StaticByteArrayRecord<len, rt, char_t>>
+{
+    static inline bool test(RecordType to_test)
+    {
+        return to_test == rt;
+    };
+};
+
+template <>
+struct record_traits<UTF8Record>
+{
+    static inline bool test(RecordType to_test)
+    {
+        return to_test == RT_UTF8STRING;
+    };
+};
+
+template <>
+struct record_traits<BlobRecord>
+{
+    static inline bool test(RecordType to_test)
+    {
+        return to_test == RT_BLOB;
+    };
+};
+
+template <typename record_t>
+struct record_traits<
+    record_t,
+    typename std::enable_if<std::is_base_of<Container, record_t>::value>::type>
+{
+    static inline bool test(RecordType to_test)
+    {
+        return to_test == RT_CONTAINER;
+    };
+};
+
+/**
+ * Return true if *node* is a record_t, so that it may be cast to
+ * record_t. The record type alone is not enough: registries may
+ * create other classes for the built-in record types, and
+ * EnumRecordTpl shares the record type of its underlying record
+ * class. node_cast() recognizes nodes created as record_t by their
+ * class tag, without RTTI.
+ */
+template <typename record_t>
+inline bool record_matches(const Node *node)
+{
+    return node_cast<record_t>(node) != nullptr;
+}
+
+/**
+ * Return true if the record of *ev* is handled by *decl*.
+ */
+template <typename decl>
+inline bool event_matches(const CursorEvent &ev)
+{
+    return decl::selector_t::test(ev.id)
+        && record_traits<typename decl::record_t>::test(ev.rt);
+}
+
+/**
+ * Skip the record of *ev*, including all children if it is a
+ * container.
+ */
+inline void skip_event(BitstreamCursor &cursor, const CursorEvent &ev)
+{
+    if (ev.kind == CE_START_CONTAINER) {
+        cursor.skip_container();
+    }
+}
+
+/* member dispatch */
+
+/**
+ * Lookup table from IDs to the members of a struct, holding one
+ * function of type fn_t per member.
+ *
+ * Members are added in declaration order. The IDs of members with
+ * enumerable selectors are kept sorted, so that finding the
+ * candidates for an ID is a binary search. Members with other
+ * selectors are tested one by one. Among the candidates, the
+ * declaration order is kept, so the first member which accepts a
+ * record wins, exactly like with a linear scan.
+ */
+template <typename fn_t>
+class member_table
+{
+private:
+    typedef bool (*test_t)(const ID);
+    typedef std::pair<ID, size_t> entry_t;
+
+    std::vector<fn_t> _fns;
+    std::vector<entry_t> _by_id;
+    std::vector<std::pair<size_t, test_t>> _unindexed;
+
+    static inline bool id_less(const entry_t &a, const entry_t &b)
+    {
+        return a.first < b.first;
+    };
+
+public:
+    template <typename selector_t>
+    void add(fn_t fn)
+    {
+        const size_t index = _fns.size();
+        _fns.push_back(fn);
+
+        if (!selector_ids<selector_t>::enumerable) {
+            _unindexed.push_back(std::make_pair(index, &selector_t::test));
+            return;
+        }
+
+        std::vector<ID> ids;
+        selector_ids<selector_t>::append(ids);
+        for (auto id: ids) {
+            entry_t entry(id, index);
+            _by_id.insert(
+                std::upper_bound(_by_id.begin(), _by_id.end(), entry),
+                entry);
+        }
+    }
+
+    /**
+     * Call *call* with the functions of all members which accept
+     * *id*, in declaration order, until it returns true.
+     *
+     * @return true if *call* returned true.
+     */
+    template <typename call_t>
+    bool dispatch(const ID id, call_t call) const
+    {
+        auto range = std::equal_range(
+            _by_id.begin(), _by_id.end(), entry_t(id, 0), &id_less);
+        auto indexed = range.first;
+        auto other = _unindexed.begin();
+
+        while (indexed != range.second || other != _unindexed.end()) {
+            size_t index;
+            if (other == _unindexed.end()
+                || (indexed != range.second && indexed->second < other->first))
+            {
+                index = indexed->second;
+                ++indexed;
+            } else {
+                index = other->first;
+                bool accepted = other->second(id);
+                ++other;
+                if (!accepted) {
+                    continue;
+                }
+            }
+
+            if (call(_fns[index])) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
 /* value helpers */
 
 template <typename record_t, typename value_t>
@@ -113,6 +510,17 @@ struct value_helper
         dest = src->get();
     };
 
+    static inline void from_event(const CursorEvent &ev, value_t &dest)
+    {
+        dest = record_traits<record_t>::get(ev);
+    };
+
+    static inline void write(const value_t &src, const ID record_id,
+                             IOIntf *dest)
+    {
+        record_writer<record_t>::write(dest, record_id, src);
+    };
+
     static inline std::shared_ptr<record_t> to_record(
         const value_t &src,
         const ID record_id)
@@ -132,6 +540,19 @@ struct value_helper<UTF8Record, std::string>
         dest = src->datastr();
     };
 
+    static inline void from_event(const CursorEvent &ev, std::string &dest)
+    {
+        // like datastr(), which stops at the first zero
+        dest.assign((const char*)ev.data,
+                    strnlen((const char*)ev.data, ev.len));
+    };
+
+    static inline void write(const std::string &src, const ID record_id,
+                             IOIntf *dest)
+    {
+        UTF8Record::write_value(dest, record_id, src.data(), src.size());
+    };
+
     static inline std::shared_ptr<UTF8Record> to_record(
         const std::string &src,
         const ID record_id)
@@ -155,6 +576,20 @@ struct value_helper<StaticByteArrayRecord<len, rt, char_t>,
         src->raw_get(dest);
     };
 
+    static inline void from_event(const CursorEvent &ev, array_t &dest)
+    {
+        if (ev.len != (intptr_t)len) {
+            throw IllegalData("Static byte array record has wrong length.");
+        }
+        memcpy(dest, ev.data, len);
+    };
+
+    static inline void write(const array_t &src, const ID record_id,
+                             IOIntf *dest)
+    {
+        record_t::write_value(dest, rt, record_id, src);
+    };
+
     static inline std::shared_ptr<record_t> to_record(
         const array_t &src,
         const ID record_id)
@@ -44,6 +44,8 @@ const VarInt MaxVarInt = 0x7fffffffffffff;
 const ID TreeRootID = 0x00000000;
 const ID MaxID = MaxVarUInt;
 const ID InvalidID = MaxID;
+// ID of the blob record holding the stream index, see StreamIndex
+const ID IndexTrailerID = MaxID - 1;
 
 const RecordType RT_RESERVED = 0x00;  // may indicate a larger typefield
 const RecordType RT_CONTAINER = 0x01;
@@ -74,7 +76,7 @@ enum ContainerFlags {
     CF_WITH_SIZE = 0x0001,
     CF_HASHED = 0x0002,
     CF_ARMORED = 0x0004,
-    CF_RESERVED0 = 0x0008,
+    CF_WITH_LENGTH = 0x0008,
 
     CF_APP0 = 0x0010,
     CF_APP1 = 0x0020,
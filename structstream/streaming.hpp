@@ -29,6 +29,9 @@ authors named in the AUTHORS file.
 #include "structstream/streaming_tree.hpp"
 #include "structstream/streaming_bitstream.hpp"
 #include "structstream/streaming_sinks.hpp"
+#include "structstream/streaming_cursor.hpp"
+#include "structstream/streaming_parallel.hpp"
+#include "structstream/streaming_push.hpp"
 
 namespace StructStream {
 
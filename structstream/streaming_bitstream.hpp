@@ -26,12 +26,13 @@ authors named in the AUTHORS file.
 #ifndef _STRUCTSTREAM_STREAMING_BITSTREAM_H
 #define _STRUCTSTREAM_STREAMING_BITSTREAM_H
 
-#include <list>
-#include <forward_list>
+#include <unordered_set>
+#include <vector>
 
 #include "structstream/streaming_base.hpp"
 #include "structstream/io.hpp"
 #include "structstream/registry.hpp"
+#include "structstream/streaming_index.hpp"
 
 namespace std {
 
@@ -66,6 +67,12 @@ public:
         virtual ~ContainerMeta() = default;
     public:
         bool has_hash;
+
+        /**
+         * Amount of bytes following the container header, if the
+         * container has CF_WITH_LENGTH, or -1.
+         */
+        intptr_t body_length;
     public:
         virtual ::StructStream::ContainerMeta *copy() const;
     };
@@ -73,8 +80,8 @@ protected:
     struct ParentInfo {
         ParentInfo():
             cont(),
-            meta(new ContainerMeta()),
-            footer(new ContainerFooter()),
+            meta(),
+            footer(),
             pipe_h(),
             pipe(nullptr),
             read_child_count(0),
@@ -85,17 +92,30 @@ protected:
 
         virtual ~ParentInfo()
         {
-            if (meta) {
-                delete meta;
-            }
-            if (footer) {
-                delete footer;
-            }
+
+        };
+
+        /**
+         * Return the info to its initial state before it is reused
+         * for another container.
+         */
+        virtual void reset()
+        {
+            cont = ContainerHandle();
+            meta.child_count = -1;
+            meta.has_hash = false;
+            meta.body_length = -1;
+            footer.validated = false;
+            footer.hash_function = HT_NONE;
+            pipe_h = IOIntfHandle();
+            pipe = nullptr;
+            read_child_count = 0;
+            armored = false;
         };
 
         ContainerHandle cont;
-        ContainerMeta *meta;
-        ContainerFooter *footer;
+        ContainerMeta meta;
+        ContainerFooter footer;
         IOIntfHandle pipe_h;
         HashPipe<HP_READ> *pipe;
 
@@ -103,33 +123,64 @@ protected:
         bool armored;
     };
 public:
+    /**
+     * Create a reader which decodes the bitstream from *source* and
+     * pushes the resulting events into *sink*. Pass
+     * Registry::defaults() as *nodetypes* if no custom record types
+     * are needed.
+     *
+     * Unless *buffer_size* is zero, the source is wrapped into a
+     * BufferedReader with the given block size. As the buffer reads
+     * ahead, you should pass zero if you intend to continue reading
+     * from *source* after the end of the structstream. Sources which
+     * buffer by themselves (see IOIntf::buffered()) are never wrapped.
+     */
     FromBitstream(IOIntfHandle source,
-             const RegistryHandle nodetypes,
-             StreamSink sink);
+             const ConstRegistryHandle nodetypes,
+             StreamSink sink,
+             const intptr_t buffer_size = BufferedReader::default_block_size);
     virtual ~FromBitstream();
 private:
     IOIntfHandle _original_source_h;
     IOIntfHandle _source_h;
     IOIntf *_source;
 
-    const RegistryHandle _node_factory_h;
+    const ConstRegistryHandle _node_factory_h;
     const Registry *_node_factory;
 
     StreamSink _sink_h;
     StreamSinkIntf *_sink;
 
-    std::list<ParentInfo*> _parent_stack;
+    // the entries up to _parent_depth are in use, the others are kept
+    // for reuse
+    std::vector<ParentInfo*> _parent_stack;
+    std::vector<ParentInfo*>::size_type _parent_depth;
     ParentInfo *_curr_parent;
 
+    std::unordered_set<std::pair<RecordType, ID> > _skipped;
+
     uint32_t _forgiveness;
 protected:
     void cleanup_state();
     void check_end_of_container();
     void check_hash_length(VarUInt len);
     void push_root();
+    ParentInfo *next_parent_info();
+    void pop_parent_info();
 protected:
+    /**
+     * Create a new, blank ParentInfo. This is only called when the
+     * nesting depth exceeds all depths seen before; the infos are
+     * reset() and reused afterwards.
+     */
     virtual ParentInfo *new_parent_info() const;
-    void start_of_container(ContainerHandle cont_h);
+
+    /**
+     * Decide whether a container, whose header has just been read, is
+     * skipped. Only called for containers with CF_WITH_LENGTH.
+     */
+    virtual bool skip_container(ParentInfo *info) const;
+    bool start_of_container(ContainerHandle cont_h);
     virtual void proc_container_flags(VarUInt &flags_int,
                                       ParentInfo *info);
     virtual void end_of_container_header(ParentInfo *info);
@@ -157,30 +208,100 @@ public:
     void read_next();
 
     void set_forgiving_for(uint32_t forgiveness, bool forgiving = true);
+
+    /**
+     * Skip containers of record type *rt* with *id*, if they carry
+     * their body length (CF_WITH_LENGTH). Skipped containers are
+     * passed over with a single skip of the source and produce no
+     * events; their hash is not checked. Containers without body
+     * length are read as usual.
+     */
+    void set_skip(RecordType rt, ID id, bool skip = true);
 };
 
 class ToBitstream: public StreamSinkIntf {
+private:
+    struct CountingWriter;
 protected:
     struct ParentInfo {
+        ParentInfo():
+            cont(),
+            child_count(-1),
+            armored(false),
+            hash_function(HT_NONE),
+            with_length(false),
+            flags(0),
+            length_offset(-1),
+            body_start(0),
+            outer_h(),
+            body_h(),
+            body(nullptr)
+        {
+
+        };
+
+        virtual ~ParentInfo() = default;
+
         ContainerHandle cont;
         int32_t child_count;
         bool armored;
         HashType hash_function;
+
+        // state of containers with CF_WITH_LENGTH. On seekable
+        // outputs, the length is filled in at *length_offset* once
+        // the body is written, otherwise the body is collected in
+        // *body* until the length is known
+        bool with_length;
+        VarUInt flags;
+        intptr_t length_offset;
+        intptr_t body_start;
+        IOIntfHandle outer_h;
+        IOIntfHandle body_h;
+        SegmentedMemory *body;
     };
 public:
-    ToBitstream(IOIntfHandle dest);
+    /**
+     * Create a writer which encodes all events into *dest*.
+     *
+     * Unless *buffer_size* is zero, *dest* is wrapped into a
+     * BufferedWriter with the given block size. The buffer is
+     * flushed on close() (and thus at the end of the stream), on
+     * flush() and on destruction. Destinations which buffer by
+     * themselves (see IOIntf::buffered()) are never wrapped.
+     */
+    ToBitstream(IOIntfHandle dest,
+                const intptr_t buffer_size = BufferedWriter::default_block_size);
     virtual ~ToBitstream();
 protected:
     IOIntfHandle _dest_h;
     IOIntf *_dest;
+    BufferedWriter *_buffer;
+    // lowest layer of the output, where lengths are back-patched
+    IOIntf *_output;
+    SegmentPoolHandle _body_pool;
 
-    std::forward_list<ParentInfo*> _parent_stack;
+    // see FromBitstream
+    std::vector<ParentInfo*> _parent_stack;
+    std::vector<ParentInfo*>::size_type _parent_depth;
     ParentInfo *_curr_parent;
 
     bool _default_armor;
+    bool _default_length;
+
+    CountingWriter *_counter;
+    std::vector<StreamIndexEntry> _index;
 protected:
     void require_open() const;
+    intptr_t encode_container_header(uint8_t *dest, VarUInt flags,
+                                     ParentInfo *info,
+                                     intptr_t body_length,
+                                     intptr_t *length_pos = nullptr);
 protected:
+    /**
+     * Create a new ParentInfo. Like in FromBitstream, infos are
+     * reused for later containers at the same depth; setup_container()
+     * has to initialise all members.
+     */
     virtual ParentInfo *new_parent_info() const;
     virtual VarUInt get_container_flags(ParentInfo *info);
     virtual void setup_container(ParentInfo *info, ContainerHandle cont, const ContainerMeta *meta);
@@ -194,6 +315,12 @@ public:
     virtual void end_of_stream();
 public:
     void close();
+
+    /**
+     * Forward all buffered output to the destination passed to the
+     * constructor.
+     */
+    void flush();
 public:
     inline bool get_armor_default() const {
         return _default_armor;
@@ -201,11 +328,43 @@ public:
     void set_armor_default(bool armor) {
         _default_armor = armor;
     };
+
+    inline bool get_length_default() const {
+        return _default_length;
+    };
+
+    /**
+     * If *with_length* is true, containers are written with
+     * CF_WITH_LENGTH, so that readers can skip them without parsing
+     * their children.
+     *
+     * If the destination is seekable, the length is written with a
+     * fixed size and filled in once the container ends. Otherwise,
+     * the body of such a container is held in memory until the
+     * container ends, as the length precedes it; bodies of nested
+     * containers are moved into their parent without copying.
+     */
+    void set_length_default(bool with_length) {
+        _default_length = with_length;
+    };
+
+    /**
+     * Record the offsets of all top-level nodes and write them as
+     * index at the end of the stream (see StreamIndex). This must be
+     * called before the first node is written; offsets are counted
+     * from that point on.
+     */
+    void enable_index();
+
+    inline bool index_enabled() const {
+        return _counter != nullptr;
+    };
 };
 
 class ToBitstreamHashing: public ToBitstream {
 public:
-    ToBitstreamHashing(IOIntfHandle dest);
+    ToBitstreamHashing(IOIntfHandle dest,
+                       const intptr_t buffer_size = BufferedWriter::default_block_size);
     virtual ~ToBitstreamHashing() = default;
 private:
     std::unordered_map<std::pair<RecordType, ID>, HashType> _hash_functions;
@@ -0,0 +1,236 @@
+/**********************************************************************
+File name: streaming_cursor.hpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#ifndef _STRUCTSTREAM_STREAMING_CURSOR_H
+#define _STRUCTSTREAM_STREAMING_CURSOR_H
+
+#include <vector>
+
+#include "structstream/streaming_bitstream.hpp"
+
+namespace StructStream {
+
+enum CursorEventKind {
+    /**
+     * A record with a scalar value, which is stored in
+     * CursorEvent::value.
+     */
+    CE_VALUE,
+
+    /**
+     * A record with a byte payload (blobs, strings, RT_RAW128 and
+     * appblobs), which is available through CursorEvent::data and
+     * CursorEvent::len.
+     */
+    CE_BLOB,
+
+    CE_START_CONTAINER,
+    CE_END_CONTAINER
+};
+
+/**
+ * A single event produced by BitstreamCursor.
+ *
+ * Events are plain values which live on the callers stack. The span
+ * of a CE_BLOB event points into memory owned by the cursor or the
+ * source and stays valid until the next call of any method of the
+ * cursor.
+ */
+struct CursorEvent {
+    CursorEventKind kind;
+    RecordType rt;
+    ID id;
+
+    /**
+     * Amount of containers enclosing the record. Top-level records
+     * have depth 0. Start and end events of a container share the
+     * depth of the container itself.
+     */
+    int32_t depth;
+
+    union {
+        uint32_t u32;
+        int32_t i32;
+        uint64_t u64;   // also used for RT_VARUINT
+        int64_t i64;    // also used for RT_VARINT
+        float f32;
+        double f64;
+        bool b;
+    } value;
+
+    /**
+     * Payload of CE_BLOB events. Strings are not NUL-terminated.
+     *
+     * For CE_START_CONTAINER events, *len* holds the body length of
+     * containers with CF_WITH_LENGTH and -1 for other containers.
+     */
+    const uint8_t *data;
+    intptr_t len;
+
+    /**
+     * Announced amount of children for CE_START_CONTAINER events (-1
+     * if the container does not announce its size) and amount of
+     * children read for CE_END_CONTAINER events.
+     */
+    int32_t child_count;
+
+    /**
+     * Hash function of the container and whether the hash has been
+     * checked successfully, for CE_END_CONTAINER events.
+     */
+    HashType hash_function;
+    bool validated;
+};
+
+/**
+ * Pull parser for the bitstream format.
+ *
+ * In contrast to FromBitstream, the cursor creates no nodes and
+ * pushes nothing into sinks. Each call to next() decodes exactly one
+ * record and describes it in a CursorEvent. The container stack is
+ * kept in a reused vector and blob payloads are either handed out in
+ * place or copied into a reused buffer, so that, apart from hashed
+ * containers, reading a stream does not allocate once the buffers
+ * have grown to their working size.
+ *
+ * The forgiveness flags of FromBitstream apply, except that
+ * appblobs are never unknown to the cursor: they are reported as
+ * CE_BLOB events, or skipped silently if
+ * FromBitstream::UnknownAppblobs is set.
+ */
+class BitstreamCursor {
+private:
+    struct Frame {
+        ID id;
+        int32_t child_count;
+        int32_t read_child_count;
+        bool armored;
+        HashType hash_function;
+        intptr_t body_length;
+        IOIntfHandle pipe_h;
+        HashPipe<HP_READ> *pipe;
+    };
+public:
+    /**
+     * Create a cursor on *source*. See FromBitstream for the meaning
+     * of *buffer_size*. read_node() creates nodes using
+     * Registry::defaults().
+     */
+    explicit BitstreamCursor(IOIntfHandle source,
+                             const intptr_t buffer_size = BufferedReader::default_block_size);
+
+    /**
+     * Create a cursor on *source* whose read_node() creates nodes
+     * using *nodetypes*.
+     */
+    BitstreamCursor(IOIntfHandle source,
+                    const ConstRegistryHandle nodetypes,
+                    const intptr_t buffer_size = BufferedReader::default_block_size);
+    BitstreamCursor(const BitstreamCursor &ref) = delete;
+    BitstreamCursor &operator=(const BitstreamCursor &ref) = delete;
+    virtual ~BitstreamCursor();
+private:
+    IOIntfHandle _original_source_h;
+    IOIntfHandle _source_h;
+    IOIntf *_source;
+
+    const ConstRegistryHandle _node_factory_h;
+
+    std::vector<Frame> _stack;
+    std::vector<uint8_t> _payload;
+    intptr_t _pending_commit;
+    bool _at_container_start;
+
+    uint32_t _forgiveness;
+private:
+    void commit_pending();
+    bool end_reached() const;
+    void end_of_container(CursorEvent &ev);
+    void proc_end_of_children();
+    void read_container_header(CursorEvent &ev);
+    void read_footer(Frame &frame, CursorEvent &ev);
+    void read_span(CursorEvent &ev, intptr_t len);
+    void unwind_pipes();
+public:
+    /**
+     * Decode the next record into *ev*.
+     *
+     * @return false once the end of the stream has been reached. *ev*
+     * is undefined in that case.
+     */
+    bool next(CursorEvent &ev);
+
+    /**
+     * Skip the remainder of the innermost open container, including
+     * its end. Call this right after a CE_START_CONTAINER event to
+     * skip the whole container.
+     *
+     * If called right after the start of a container with
+     * CF_WITH_LENGTH, the body is skipped in one go and its hash is
+     * not checked. Otherwise, the children are decoded and hashes are
+     * verified.
+     */
+    void skip_container();
+
+    /**
+     * Amount of containers currently open.
+     */
+    inline int32_t depth() const {
+        return _stack.empty() ? 0 : _stack.size() - 1;
+    };
+
+    /**
+     * Return the position of the source after the last event, as
+     * reported by IOIntf::tell(), or -1 if the source cannot tell.
+     */
+    intptr_t offset();
+
+    /**
+     * Create a node for the record described by *ev*, which must be
+     * the last event returned by next(). For CE_START_CONTAINER
+     * events, all children up to the end of the container are read
+     * and added to the node.
+     *
+     * This is meant for the odd record which is needed as node; it
+     * allocates like FromBitstream does. Nodes are created by the
+     * registry passed to the constructor. Appblob nodes read their
+     * record themselves, like with FromBitstream.
+     *
+     * @throws UnsupportedRecordType if the registry creates a node
+     *     whose class does not fit the record type.
+     */
+    NodeHandle read_node(const CursorEvent &ev);
+
+    /**
+     * Release the reference on the source passed to the constructor.
+     */
+    void close();
+
+    void set_forgiving_for(uint32_t forgiveness, bool forgiving = true);
+};
+
+}
+
+#endif
@@ -0,0 +1,149 @@
+/**********************************************************************
+File name: streaming_index.hpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#ifndef _STRUCTSTREAM_STREAMING_INDEX_H
+#define _STRUCTSTREAM_STREAMING_INDEX_H
+
+#include <vector>
+
+#include "structstream/io_base.hpp"
+#include "structstream/registry.hpp"
+#include "structstream/streaming_base.hpp"
+
+namespace StructStream {
+
+struct StreamIndexEntry {
+    ID id;
+
+    /**
+     * Offset of the node, relative to the start of the stream.
+     */
+    intptr_t offset;
+};
+
+/**
+ * Random access to the top-level nodes of a stream written by a
+ * ToBitstream with enable_index().
+ *
+ * The index is stored as a blob record with the ID IndexTrailerID,
+ * right before the final end-of-children marker of the stream. Thus,
+ * readers which are not aware of the index see an additional blob.
+ * The blob ends with a fixed-size footer, which allows to find the
+ * index by looking at the end of the stream. See docs/format.rst for
+ * the layout.
+ *
+ * As applications may use IndexTrailerID for their own blobs, a blob
+ * is only taken for the index if its footer matches its position and
+ * length (see is_trailer()).
+ */
+class StreamIndex {
+public:
+    static const intptr_t footer_size = 24;
+public:
+    /**
+     * Load the index of the stream which ends at the end of *source*.
+     * The source must be seekable.
+     *
+     * @throws UnsupportedInput if the source is not seekable.
+     * @throws IllegalData if the stream has no valid index.
+     */
+    explicit StreamIndex(IOIntfHandle source);
+    StreamIndex(const StreamIndex &ref) = delete;
+    StreamIndex &operator=(const StreamIndex &ref) = delete;
+    virtual ~StreamIndex();
+private:
+    IOIntfHandle _source_h;
+    intptr_t _base;
+    std::vector<StreamIndexEntry> _entries;
+    // entry numbers sorted by ID
+    std::vector<size_t> _by_id;
+public:
+    inline size_t size() const {
+        return _entries.size();
+    };
+
+    inline const StreamIndexEntry &operator[](size_t n) const {
+        return _entries[n];
+    };
+
+    /**
+     * Return the number of the first top-level node with *id*, or -1
+     * if there is none.
+     */
+    intptr_t find(ID id) const;
+
+    /**
+     * Return the position of the *n*-th node in the source.
+     */
+    inline intptr_t position(size_t n) const {
+        return _base + _entries.at(n).offset;
+    };
+
+    /**
+     * Move the source to the start of the *n*-th top-level node, so
+     * that any reader can be started on it. Readers should be
+     * created with a *buffer_size* of zero or be discarded before the
+     * next call.
+     */
+    void seek(size_t n);
+
+    /**
+     * Decode the *n*-th top-level node (including all children) into
+     * *sink* using a fresh FromBitstream.
+     */
+    void read_node(size_t n, StreamSink sink,
+                   ConstRegistryHandle nodetypes = Registry::defaults());
+
+    /**
+     * Decode the *n*-th top-level node and return it.
+     */
+    NodeHandle read_node(size_t n,
+                         ConstRegistryHandle nodetypes = Registry::defaults());
+
+    inline IOIntfHandle source() const {
+        return _source_h;
+    };
+public:
+    /**
+     * Return true if the blob payload *data* of *len* bytes is an
+     * index trailer, given that its record starts at *offset*
+     * relative to the start of the stream and is *record_len* bytes
+     * long including the header.
+     */
+    static bool is_trailer(const uint8_t *data, intptr_t len,
+                           intptr_t offset, intptr_t record_len);
+
+    /**
+     * Write the index record for *entries* to *dest*. *offset* is the
+     * position of the index record in the stream.
+     */
+    static void write_trailer(IOIntf *dest,
+                              const std::vector<StreamIndexEntry> &entries,
+                              intptr_t offset);
+};
+
+}
+
+#endif
@@ -0,0 +1,148 @@
+/**********************************************************************
+File name: streaming_parallel.hpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#ifndef _STRUCTSTREAM_STREAMING_PARALLEL_H
+#define _STRUCTSTREAM_STREAMING_PARALLEL_H
+
+#include <functional>
+#include <vector>
+
+#include "structstream/io_base.hpp"
+#include "structstream/registry.hpp"
+#include "structstream/streaming_base.hpp"
+#include "structstream/streaming_index.hpp"
+
+namespace StructStream {
+
+/**
+ * A range of consecutive top-level nodes decoded as one unit by
+ * ParallelReader.
+ */
+struct ParallelChunk {
+    size_t index;
+    size_t first_node;
+    size_t node_count;
+};
+
+/**
+ * Decode the top-level nodes of a stream on several threads.
+ *
+ * The stream is split at top-level node boundaries into chunks, each
+ * of which is decoded by a FromBitstream of its own into a sink of
+ * its own. The boundaries are taken from a StreamIndex, if one is
+ * passed, or found by a single pass of a BitstreamCursor. The latter
+ * is cheap for containers with CF_WITH_LENGTH, which are skipped
+ * without looking at their children.
+ *
+ * The source has to be contiguous (see IOIntf::contiguous()), like
+ * MemoryView or MappedFile, so that all workers can read from it at
+ * the same time.
+ */
+class ParallelReader {
+public:
+    /**
+     * Create the sink for a chunk. Called on the worker thread which
+     * decodes the chunk.
+     */
+    typedef std::function<StreamSink(const ParallelChunk&)> SinkFactory;
+
+    /**
+     * Receive a decoded chunk, together with its sink. Calls are
+     * never concurrent.
+     */
+    typedef std::function<void(const ParallelChunk&, StreamSink)> ChunkHandler;
+public:
+    /**
+     * Prepare to decode the stream which starts at the current
+     * position of *source*.
+     *
+     * @throws UnsupportedInput if *source* is not contiguous.
+     */
+    explicit ParallelReader(IOIntfHandle source,
+                            ConstRegistryHandle nodetypes = Registry::defaults());
+
+    /**
+     * Decode the stream indexed by *index*, taking the boundaries
+     * from the index instead of scanning the stream. The source of
+     * the index must be contiguous.
+     */
+    explicit ParallelReader(const StreamIndex &index,
+                            ConstRegistryHandle nodetypes = Registry::defaults());
+    ParallelReader(const ParallelReader &ref) = delete;
+    ParallelReader &operator=(const ParallelReader &ref) = delete;
+    virtual ~ParallelReader();
+private:
+    IOIntfHandle _source_h;
+    // position of _data in the source
+    intptr_t _origin;
+    const uint8_t *_data;
+    intptr_t _len;
+
+    const ConstRegistryHandle _node_factory_h;
+
+    bool _scanned;
+    std::vector<intptr_t> _offsets;
+
+    uint32_t _forgiveness;
+private:
+    void map_source();
+    void decode_chunk(const ParallelChunk &chunk, StreamSink sink);
+    void scan();
+public:
+    /**
+     * Return the amount of top-level nodes, not counting a stream
+     * index. This scans the stream if necessary.
+     */
+    size_t node_count();
+
+    /**
+     * Decode all top-level nodes.
+     *
+     * @param threads Amount of worker threads; zero picks the
+     *     amount of hardware threads.
+     * @param make_sink Creates the sink for each chunk.
+     * @param handler Receives each chunk after decoding. Chunks
+     *     which cannot be delivered yet in ordered mode are held
+     *     back; workers stall if too many are pending.
+     * @param ordered If true, chunks are delivered in stream order,
+     *     otherwise as soon as they are done.
+     * @param nodes_per_chunk Amount of top-level nodes per chunk;
+     *     zero picks a value which gives each thread a few chunks.
+     *
+     * The first exception thrown by a worker or *handler* stops all
+     * workers and is rethrown by this method.
+     */
+    void read_all(unsigned int threads,
+                  const SinkFactory &make_sink,
+                  const ChunkHandler &handler,
+                  bool ordered = true,
+                  size_t nodes_per_chunk = 0);
+
+    void set_forgiving_for(uint32_t forgiveness, bool forgiving = true);
+};
+
+}
+
+#endif
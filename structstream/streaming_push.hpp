@@ -0,0 +1,163 @@
+/**********************************************************************
+File name: streaming_push.hpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#ifndef _STRUCTSTREAM_STREAMING_PUSH_H
+#define _STRUCTSTREAM_STREAMING_PUSH_H
+
+#include <vector>
+
+#include "structstream/hashing_base.hpp"
+#include "structstream/streaming_bitstream.hpp"
+
+namespace StructStream {
+
+class MemoryView;
+
+/**
+ * Decode a bitstream which is handed over in pieces, as they arrive.
+ *
+ * FromBitstream pulls its input and thus needs a source which blocks
+ * until data is available. PushParser works the other way round: the
+ * caller feed()s whatever bytes it has, and the parser pushes events
+ * for all complete records into the sink. An incomplete record at the
+ * end of a piece (including a partial varint, blob payload or hash
+ * footer) is kept until the next feed(). Hash state of open
+ * containers is carried over as well, so a parser only costs memory,
+ * not a thread, while waiting for input.
+ *
+ * Records are buffered until they are complete, so the largest
+ * record bounds the memory use. Only a record which straddles two
+ * pieces is copied; everything after it is parsed in place. Appblobs skipped due to forgiveness
+ * and containers skipped with set_skip() are passed over without
+ * buffering.
+ */
+class PushParser {
+public:
+    typedef FromBitstream::Forgiveness Forgiveness;
+private:
+    struct Frame {
+        ContainerHandle cont;
+        FromBitstream::ContainerMeta meta;
+        ContainerFooter footer;
+        IncrementalHash *hash;
+        int32_t read_child_count;
+        bool armored;
+        // all children have been read, the footer is next
+        bool ended;
+    };
+public:
+    /**
+     * Create a parser which pushes the events of the decoded stream
+     * into *sink*. See FromBitstream for *nodetypes*.
+     */
+    PushParser(const ConstRegistryHandle nodetypes, StreamSink sink);
+    PushParser(const PushParser &ref) = delete;
+    PushParser &operator=(const PushParser &ref) = delete;
+    virtual ~PushParser();
+private:
+    const ConstRegistryHandle _node_factory_h;
+    const Registry *_node_factory;
+
+    StreamSink _sink_h;
+    StreamSinkIntf *_sink;
+
+    std::vector<Frame> _stack;
+    std::vector<uint8_t> _buffer;
+    // no attempt to parse is made until the buffer holds this much
+    intptr_t _needed;
+    // bytes to be passed over without parsing
+    VarUInt _skip_remaining;
+    bool _finished;
+
+    // data being parsed and start of the current record in it
+    const uint8_t *_input;
+    intptr_t _record_start;
+
+    std::unordered_set<std::pair<RecordType, ID> > _skipped;
+
+    uint32_t _forgiveness;
+private:
+    void check_end_of_container();
+    void consume_record(const MemoryView &view);
+    void end_of_stream();
+    void hash_input(const uint8_t *data, intptr_t len);
+    intptr_t parse(const uint8_t *data, intptr_t len);
+    void pop_frame();
+    void push_frame(ContainerHandle cont_h);
+    void read_container(MemoryView &view, ContainerHandle cont_h);
+    void read_footer(MemoryView &view);
+    bool read_step(MemoryView &view);
+public:
+    /**
+     * Decode as much as possible of *data*, together with what has
+     * been kept from earlier calls.
+     *
+     * @return The amount of bytes of *data* which belong to the
+     *     stream. This is less than *len* only if the end of the
+     *     stream has been reached; the remaining bytes have not been
+     *     looked at.
+     */
+    intptr_t feed(const uint8_t *data, intptr_t len);
+
+    /**
+     * Signal that no more data will arrive.
+     *
+     * @throws EndOfStreamError if the stream is incomplete.
+     */
+    void finish();
+
+    /**
+     * Return true once the end of the stream has been decoded (or the
+     * sink has been closed).
+     */
+    inline bool finished() const {
+        return _finished;
+    };
+
+    /**
+     * Amount of bytes kept back because they do not form a complete
+     * record yet.
+     */
+    inline intptr_t buffered() const {
+        return _buffer.size();
+    };
+
+    /**
+     * Drop all state and the reference on the sink. Further input is
+     * ignored.
+     */
+    void close();
+
+    void set_forgiving_for(uint32_t forgiveness, bool forgiving = true);
+
+    /**
+     * See FromBitstream::set_skip().
+     */
+    void set_skip(RecordType rt, ID id, bool skip = true);
+};
+
+}
+
+#endif
@@ -27,19 +27,38 @@ authors named in the AUTHORS file.
 #define _STRUCTSTREAM_STREAMING_SINKS_H
 
 #include <forward_list>
+#include <vector>
 
 #include "structstream/streaming_base.hpp"
 
 namespace StructStream {
 
+/**
+ * Base for sinks which hand containers to other sinks with nest().
+ *
+ * The outermost SinkTree keeps the nested sinks on a stack and
+ * passes each event to the innermost one directly. Nested SinkTrees
+ * share the stack of the outermost one, so the cost of an event does
+ * not depend on the nesting depth.
+ */
 class SinkTree: public StreamSinkIntf {
 public:
     SinkTree();
     virtual ~SinkTree();
 private:
-    StreamSink _nested;
+    struct Frame {
+        StreamSink sink;
+        // sink, if it is a SinkTree
+        SinkTree *tree;
+        intptr_t depth;
+    };
+
+    // the tree which owns the stack and the position of this tree on
+    // it; the root has level zero
+    SinkTree *_root;
+    size_t _level;
     bool _handling_container;
-    intptr_t _depth;
+    std::vector<Frame> _stack;
 protected:
     void nest(StreamSink other);
 protected:
@@ -51,19 +51,74 @@ StructStream::ID read_id(StructStream::IOIntf *stream);
  */
 StructStream::RecordType read_record_type(StructStream::IOIntf *stream);
 
+/**
+ * Maximum amount of bytes an encoded varint occupies.
+ */
+static const intptr_t max_varint_size = 8;
+
+/**
+ * Encode a signed EBML varint into *dest*, which must provide room
+ * for at least max_varint_size bytes.
+ *
+ * @return Amount of bytes written.
+ * @throw LimitError if *value* is outside of MinVarInt and MaxVarInt.
+ */
+intptr_t encode_varint(uint8_t *dest, StructStream::VarInt value);
+
+/**
+ * Encode an unsigned EBML varint into *dest*, which must provide room
+ * for at least max_varint_size bytes.
+ *
+ * @return Amount of bytes written.
+ * @throw LimitError if *value* is larger than MaxVarUInt.
+ */
+intptr_t encode_varuint(uint8_t *dest, StructStream::VarUInt value);
+
+/**
+ * Decode *n* consecutive varuints from the buffer at *buf* into
+ * *out*.
+ *
+ * This is meant for packed integer arrays and index scans. Depending
+ * on the CPU, SSE4.1 or AVX2 shuffles are used to decode several
+ * values at once.
+ *
+ * @param buf Buffer holding the encoded values.
+ * @param len Length of the buffer in bytes.
+ * @param out Array receiving *n* decoded values.
+ * @param n Amount of values to decode.
+ * @return Amount of bytes consumed from *buf*.
+ * @throw EndOfStreamError if *buf* ends before *n* values were read.
+ * @throw InvalidVarIntError on malformed varuints.
+ */
+size_t read_varuints(const uint8_t *buf, size_t len,
+                     StructStream::VarUInt *out, size_t n);
+
+/**
+ * Encode *n* unsigned EBML varints back to back into *dest*, which
+ * must provide room for at least n * max_varint_size bytes.
+ *
+ * Unlike read_varuints(), this is scalar code: each value takes a
+ * count-leading-zeros, a byte swap and one unaligned 8-byte store,
+ * which leaves nothing for shuffles to gain.
+ *
+ * @return Amount of bytes written.
+ * @throw LimitError if a value is larger than MaxVarUInt. The values
+ * before it have been written to *dest* in that case.
+ */
+size_t encode_varuints(uint8_t *dest, const StructStream::VarUInt *values,
+                       size_t n);
+
 /**
  * Write a signed EBML varint.
  *
- * No range-checking is done whether the value can actually be
- * represented as a varint. Surplus bits will be cut off.
+ * @throw LimitError if *value* is outside of MinVarInt and MaxVarInt.
  */
 void write_varint(StructStream::IOIntf *stream, StructStream::VarInt value);
 
 /**
  * Write an unsigned EBML varint.
  *
- * No range-checking is done whether the value can actually be
- * represented as a varint. Surplus bits will be cut off.
+ * @throw LimitError if *value* is larger than MaxVarUInt.
  */
 void write_varuint(StructStream::IOIntf *stream, StructStream::VarUInt value);
 
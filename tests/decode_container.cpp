@@ -157,3 +157,76 @@ TEST_CASE ("decode/container/complex", "Complex nesting structure")
     children += 1;
     REQUIRE(children == cont1->children_end());
 }
+
+TEST_CASE ("decode/container/siblings", "Sibling containers with different flags")
+{
+    static const uint8_t data[] = {
+        // armored container with an unknown hash function
+        (uint8_t)(RT_CONTAINER) | 0x80, uint8_t(0x01) | 0x80,
+        uint8_t(CF_ARMORED | CF_HASHED) | 0x80,
+        uint8_t(HT_INVALID) | 0x80,
+        (uint8_t)(RT_CONTAINER) | 0x80, uint8_t(0x02) | 0x80,
+        uint8_t(CF_WITH_SIZE) | 0x80, uint8_t(0x00) | 0x80,
+        (uint8_t)(RT_END_OF_CHILDREN) | 0x80,
+        uint8_t(0x01) | 0x80, 0x00,
+
+        // plain sibling, which reuses the state of the first one
+        (uint8_t)(RT_CONTAINER) | 0x80, uint8_t(0x03) | 0x80,
+        uint8_t(CF_WITH_SIZE) | 0x80, uint8_t(0x01) | 0x80,
+        (uint8_t)(RT_CONTAINER) | 0x80, uint8_t(0x04) | 0x80,
+        uint8_t(CF_WITH_SIZE) | 0x80, uint8_t(0x00) | 0x80,
+
+        (uint8_t)(RT_END_OF_CHILDREN) | 0x80
+    };
+
+    ContainerHandle root = blob_to_tree(data, sizeof(data),
+                                        FromBitstream::UnknownHashFunction);
+    REQUIRE(root->child_count() == 2);
+
+    NodeVector::iterator children = root->children_begin();
+    Container *cont1 = dynamic_cast<Container*>((*children).get());
+    REQUIRE(cont1 != 0);
+    CHECK(cont1->id() == 0x01U);
+    CHECK(cont1->child_count() == 1);
+
+    children += 1;
+    Container *cont2 = dynamic_cast<Container*>((*children).get());
+    REQUIRE(cont2 != 0);
+    CHECK(cont2->id() == 0x03U);
+    CHECK(cont2->child_count() == 1);
+    CHECK(cont2->get_hashed() == HT_NONE);
+}
+
+TEST_CASE ("decode/container/skip", "Skip containers which carry their body length")
+{
+    static const uint8_t data[] = {
+        (uint8_t)(RT_CONTAINER) | 0x80, uint8_t(0x01) | 0x80,
+        uint8_t(CF_ARMORED | CF_WITH_LENGTH) | 0x80,
+        uint8_t(0x09) | 0x80, // body length
+        (uint8_t)(RT_UINT32) | 0x80, uint8_t(0x02) | 0x80, 0x11, 0x11, 0x11, 0x11,
+        (uint8_t)(RT_BOOL_TRUE) | 0x80, uint8_t(0x03) | 0x80,
+        (uint8_t)(RT_END_OF_CHILDREN) | 0x80,
+
+        (uint8_t)(RT_UINT32) | 0x80, uint8_t(0x04) | 0x80, 0x22, 0x22, 0x22, 0x22,
+        (uint8_t)(RT_END_OF_CHILDREN) | 0x80
+    };
+
+    ContainerHandle root = blob_to_tree(data, sizeof(data));
+    REQUIRE(root->child_count() == 2);
+    Container *cont = dynamic_cast<Container*>((*root->children_begin()).get());
+    REQUIRE(cont != 0);
+    CHECK(cont->child_count() == 2);
+
+    ToTree *sink = new ToTree();
+    FromBitstream reader(IOIntfHandle(new MemoryView(data, sizeof(data))),
+                         Registry::defaults(), StreamSink(sink));
+    reader.set_skip(RT_CONTAINER, 0x01);
+    reader.read_all();
+
+    root = sink->root();
+    REQUIRE(root->child_count() == 1);
+    UInt32Record *rec = dynamic_cast<UInt32Record*>((*root->children_begin()).get());
+    REQUIRE(rec != 0);
+    CHECK(rec->id() == 0x04U);
+    CHECK(rec->get() == 0x22222222);
+}
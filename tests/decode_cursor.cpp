@@ -0,0 +1,410 @@
+/**********************************************************************
+File name: decode_cursor.cpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#include "catch.hpp"
+
+#include <cstring>
+
+#include "tests/utils.hpp"
+
+#include "structstream/nodes.hpp"
+#include "structstream/hashing.hpp"
+
+using namespace StructStream;
+
+static BitstreamCursor *cursor_on(const uint8_t *data, intptr_t data_len)
+{
+    return new BitstreamCursor(IOIntfHandle(new MemoryView(data, data_len)));
+}
+
+TEST_CASE ("decode/cursor/complex", "Walk a nested structure with the cursor")
+{
+    static const uint8_t data[] = {
+        (uint8_t)(RT_CONTAINER) | 0x80, uint8_t(0x01) | 0x80,
+        uint8_t(CF_ARMORED) | 0x80,
+        (uint8_t)(RT_UINT32) | 0x80, uint8_t(0x02) | 0x80, 0x11, 0x11, 0x11, 0x11,
+        (uint8_t)(RT_CONTAINER) | 0x80, uint8_t(0x01) | 0x80,
+        uint8_t(CF_WITH_SIZE) | 0x80, uint8_t(0x01) | 0x80,
+        (uint8_t)(RT_UINT32) | 0x80, uint8_t(0x03) | 0x80, 0x22, 0x22, 0x22, 0x22,
+        (uint8_t)(RT_UINT32) | 0x80, uint8_t(0x04) | 0x80, 0x33, 0x33, 0x33, 0x33,
+        (uint8_t)(RT_END_OF_CHILDREN) | 0x80,
+        (uint8_t)(RT_END_OF_CHILDREN) | 0x80
+    };
+
+    std::unique_ptr<BitstreamCursor> cursor(cursor_on(data, sizeof(data)));
+    CursorEvent ev;
+
+    REQUIRE(cursor->next(ev));
+    CHECK(ev.kind == CE_START_CONTAINER);
+    CHECK(ev.id == 0x01U);
+    CHECK(ev.depth == 0);
+    CHECK(ev.child_count == -1);
+
+    REQUIRE(cursor->next(ev));
+    CHECK(ev.kind == CE_VALUE);
+    CHECK(ev.rt == RT_UINT32);
+    CHECK(ev.id == 0x02U);
+    CHECK(ev.depth == 1);
+    CHECK(ev.value.u32 == 0x11111111U);
+
+    REQUIRE(cursor->next(ev));
+    CHECK(ev.kind == CE_START_CONTAINER);
+    CHECK(ev.depth == 1);
+    CHECK(ev.child_count == 1);
+    CHECK(cursor->depth() == 2);
+
+    REQUIRE(cursor->next(ev));
+    CHECK(ev.id == 0x03U);
+    CHECK(ev.depth == 2);
+    CHECK(ev.value.u32 == 0x22222222U);
+
+    REQUIRE(cursor->next(ev));
+    CHECK(ev.kind == CE_END_CONTAINER);
+    CHECK(ev.depth == 1);
+    CHECK(ev.hash_function == HT_NONE);
+
+    REQUIRE(cursor->next(ev));
+    CHECK(ev.id == 0x04U);
+    CHECK(ev.value.u32 == 0x33333333U);
+
+    REQUIRE(cursor->next(ev));
+    CHECK(ev.kind == CE_END_CONTAINER);
+    CHECK(ev.id == 0x01U);
+    CHECK(ev.depth == 0);
+    CHECK(ev.child_count == 3);
+
+    CHECK_FALSE(cursor->next(ev));
+    CHECK_FALSE(cursor->next(ev));
+}
+
+TEST_CASE ("decode/cursor/values", "Typed values and spans from an encoded tree")
+{
+    ContainerHandle inner = NodeHandleFactory<Container>::create(0x10);
+    std::shared_ptr<UTF8Record> str = NodeHandleFactory<UTF8Record>::create(0x11);
+    str->set(std::string("foobar"));
+    inner->child_add(str);
+
+    std::shared_ptr<Float64Record> dbl = NodeHandleFactory<Float64Record>::create(0x20);
+    dbl->set(2.5);
+    std::shared_ptr<VarIntRecord> vi = NodeHandleFactory<VarIntRecord>::create(0x21);
+    vi->set(-123456789);
+    std::shared_ptr<BoolRecord> flag = NodeHandleFactory<BoolRecord>::create(0x22);
+    flag->set(true);
+    std::shared_ptr<BlobRecord> blob = NodeHandleFactory<BlobRecord>::create(0x23);
+    std::vector<char> blob_data(300);
+    for (unsigned int i = 0; i < blob_data.size(); i++) {
+        blob_data[i] = (char)i;
+    }
+    blob->set(blob_data.data(), blob_data.size());
+
+    uint8_t output[1024];
+    intptr_t size = tree_to_blob(output, sizeof(output),
+                                 {inner, dbl, vi, flag, blob}, false);
+
+    // a small block size forces copies of the blob payload
+    for (intptr_t block_size: {(intptr_t)0, (intptr_t)64}) {
+        std::shared_ptr<BitstreamCursor> cursor;
+        if (block_size == 0) {
+            cursor.reset(cursor_on(output, size));
+        } else {
+            cursor.reset(new BitstreamCursor(
+                IOIntfHandle(new BufferedReader(
+                    IOIntfHandle(new MemoryView(output, size)),
+                    block_size)),
+                0));
+        }
+        CursorEvent ev;
+
+        REQUIRE(cursor->next(ev));
+        CHECK(ev.kind == CE_START_CONTAINER);
+        cursor->skip_container();
+
+        REQUIRE(cursor->next(ev));
+        CHECK(ev.rt == RT_FLOAT64);
+        CHECK(ev.value.f64 == 2.5);
+
+        REQUIRE(cursor->next(ev));
+        CHECK(ev.rt == RT_VARINT);
+        CHECK(ev.value.i64 == -123456789);
+
+        REQUIRE(cursor->next(ev));
+        CHECK(ev.rt == RT_BOOL_TRUE);
+        CHECK(ev.value.b);
+
+        REQUIRE(cursor->next(ev));
+        CHECK(ev.kind == CE_BLOB);
+        CHECK(ev.id == 0x23U);
+        REQUIRE(ev.len == (intptr_t)blob_data.size());
+        CHECK(memcmp(ev.data, blob_data.data(), ev.len) == 0);
+
+        CHECK_FALSE(cursor->next(ev));
+    }
+
+    std::unique_ptr<BitstreamCursor> cursor(cursor_on(output, size));
+    CursorEvent ev;
+    REQUIRE(cursor->next(ev));
+    REQUIRE(cursor->next(ev));
+    CHECK(ev.kind == CE_BLOB);
+    CHECK(ev.rt == RT_UTF8STRING);
+    CHECK(std::string((const char*)ev.data, ev.len) == "foobar");
+}
+
+TEST_CASE ("decode/cursor/forgiving", "Forgiveness flags apply to the cursor")
+{
+    static const uint8_t data[] = {
+        (uint8_t)(RT_CONTAINER) | 0x80, uint8_t(0x01) | 0x80,
+        uint8_t(CF_WITH_SIZE | CF_ARMORED | CF_APP0) | 0x80,
+        uint8_t(0x02) | 0x80, // length
+        uint8_t(RT_APPBLOB_MIN) | 0x80, uint8_t(0x02) | 0x80, uint8_t(0x04) | 0x80, 0x01, 0x02, 0x03, 0x04,
+        uint8_t(RT_END_OF_CHILDREN) | 0x80,
+        uint8_t(RT_END_OF_CHILDREN) | 0x80
+    };
+
+    CursorEvent ev;
+
+    std::unique_ptr<BitstreamCursor> cursor(cursor_on(data, sizeof(data)));
+    CHECK_THROWS_AS(cursor->next(ev), UnsupportedContainerFlags);
+
+    cursor.reset(cursor_on(data, sizeof(data)));
+    cursor->set_forgiving_for(FromBitstream::UnknownContainerFlags);
+    REQUIRE(cursor->next(ev));
+    REQUIRE(cursor->next(ev));
+    CHECK(ev.kind == CE_BLOB);
+    CHECK(ev.rt == RT_APPBLOB_MIN);
+    CHECK(ev.len == 4);
+    CHECK_THROWS_AS(cursor->next(ev), UnexpectedEndOfChildren);
+
+    cursor.reset(cursor_on(data, sizeof(data)));
+    cursor->set_forgiving_for(FromBitstream::UnknownContainerFlags
+                              | FromBitstream::UnknownAppblobs
+                              | FromBitstream::PrematureEndOfContainer);
+    REQUIRE(cursor->next(ev));
+    REQUIRE(cursor->next(ev));
+    CHECK(ev.kind == CE_END_CONTAINER);
+    CHECK(ev.child_count == 1);
+    CHECK_FALSE(cursor->next(ev));
+}
+
+#ifdef WITH_GNUTLS
+TEST_CASE ("decode/cursor/hashed", "The cursor verifies container hashes")
+{
+    load_all_hashes();
+
+    ContainerHandle cont = NodeHandleFactory<Container>::create(0x01);
+    std::shared_ptr<UInt32Record> rec = NodeHandleFactory<UInt32Record>::create(0x02);
+    rec->set(0xdeadbeef);
+    cont->child_add(rec);
+
+    uint8_t output[128];
+    IOIntfHandle io(new WritableMemory(output, sizeof(output)));
+    ToBitstreamHashing *writer = new ToBitstreamHashing(io);
+    writer->set_hash_function(RT_CONTAINER, 0x01, HT_SHA1);
+    FromTree(StreamSink(writer), {cont});
+    const intptr_t size = static_cast<WritableMemory*>(io.get())->size();
+
+    CursorEvent ev;
+    std::unique_ptr<BitstreamCursor> cursor(cursor_on(output, size));
+    REQUIRE(cursor->next(ev));
+    REQUIRE(cursor->next(ev));
+    CHECK(ev.value.u32 == 0xdeadbeef);
+    REQUIRE(cursor->next(ev));
+    CHECK(ev.kind == CE_END_CONTAINER);
+    CHECK(ev.hash_function == HT_SHA1);
+    CHECK(ev.validated);
+    CHECK_FALSE(cursor->next(ev));
+
+    // corrupt the payload, which is followed by the hash, its
+    // length and the end of the stream
+    output[size - 1 - 21 - 4] ^= 0xff;
+    cursor.reset(cursor_on(output, size));
+    REQUIRE(cursor->next(ev));
+    REQUIRE(cursor->next(ev));
+    CHECK(ev.value.u32 != 0xdeadbeef);
+    CHECK_THROWS_AS(cursor->next(ev), HashCheckError);
+
+    cursor.reset(cursor_on(output, size));
+    cursor->set_forgiving_for(FromBitstream::ChecksumErrors);
+    REQUIRE(cursor->next(ev));
+    cursor->skip_container();
+    CHECK_FALSE(cursor->next(ev));
+}
+#endif
+
+TEST_CASE ("decode/cursor/skip_length", "Skip containers with body length in one go")
+{
+    ContainerHandle outer = NodeHandleFactory<Container>::create(0x01);
+    ContainerHandle inner = NodeHandleFactory<Container>::create(0x02);
+    for (int i = 0; i < 100; i++) {
+        std::shared_ptr<UInt64Record> rec = NodeHandleFactory<UInt64Record>::create(0x03);
+        rec->set(i);
+        inner->child_add(rec);
+    }
+    outer->child_add(inner);
+    std::shared_ptr<UInt32Record> rec = NodeHandleFactory<UInt32Record>::create(0x04);
+    rec->set(0xcafe);
+    outer->child_add(rec);
+
+    uint8_t output[2048];
+    IOIntfHandle io(new WritableMemory(output, sizeof(output)));
+    ToBitstreamHashing *writer = new ToBitstreamHashing(io);
+    writer->set_length_default(true);
+#ifdef WITH_GNUTLS
+    load_all_hashes();
+    writer->set_hash_function(RT_CONTAINER, 0x01, HT_SHA1);
+    writer->set_hash_function(RT_CONTAINER, 0x02, HT_SHA256);
+#endif
+    FromTree(StreamSink(writer), {outer});
+    const intptr_t size = static_cast<WritableMemory*>(io.get())->size();
+
+    CursorEvent ev;
+    std::unique_ptr<BitstreamCursor> cursor(cursor_on(output, size));
+    REQUIRE(cursor->next(ev));
+    CHECK(ev.kind == CE_START_CONTAINER);
+    CHECK(ev.len > 1000);
+    REQUIRE(cursor->next(ev));
+    CHECK(ev.kind == CE_START_CONTAINER);
+    CHECK(ev.id == 0x02U);
+    CHECK(ev.len >= 100*10);
+    cursor->skip_container();
+    CHECK(cursor->depth() == 1);
+
+    REQUIRE(cursor->next(ev));
+    CHECK(ev.id == 0x04U);
+    CHECK(ev.value.u32 == 0xcafe);
+    REQUIRE(cursor->next(ev));
+    CHECK(ev.kind == CE_END_CONTAINER);
+#ifdef WITH_GNUTLS
+    CHECK(ev.validated);
+#endif
+    CHECK_FALSE(cursor->next(ev));
+
+    // the full tree decodes and verifies as well
+    ContainerHandle root = blob_to_tree(output, size);
+    REQUIRE(root->child_count() == 1);
+    Container *cont = dynamic_cast<Container*>((*root->children_begin()).get());
+    REQUIRE(cont != 0);
+    CHECK(cont->child_count() == 2);
+#ifdef WITH_GNUTLS
+    CHECK(cont->get_hashed() == HT_SHA1);
+#endif
+}
+
+TEST_CASE ("decode/cursor/registry", "Create nodes with the registry of the cursor")
+{
+    static const uint8_t data[] = {
+        (uint8_t)(RT_UINT32) | 0x80, uint8_t(0x01) | 0x80, 0x2a, 0x00, 0x00, 0x00,
+        (uint8_t)(RT_UINT32) | 0x80, uint8_t(0x02) | 0x80, 0x2a, 0x00, 0x00, 0x00,
+        (uint8_t)(RT_END_OF_CHILDREN) | 0x80
+    };
+
+    typedef EnumRecordTpl<HashType, RT_UINT32, UInt32Record> EnumRecord;
+
+    RegistryHandle registry(new Registry(*Registry::defaults()));
+    registry->register_record_type(RT_UINT32, [](ID id) {
+        return NodeHandleFactory<EnumRecord>::create(id);
+    });
+
+    BitstreamCursor cursor(IOIntfHandle(new MemoryView(data, sizeof(data))),
+                           registry);
+    CursorEvent ev;
+    REQUIRE(cursor.next(ev));
+    NodeHandle node = cursor.read_node(ev);
+    REQUIRE(node.get() != 0);
+    REQUIRE(node_cast<EnumRecord>(node).get() != 0);
+    CHECK(node_cast<EnumRecord>(node)->get() == (HashType)42);
+
+    // the defaults apply otherwise
+    BitstreamCursor plain(IOIntfHandle(new MemoryView(data, sizeof(data))));
+    REQUIRE(plain.next(ev));
+    CHECK(plain.read_node(ev)->record_type() == RT_UINT32);
+}
+
+// an appblob class, which reads its size by itself
+class AppBlobRecord: public BlobRecord {
+protected:
+    explicit AppBlobRecord(ID id):
+        BlobRecord(id)
+    {
+
+    };
+public:
+    virtual NodeHandle copy() const {
+        return NodeHandleFactory<AppBlobRecord>::copy(*this);
+    };
+
+    virtual RecordType record_type() const {
+        return RT_APPBLOB_MIN;
+    };
+
+    virtual void read(IOIntf *stream) {
+        const VarUInt length = Utils::read_varuint(stream);
+        std::vector<char> payload(length);
+        sread(stream, payload.data(), length);
+        set(payload.data(), length);
+    };
+
+    friend struct NodeHandleFactory<AppBlobRecord>;
+};
+
+TEST_CASE ("decode/cursor/read_node_class", "Only create nodes whose class fits the record")
+{
+    static const uint8_t data[] = {
+        (uint8_t)(RT_UINT32) | 0x80, uint8_t(0x01) | 0x80, 0x2a, 0x00, 0x00, 0x00,
+        uint8_t(RT_APPBLOB_MIN) | 0x80, uint8_t(0x02) | 0x80, uint8_t(0x03) | 0x80, 0x01, 0x02, 0x03,
+        (uint8_t)(RT_END_OF_CHILDREN) | 0x80
+    };
+
+    RegistryHandle registry(new Registry(*Registry::defaults()));
+    registry->register_record_type(RT_UINT32, [](ID id) {
+        return NodeHandleFactory<Int32Record>::create(id);
+    });
+    registry->register_record_type(RT_APPBLOB_MIN, [](ID id) {
+        return NodeHandleFactory<AppBlobRecord>::create(id);
+    });
+
+    BitstreamCursor cursor(IOIntfHandle(new MemoryView(data, sizeof(data))),
+                           registry);
+    CursorEvent ev;
+    REQUIRE(cursor.next(ev));
+    CHECK_THROWS_AS(cursor.read_node(ev), UnsupportedRecordType);
+
+    // appblob nodes decode their record themselves
+    REQUIRE(cursor.next(ev));
+    NodeHandle node = cursor.read_node(ev);
+    std::shared_ptr<AppBlobRecord> blob = node_cast<AppBlobRecord>(node);
+    REQUIRE(blob.get() != 0);
+    REQUIRE(blob->datalen() == 3);
+    CHECK(memcmp(blob->dataptr(), &data[9], 3) == 0);
+
+    // a fixed-size class does not read past the short payload
+    registry->register_record_type(RT_APPBLOB_MIN, [](ID id) {
+        return NodeHandleFactory<UInt64Record>::create(id);
+    });
+    BitstreamCursor fixed(IOIntfHandle(new MemoryView(data, sizeof(data))),
+                          registry);
+    REQUIRE(fixed.next(ev));
+    REQUIRE(fixed.next(ev));
+    CHECK_THROWS_AS(fixed.read_node(ev), EndOfStreamError);
+}
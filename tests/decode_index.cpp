@@ -0,0 +1,131 @@
+/**********************************************************************
+File name: decode_index.cpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#include "catch.hpp"
+
+#include <cstring>
+
+#include "tests/utils.hpp"
+
+#include "structstream/nodes.hpp"
+
+using namespace StructStream;
+
+static std::vector<uint8_t> indexed_stream(bool with_length)
+{
+    WritableMemory *mem = new WritableMemory();
+    IOIntfHandle io(mem);
+    ToBitstream *writer = new ToBitstream(io);
+    writer->enable_index();
+    writer->set_length_default(with_length);
+    StreamSink sink(writer);
+
+    for (int i = 0; i < 20; i++) {
+        if (i % 5 == 4) {
+            std::shared_ptr<UInt32Record> rec = NodeHandleFactory<UInt32Record>::create(0x100 + i);
+            rec->set(i);
+            sink->push_node(rec);
+            continue;
+        }
+
+        ContainerHandle cont = NodeHandleFactory<Container>::create(0x100 + i);
+        for (int j = 0; j <= i; j++) {
+            std::shared_ptr<UInt32Record> rec = NodeHandleFactory<UInt32Record>::create(j);
+            rec->set(i*1000 + j);
+            cont->child_add(rec);
+        }
+        FromTree(sink, {cont}, false);
+    }
+    // duplicate ID: find() returns the first one
+    sink->push_node(NodeHandleFactory<BoolRecord>::create(0x100));
+    sink->end_of_stream();
+
+    return std::vector<uint8_t>(mem->buffer(), mem->buffer() + mem->size());
+}
+
+TEST_CASE ("decode/index/random_access", "Jump to top-level nodes using the stream index")
+{
+    for (bool with_length: {false, true}) {
+        std::vector<uint8_t> data = indexed_stream(with_length);
+
+        // readers which do not know about the index see an extra blob
+        ContainerHandle root = blob_to_tree(data.data(), data.size());
+        REQUIRE(root->child_count() == 22);
+        NodeHandle last = *(root->children_begin() + 21);
+        CHECK(last->id() == IndexTrailerID);
+        CHECK(last->record_type() == RT_BLOB);
+
+        StreamIndex index(IOIntfHandle(new MemoryView(data.data(), data.size())));
+        REQUIRE(index.size() == 21);
+        CHECK(index[0].offset == 0);
+        CHECK(index[20].id == 0x100U);
+
+        CHECK(index.find(0x100) == 0);
+        CHECK(index.find(0x10d) == 13);
+        CHECK(index.find(0x200) == -1);
+
+        std::shared_ptr<Container> cont = node_cast<Container>(index.read_node(13));
+        REQUIRE(cont.get() != 0);
+        CHECK(cont->id() == 0x10dU);
+        REQUIRE(cont->child_count() == 14);
+        UInt32Record *rec = node_cast<UInt32Record>((*(cont->children_begin() + 3)).get());
+        REQUIRE(rec != 0);
+        CHECK(rec->get() == 13003U);
+
+        std::shared_ptr<UInt32Record> single = node_cast<UInt32Record>(index.read_node(9));
+        REQUIRE(single.get() != 0);
+        CHECK(single->get() == 9U);
+
+        CHECK(index.read_node(20)->record_type() == RT_BOOL_FALSE);
+    }
+}
+
+TEST_CASE ("decode/index/missing", "Streams without index are rejected")
+{
+    uint8_t output[64];
+    intptr_t size = tree_to_blob(output, sizeof(output),
+                                 {NodeHandleFactory<UInt32Record>::create(0x01)});
+
+    CHECK_THROWS_AS(StreamIndex(IOIntfHandle(new MemoryView(output, size))),
+                    IllegalData);
+}
+
+TEST_CASE ("decode/index/app_blob", "Blobs which only share the ID are no index")
+{
+    // ends with the magic, but the footer does not describe the blob
+    std::string payload(16, '\0');
+    payload += "SSINDEX1";
+    std::shared_ptr<BlobRecord> blob = NodeHandleFactory<BlobRecord>::create(IndexTrailerID);
+    blob->set(payload);
+
+    uint8_t output[64];
+    intptr_t size = tree_to_blob(output, sizeof(output),
+                                 {NodeHandleFactory<UInt32Record>::create(0x01), blob},
+                                 false);
+    REQUIRE(size > 0);
+
+    CHECK_THROWS_AS(StreamIndex(IOIntfHandle(new MemoryView(output, size))),
+                    IllegalData);
+}
@@ -66,3 +66,122 @@ TEST_CASE ("decode/regression/eoc_node_in_root", "Test decode of several nodes i
     CHECK(cont->children_begin() == cont->children_end());
 }
 
+
+TEST_CASE ("decode/registry/dispatch", "Flat and hashed registry lookups")
+{
+    ConstRegistryHandle defaults = Registry::defaults();
+    CHECK(defaults == Registry::defaults());
+
+    NodeHandle node = defaults->node_from_record_type(RT_UINT32, 0x01);
+    REQUIRE(node.get() != 0);
+    CHECK(node->record_type() == RT_UINT32);
+    CHECK(node->id() == 0x01U);
+    CHECK(defaults->node_from_record_type(RT_BOOL_TRUE, 0x01)->record_type() == RT_BOOL_TRUE);
+    CHECK(defaults->node_from_record_type(RT_APP_NOSIZE_MIN, 0x01).get() == 0);
+
+    Registry registry(*defaults);
+    int calls = 0;
+    registry.register_record_type(RT_UINT32, [&calls](ID id) {
+        calls += 1;
+        return NodeHandleFactory<Int32Record>::create(id);
+    });
+    registry.register_record_class<UInt64Record>(0x1000);
+
+    CHECK(registry.node_from_record_type(RT_UINT32, 0x01)->record_type() == RT_INT32);
+    CHECK(calls == 1);
+    CHECK(registry.node_from_record_type(0x1000, 0x01)->record_type() == RT_UINT64);
+    CHECK(registry.node_from_record_type(0x1001, 0x01).get() == 0);
+
+    // the shared defaults are not affected
+    CHECK(defaults->node_from_record_type(RT_UINT32, 0x01)->record_type() == RT_UINT32);
+
+    registry.register_record_class<UInt32Record>(RT_UINT32);
+    CHECK(registry.node_from_record_type(RT_UINT32, 0x01)->record_type() == RT_UINT32);
+    CHECK(calls == 1);
+}
+
+class RecordingTree: public SinkTree
+{
+public:
+    RecordingTree(const std::string &name, std::vector<std::string> &log):
+        _name(name),
+        _log(log)
+    {
+
+    }
+
+private:
+    std::string _name;
+    std::vector<std::string> &_log;
+
+protected:
+    bool _start_container(ContainerHandle cont, const ContainerMeta *meta) override
+    {
+        _log.push_back(_name + ":start:" + std::to_string(cont->id()));
+        if (cont->id() == 1) {
+            nest(StreamSink(new RecordingTree(
+                _name + "/" + std::to_string(cont->id()), _log)));
+        } else if (cont->id() == 2) {
+            nest(StreamSink(new NullSink()));
+        }
+        return true;
+    }
+
+    bool _push_node(NodeHandle node) override
+    {
+        _log.push_back(_name + ":node:" + std::to_string(node->id()));
+        return true;
+    }
+
+    bool _end_container(const ContainerFooter *foot) override
+    {
+        _log.push_back(_name + ":end");
+        return true;
+    }
+
+    void _end_of_stream() override
+    {
+        _log.push_back(_name + ":eos");
+    }
+};
+
+TEST_CASE ("decode/sink_tree/nesting", "Dispatch of events to nested sinks")
+{
+    ContainerHandle outer = NodeHandleFactory<Container>::create(1);
+    ContainerHandle inner = NodeHandleFactory<Container>::create(1);
+    ContainerHandle ignored = NodeHandleFactory<Container>::create(2);
+    ContainerHandle plain = NodeHandleFactory<Container>::create(3);
+
+    outer->child_add(NodeHandleFactory<UInt32Record>::create(5));
+    outer->child_add(inner);
+    inner->child_add(NodeHandleFactory<UInt32Record>::create(6));
+    inner->child_add(ignored);
+    ignored->child_add(NodeHandleFactory<UInt32Record>::create(7));
+    inner->child_add(NodeHandleFactory<UInt32Record>::create(8));
+    inner->child_add(plain);
+    plain->child_add(NodeHandleFactory<UInt32Record>::create(9));
+    outer->child_add(NodeHandleFactory<UInt32Record>::create(10));
+
+    std::vector<std::string> log;
+    FromTree(StreamSink(new RecordingTree("r", log)),
+             {outer, NodeHandleFactory<UInt32Record>::create(11)});
+
+    const std::vector<std::string> expected({
+        "r:start:1",
+        "r/1:node:5",
+        "r/1:start:1",
+        "r/1/1:node:6",
+        "r/1/1:start:2",
+        "r/1/1:end",
+        "r/1/1:node:8",
+        "r/1/1:start:3",
+        "r/1/1:node:9",
+        "r/1/1:end",
+        "r/1:end",
+        "r/1:node:10",
+        "r:end",
+        "r:node:11",
+        "r:eos"
+    });
+    CHECK(log == expected);
+}
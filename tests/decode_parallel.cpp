@@ -0,0 +1,187 @@
+/**********************************************************************
+File name: decode_parallel.cpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#include "catch.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "tests/utils.hpp"
+
+#include "structstream/nodes.hpp"
+#include "structstream/streaming_parallel.hpp"
+
+using namespace StructStream;
+
+static std::vector<uint8_t> flat_stream(bool with_index, bool with_length)
+{
+    WritableMemory *mem = new WritableMemory();
+    IOIntfHandle io(mem);
+    ToBitstream *writer = new ToBitstream(io);
+    if (with_index) {
+        writer->enable_index();
+    }
+    writer->set_length_default(with_length);
+    StreamSink sink(writer);
+
+    for (int i = 0; i < 100; i++) {
+        if (i % 3 == 2) {
+            std::shared_ptr<UInt32Record> rec = NodeHandleFactory<UInt32Record>::create(i);
+            rec->set(i);
+            sink->push_node(rec);
+            continue;
+        }
+
+        ContainerHandle cont = NodeHandleFactory<Container>::create(i);
+        for (int j = 0; j < i % 7; j++) {
+            std::shared_ptr<UInt32Record> rec = NodeHandleFactory<UInt32Record>::create(j);
+            rec->set(i*1000 + j);
+            cont->child_add(rec);
+        }
+        FromTree(sink, {cont}, false);
+    }
+    sink->end_of_stream();
+
+    return std::vector<uint8_t>(mem->buffer(), mem->buffer() + mem->size());
+}
+
+static StreamSink make_tree(const ParallelChunk&)
+{
+    return StreamSink(new ToTree());
+}
+
+static void check_chunk(const ParallelChunk &chunk, StreamSink sink,
+                        std::vector<ID> &ids)
+{
+    ContainerHandle root = static_cast<ToTree*>(sink.get())->root();
+    REQUIRE(root->child_count() == (intptr_t)chunk.node_count);
+    for (auto it = root->children_begin(); it != root->children_end(); it++) {
+        ids.push_back((*it)->id());
+        if ((*it)->is_container()) {
+            CHECK(node_cast<Container>(*it)->child_count() == (intptr_t)((*it)->id() % 7));
+        }
+    }
+}
+
+TEST_CASE ("decode/parallel/ordered", "Decode top-level nodes on several threads, in order")
+{
+    for (bool with_index: {false, true}) {
+        for (bool with_length: {false, true}) {
+            std::vector<uint8_t> data = flat_stream(with_index, with_length);
+            IOIntfHandle source(new MemoryView(data.data(), data.size()));
+
+            std::unique_ptr<StreamIndex> index;
+            std::unique_ptr<ParallelReader> reader;
+            if (with_index) {
+                index.reset(new StreamIndex(source));
+                reader.reset(new ParallelReader(*index));
+            } else {
+                reader.reset(new ParallelReader(source));
+            }
+            REQUIRE(reader->node_count() == 100);
+
+            std::vector<ID> ids;
+            size_t next_index = 0;
+            reader->read_all(
+                4, make_tree,
+                [&](const ParallelChunk &chunk, StreamSink sink) {
+                    CHECK(chunk.index == next_index++);
+                    check_chunk(chunk, sink, ids);
+                },
+                true, 3);
+
+            CHECK(next_index == 34);
+            REQUIRE(ids.size() == 100);
+            for (ID i = 0; i < 100; i++) {
+                CHECK(ids[i] == i);
+            }
+        }
+    }
+}
+
+TEST_CASE ("decode/parallel/unordered", "Decode top-level nodes on several threads, as they come")
+{
+    std::vector<uint8_t> data = flat_stream(false, false);
+    ParallelReader reader(IOIntfHandle(new MemoryView(data.data(), data.size())));
+
+    std::vector<ID> ids;
+    std::vector<bool> seen;
+    reader.read_all(
+        3, make_tree,
+        [&](const ParallelChunk &chunk, StreamSink sink) {
+            if (seen.size() <= chunk.index) {
+                seen.resize(chunk.index + 1);
+            }
+            CHECK_FALSE(seen[chunk.index]);
+            seen[chunk.index] = true;
+            check_chunk(chunk, sink, ids);
+        },
+        false);
+
+    REQUIRE(ids.size() == 100);
+    std::sort(ids.begin(), ids.end());
+    for (ID i = 0; i < 100; i++) {
+        CHECK(ids[i] == i);
+    }
+}
+
+TEST_CASE ("decode/parallel/errors", "Errors on worker threads reach the caller")
+{
+    std::vector<uint8_t> data = flat_stream(false, true);
+    ParallelReader reader(IOIntfHandle(new MemoryView(data.data(), data.size())));
+
+    size_t delivered = 0;
+    CHECK_THROWS_AS(
+        reader.read_all(
+            2,
+            [](const ParallelChunk &chunk) -> StreamSink {
+                if (chunk.index == 5) {
+                    throw std::runtime_error("sink failure");
+                }
+                return StreamSink(new ToTree());
+            },
+            [&](const ParallelChunk&, StreamSink) {
+                delivered++;
+            },
+            true, 1),
+        std::runtime_error);
+    CHECK(delivered <= 5);
+}
+
+TEST_CASE ("decode/parallel/app_blob", "Keep application blobs with the index ID")
+{
+    WritableMemory *mem = new WritableMemory();
+    IOIntfHandle io(mem);
+    StreamSink sink(new ToBitstream(io));
+    for (int i = 0; i < 3; i++) {
+        std::shared_ptr<BlobRecord> blob = NodeHandleFactory<BlobRecord>::create(IndexTrailerID);
+        blob->set(std::string(32, 'a' + i));
+        sink->push_node(blob);
+    }
+    sink->end_of_stream();
+
+    ParallelReader reader(IOIntfHandle(new MemoryView(mem->buffer(), mem->size())));
+    CHECK(reader.node_count() == 3);
+}
@@ -0,0 +1,223 @@
+/**********************************************************************
+File name: decode_push.cpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#include "catch.hpp"
+
+#include <cstring>
+
+#include "tests/utils.hpp"
+
+#include "structstream/nodes.hpp"
+#include "structstream/hashing.hpp"
+#include "structstream/streaming_push.hpp"
+
+using namespace StructStream;
+
+static std::vector<uint8_t> sample_stream(bool armor, bool with_length)
+{
+    ContainerHandle outer = NodeHandleFactory<Container>::create(0x01);
+    std::shared_ptr<UInt32Record> num = NodeHandleFactory<UInt32Record>::create(0x02);
+    num->set(0xdeadbeef);
+    outer->child_add(num);
+
+    std::shared_ptr<UTF8Record> str = NodeHandleFactory<UTF8Record>::create(0x03);
+    str->set(std::string(300, 'x'));
+    outer->child_add(str);
+
+    std::shared_ptr<BlobRecord> blob = NodeHandleFactory<BlobRecord>::create(0x04);
+    std::vector<uint8_t> payload(1000);
+    for (size_t i = 0; i < payload.size(); i++) {
+        payload[i] = i * 7;
+    }
+    blob->set((const char*)payload.data(), payload.size());
+    outer->child_add(blob);
+
+    ContainerHandle inner = NodeHandleFactory<Container>::create(0x05);
+    std::shared_ptr<VarIntRecord> varint = NodeHandleFactory<VarIntRecord>::create(0x06);
+    varint->set(-123456789);
+    inner->child_add(varint);
+    std::shared_ptr<Float64Record> dbl = NodeHandleFactory<Float64Record>::create(0x07);
+    dbl->set(2.5);
+    inner->child_add(dbl);
+    inner->child_add(NodeHandleFactory<Container>::create(0x08));
+    outer->child_add(inner);
+
+    std::shared_ptr<UInt64Record> last = NodeHandleFactory<UInt64Record>::create(0x09);
+    last->set(42);
+
+    WritableMemory *mem = new WritableMemory();
+    IOIntfHandle io(mem);
+    ToBitstreamHashing *writer = new ToBitstreamHashing(io);
+    writer->set_armor_default(armor);
+    writer->set_length_default(with_length);
+#ifdef WITH_GNUTLS
+    load_all_hashes();
+    writer->set_hash_function(RT_CONTAINER, 0x01, HT_SHA1);
+    writer->set_hash_function(RT_CONTAINER, 0x05, HT_SHA256);
+#endif
+    FromTree(StreamSink(writer), {outer, last});
+
+    return std::vector<uint8_t>(mem->buffer(), mem->buffer() + mem->size());
+}
+
+static std::vector<uint8_t> tree_bytes(ContainerHandle root)
+{
+    WritableMemory *mem = new WritableMemory();
+    IOIntfHandle io(mem);
+    tree_to_bitstream(root, io);
+    return std::vector<uint8_t>(mem->buffer(), mem->buffer() + mem->size());
+}
+
+TEST_CASE ("decode/push/pieces", "Feed a stream in pieces of various sizes")
+{
+    for (bool armor: {false, true}) {
+        for (bool with_length: {false, true}) {
+            std::vector<uint8_t> data = sample_stream(armor, with_length);
+            const std::vector<uint8_t> expected = tree_bytes(
+                blob_to_tree(data.data(), data.size()));
+
+            for (intptr_t piece: {1, 2, 3, 7, 64, 1000, 100000}) {
+                ToTree *tree = new ToTree();
+                PushParser parser(Registry::defaults(), StreamSink(tree));
+
+                intptr_t offset = 0;
+                while (offset < (intptr_t)data.size()) {
+                    const intptr_t len = std::min(piece, (intptr_t)data.size() - offset);
+                    CHECK(parser.feed(&data[offset], len) == len);
+                    offset += len;
+                    if (offset < (intptr_t)data.size()) {
+                        CHECK_FALSE(parser.finished());
+                        CHECK_THROWS_AS(parser.finish(), EndOfStreamError);
+                    }
+                }
+                REQUIRE(parser.finished());
+                CHECK(parser.buffered() == 0);
+                parser.finish();
+
+                CHECK(tree_bytes(tree->root()) == expected);
+
+#ifdef WITH_GNUTLS
+                std::shared_ptr<Container> outer = node_cast<Container>(
+                    *tree->root()->children_begin());
+                REQUIRE(outer.get() != 0);
+                CHECK(outer->get_hashed() == HT_SHA1);
+#endif
+            }
+        }
+    }
+}
+
+TEST_CASE ("decode/push/trailing", "Data after the end of the stream is not consumed")
+{
+    std::vector<uint8_t> data = sample_stream(true, false);
+    const intptr_t size = data.size();
+    data.push_back(0xaa);
+    data.push_back(0xbb);
+
+    ToTree *tree = new ToTree();
+    PushParser parser(Registry::defaults(), StreamSink(tree));
+    CHECK(parser.feed(data.data(), 10) == 10);
+    CHECK(parser.feed(&data[10], data.size() - 10) == size - 10);
+    CHECK(parser.finished());
+    CHECK(parser.feed(&data[size], 2) == 0);
+    CHECK(tree->root()->child_count() == 2);
+}
+
+TEST_CASE ("decode/push/straddle", "Complete a record left from the last piece, then parse in place")
+{
+    for (bool armor: {false, true}) {
+        std::vector<uint8_t> data = sample_stream(armor, false);
+        const intptr_t size = data.size();
+        const std::vector<uint8_t> expected = tree_bytes(
+            blob_to_tree(data.data(), data.size()));
+        data.push_back(0xaa);
+
+        // split within the first records, then hand over the rest
+        // including trailing garbage at once
+        for (intptr_t split = 1; split < 40; split++) {
+            ToTree *tree = new ToTree();
+            PushParser parser(Registry::defaults(), StreamSink(tree));
+            CHECK(parser.feed(data.data(), split) == split);
+            CHECK(parser.feed(&data[split], data.size() - split) == size - split);
+            REQUIRE(parser.finished());
+            CHECK(parser.buffered() == 0);
+            CHECK(tree_bytes(tree->root()) == expected);
+        }
+
+        // a record straddling two pieces, which are both too short to
+        // complete it
+        ToTree *tree = new ToTree();
+        PushParser parser(Registry::defaults(), StreamSink(tree));
+        CHECK(parser.feed(data.data(), 3) == 3);
+        CHECK(parser.feed(&data[3], 1) == 1);
+        CHECK(parser.feed(&data[4], size - 4) == size - 4);
+        CHECK(parser.finished());
+        CHECK(tree_bytes(tree->root()) == expected);
+    }
+}
+
+TEST_CASE ("decode/push/partial_blob", "Large payloads are only parsed once complete")
+{
+    std::shared_ptr<BlobRecord> blob = NodeHandleFactory<BlobRecord>::create(0x01);
+    std::vector<uint8_t> payload(10000, 0x5a);
+    blob->set((const char*)payload.data(), payload.size());
+
+    uint8_t output[11000];
+    const intptr_t size = tree_to_blob(output, sizeof(output), {blob});
+
+    ToTree *tree = new ToTree();
+    PushParser parser(Registry::defaults(), StreamSink(tree));
+    // everything but the last payload byte and the end of the stream
+    for (intptr_t offset = 0; offset < size - 2; offset += 100) {
+        const intptr_t len = std::min<intptr_t>(100, size - 2 - offset);
+        parser.feed(&output[offset], len);
+    }
+    CHECK(tree->root()->child_count() == 0);
+    CHECK(parser.buffered() == size - 2);
+
+    parser.feed(&output[size - 2], 2);
+    CHECK(parser.finished());
+    REQUIRE(tree->root()->child_count() == 1);
+    BlobRecord *rec = node_cast<BlobRecord>((*tree->root()->children_begin()).get());
+    REQUIRE(rec != 0);
+    CHECK(rec->datalen() == 10000);
+}
+
+#ifdef WITH_GNUTLS
+TEST_CASE ("decode/push/hash_error", "Hash mismatches are detected across pieces")
+{
+    std::vector<uint8_t> data = sample_stream(true, false);
+    // somewhere in the blob payload
+    data[500] ^= 0xff;
+
+    PushParser parser(Registry::defaults(), StreamSink(new ToTree()));
+    auto feed_all = [&]() {
+        for (size_t i = 0; i < data.size(); i += 5) {
+            parser.feed(&data[i], std::min<size_t>(5, data.size() - i));
+        }
+    };
+    CHECK_THROWS_AS(feed_all(), HashCheckError);
+}
+#endif
@@ -99,3 +99,77 @@ TEST_CASE ("decode/varuint", "Decode some varuints")
     check_varuint_invariant(0);
     check_varuint_invariant(MaxVarUInt);
 }
+
+TEST_CASE ("decode/varuint/sequence", "Decode varuints both in and out of the buffer tail")
+{
+    static const VarUInt values[] = {
+        0, 1, 0x7f, 0x80, 0x3fff, 0x4000, ((VarUInt)1 << 32),
+        MaxVarUInt, 0x12345, 0, MaxVarUInt, 0x7f
+    };
+    static const int count = sizeof(values) / sizeof(VarUInt);
+    uint8_t buffer[count*8];
+
+    WritableMemory writer_io(buffer, sizeof(buffer));
+    for (int i = 0; i < count; i++) {
+        Utils::write_varuint(&writer_io, values[i]);
+    }
+
+    ReadableMemory reader_io(writer_io);
+    for (int i = 0; i < count; i++) {
+        CHECK(Utils::read_varuint(&reader_io) == values[i]);
+    }
+    CHECK_THROWS_AS(Utils::read_varuint(&reader_io), EndOfStreamError);
+}
+
+TEST_CASE ("decode/varuint/batch", "Decode packed varuints in bulk")
+{
+    static const int count = 203;
+    VarUInt values[count];
+    for (int i = 0; i < count; i++) {
+        // cover all encoded lengths in changing order
+        const int bits = (i * 13) % 57;
+        values[i] = (bits == 0 ? 0 : ((VarUInt)1 << (bits - 1)) | (VarUInt)i);
+        values[i] &= MaxVarUInt;
+    }
+
+    uint8_t buffer[count*Utils::max_varint_size];
+    const size_t len = Utils::encode_varuints(buffer, values, count);
+
+    // the bulk encoder must agree with the streaming one
+    uint8_t reference[count*Utils::max_varint_size];
+    WritableMemory writer_io(reference, sizeof(reference));
+    for (int i = 0; i < count; i++) {
+        Utils::write_varuint(&writer_io, values[i]);
+    }
+    REQUIRE(writer_io.size() == (intptr_t)len);
+    REQUIRE(memcmp(buffer, reference, len) == 0);
+
+    VarUInt decoded[count];
+    memset(decoded, 0, sizeof(decoded));
+    CHECK(Utils::read_varuints(buffer, len, decoded, count) == len);
+    CHECK(memcmp(decoded, values, sizeof(values)) == 0);
+
+    // every prefix, so that each decoder path ends at each position
+    for (int n = 0; n < count; n++) {
+        memset(decoded, 0, sizeof(decoded));
+        const size_t prefix_len = Utils::encode_varuints(reference, values, n);
+        CHECK(Utils::read_varuints(buffer, len, decoded, n) == prefix_len);
+        CHECK(memcmp(decoded, values, n*sizeof(VarUInt)) == 0);
+    }
+
+    CHECK_THROWS_AS(Utils::read_varuints(buffer, len - 1, decoded, count),
+                    EndOfStreamError);
+}
+
+TEST_CASE ("decode/varuint/batch_invalid", "Reject invalid varuints in bulk decode")
+{
+    uint8_t buffer[64];
+    memset(buffer, 0x81, sizeof(buffer));
+    buffer[37] = 0x00;
+
+    VarUInt decoded[64];
+    CHECK(Utils::read_varuints(buffer, sizeof(buffer), decoded, 37) == 37);
+    CHECK(decoded[36] == 1);
+    CHECK_THROWS_AS(Utils::read_varuints(buffer, sizeof(buffer), decoded, 64),
+                    InvalidVarIntError);
+}
@@ -33,6 +33,8 @@ authors named in the AUTHORS file.
 #include "structstream/node_blob.hpp"
 #include "structstream/streaming_tree.hpp"
 
+#include "tests/utils.hpp"
+
 using namespace StructStream;
 
 TEST_CASE ("deserialize/pod", "Deserialization of a plain-old-data type")
@@ -286,3 +288,570 @@ TEST_CASE ("deserialize/only/require_first/ok", "Require an object to be first w
 
     CHECK(dest == 2342);
 }
+
+TEST_CASE ("deserialize/decode/struct",
+           "Direct decoding matches deserialization from the tree")
+{
+    enum class colour_t: uint32_t {
+        red = 1,
+        green = 2
+    };
+
+    struct inner_t {
+        uint32_t v1;
+        double v2;
+    };
+
+    struct message_t {
+        uint32_t id;
+        std::string name;
+        bool flag;
+        int64_t delta;
+        uint64_t count;
+        colour_t colour;
+        inner_t inner;
+        std::vector<uint32_t> values;
+        uint32_t triple[3];
+        uint8_t raw[16];
+    };
+
+    typedef EnumRecordTpl<colour_t, RT_UINT32, UInt32Record> ColourRecord;
+
+    typedef struct_decl<
+        Container,
+        id_selector<0x01>,
+        struct_members<
+            member<UInt32Record, id_selector<0x02>, message_t, uint32_t, &message_t::id>,
+            member<UTF8Record, id_selector<0x03>, message_t, std::string, &message_t::name>,
+            member<BoolRecord, id_selector<0x05>, message_t, bool, &message_t::flag>,
+            member<VarIntRecord, id_selector<0x06>, message_t, int64_t, &message_t::delta>,
+            member<VarUIntRecord, id_selector<0x07>, message_t, uint64_t, &message_t::count>,
+            member<ColourRecord, id_selector<0x08>, message_t, colour_t, &message_t::colour>,
+            member_struct<
+                message_t,
+                struct_decl<
+                    Container,
+                    id_selector<0x09>,
+                    struct_members<
+                        member<UInt32Record, id_selector<0x0a>, inner_t, uint32_t, &inner_t::v1>,
+                        member<Float64Record, id_selector<0x0b>, inner_t, double, &inner_t::v2>
+                        >
+                    >,
+                &message_t::inner
+                >,
+            member_struct<
+                message_t,
+                container<
+                    value_decl<UInt32Record, id_selector<0x0d>, uint32_t>,
+                    id_selector<0x0c>,
+                    std::back_insert_iterator<std::vector<uint32_t>>
+                    >,
+                &message_t::values
+                >,
+            member_struct<
+                message_t,
+                static_array<
+                    value_decl<UInt32Record, id_selector<0x0f>, uint32_t>,
+                    id_selector<0x0e>,
+                    3
+                    >,
+                &message_t::triple
+                >,
+            member<Raw128Record, id_selector<0x10>, message_t, uint8_t[16], &message_t::raw>
+            >
+        > decl;
+
+    message_t msg{
+        0xdeadbeef, "name", true, -1234567, 1ULL << 40, colour_t::green,
+        {42, 2.5}, {1, 2, 3, 4}, {7, 8, 9}, {0}
+    };
+    for (int i = 0; i < 16; i++) {
+        msg.raw[i] = i * 17;
+    }
+
+    ToTree *tree = new ToTree();
+    StreamSink tree_sink(tree);
+    serialize_to_sink<decl>(msg, tree_sink);
+    ContainerHandle root = std::static_pointer_cast<Container>(
+        *tree->root()->children_begin());
+
+    // records unknown to the declaration must be skipped
+    std::shared_ptr<UInt32Record> unknown = NodeHandleFactory<UInt32Record>::create(0x40);
+    unknown->set(1);
+    root->child_add(unknown);
+    ContainerHandle unknown_cont = NodeHandleFactory<Container>::create(0x41);
+    std::shared_ptr<UInt32Record> fake_id = NodeHandleFactory<UInt32Record>::create(0x02);
+    fake_id->set(2);
+    unknown_cont->child_add(fake_id);
+    root->child_add(unknown_cont);
+    std::shared_ptr<UInt32Record> wrong_type = NodeHandleFactory<UInt32Record>::create(0x03);
+    wrong_type->set(3);
+    root->child_add(wrong_type);
+
+    uint8_t buffer[1024];
+    intptr_t size = tree_to_blob(buffer, sizeof(buffer), {root});
+
+    message_t via_tree{};
+    FromTree(deserialize<only<decl, true, true>>(via_tree),
+             blob_to_tree(buffer, size));
+
+    message_t direct{};
+    decode_from<only<decl, true, true>>(
+        direct, IOIntfHandle(new MemoryView(buffer, size)));
+
+    CHECK(direct.id == 0xdeadbeef);
+    CHECK(direct.id == via_tree.id);
+    CHECK(direct.name == "name");
+    CHECK(direct.name == via_tree.name);
+    CHECK(direct.flag == via_tree.flag);
+    CHECK(direct.delta == -1234567);
+    CHECK(direct.delta == via_tree.delta);
+    CHECK(direct.count == via_tree.count);
+    CHECK(direct.colour == colour_t::green);
+    CHECK(direct.inner.v1 == via_tree.inner.v1);
+    CHECK(direct.inner.v2 == via_tree.inner.v2);
+    CHECK(direct.values == msg.values);
+    CHECK(direct.values == via_tree.values);
+    CHECK(memcmp(direct.triple, msg.triple, sizeof(msg.triple)) == 0);
+    CHECK(memcmp(direct.raw, msg.raw, sizeof(msg.raw)) == 0);
+}
+
+TEST_CASE ("deserialize/decode/only/detect_missing",
+           "Detect missing object when decoding directly with only<>")
+{
+    ContainerHandle result = NodeHandleFactory<Container>::create(0x00);
+    NodeHandle rec_node = NodeHandleFactory<UInt32Record>::create(0x02);
+    result->child_add(rec_node);
+
+    uint8_t buffer[64];
+    intptr_t size = tree_to_blob(buffer, sizeof(buffer), result, false);
+
+    uint32_t dest;
+    typedef only<value_decl<UInt32Record, id_selector<0x01>, uint32_t>, true> deserializer;
+
+    CHECK_THROWS_AS(
+        decode_from<deserializer>(
+            dest, IOIntfHandle(new MemoryView(buffer, size))),
+        RecordNotFound);
+}
+
+TEST_CASE ("deserialize/decode/only/require_first",
+           "Require an object to be first when decoding directly")
+{
+    ContainerHandle result = NodeHandleFactory<Container>::create(0x00);
+    std::shared_ptr<UInt32Record> rec_node = NodeHandleFactory<UInt32Record>::create(0x02);
+    rec_node->set(1);
+    result->child_add(rec_node);
+    rec_node = NodeHandleFactory<UInt32Record>::create(0x01);
+    rec_node->set(2342);
+    result->child_add(rec_node);
+
+    uint8_t buffer[64];
+    intptr_t size = tree_to_blob(buffer, sizeof(buffer), result, false);
+
+    uint32_t dest = 0;
+    typedef only<value_decl<UInt32Record, id_selector<0x01>, uint32_t>, true, true> strict;
+    typedef only<value_decl<UInt32Record, id_selector<0x01>, uint32_t>, true> lenient;
+
+    CHECK_THROWS_AS(
+        decode_from<strict>(
+            dest, IOIntfHandle(new MemoryView(buffer, size))),
+        RecordNotFound);
+
+    decode_from<lenient>(dest, IOIntfHandle(new MemoryView(buffer, size)));
+    CHECK(dest == 2342);
+}
+
+TEST_CASE ("deserialize/decode/iterator", "Direct decoding of a top-level sequence")
+{
+    ContainerHandle result = NodeHandleFactory<Container>::create(0x00);
+    for (uint32_t i = 0; i < 5; i++) {
+        std::shared_ptr<UInt32Record> rec = NodeHandleFactory<UInt32Record>::create(0x02);
+        rec->set(i);
+        result->child_add(rec);
+        if (i == 2) {
+            ContainerHandle skipped = NodeHandleFactory<Container>::create(0x02);
+            skipped->child_add(NodeHandleFactory<UInt32Record>::create(0x02));
+            result->child_add(skipped);
+        }
+    }
+
+    uint8_t buffer[256];
+    intptr_t size = tree_to_blob(buffer, sizeof(buffer), result, false);
+
+    std::vector<uint32_t> dest;
+    typedef iterator<
+        value_decl<UInt32Record, id_selector<0x02>, uint32_t>,
+        std::back_insert_iterator<decltype(dest)>
+        > deserializer;
+
+    decode_from<deserializer>(std::back_inserter(dest),
+                              IOIntfHandle(new MemoryView(buffer, size)));
+
+    CHECK(dest == std::vector<uint32_t>({0, 1, 2, 3, 4}));
+}
+
+template <ID min, ID max>
+struct range_selector
+{
+    static constexpr ID first = min;
+
+    static inline bool test(const ID to_test)
+    {
+        return (to_test >= min) && (to_test <= max);
+    };
+};
+
+TEST_CASE ("deserialize/dispatch", "Dispatch of records to struct members by ID")
+{
+    struct dispatch_t {
+        uint32_t high;
+        uint32_t low;
+        uint32_t shared_int;
+        std::string shared_str;
+        uint32_t either;
+        uint32_t ranged;
+        uint32_t last;
+    };
+
+    typedef struct_decl<
+        Container,
+        id_selector<0x01>,
+        struct_members<
+            member<UInt32Record, id_selector<0x90>, dispatch_t, uint32_t, &dispatch_t::high>,
+            member<UInt32Record, id_selector<0x02>, dispatch_t, uint32_t, &dispatch_t::low>,
+            member<UTF8Record, id_selector<0x05>, dispatch_t, std::string, &dispatch_t::shared_str>,
+            member<UInt32Record, id_selector<0x05>, dispatch_t, uint32_t, &dispatch_t::shared_int>,
+            member<UInt32Record, id_selector<0x10, 0x11>, dispatch_t, uint32_t, &dispatch_t::either>,
+            member<UInt32Record, range_selector<0x20, 0x2f>, dispatch_t, uint32_t, &dispatch_t::ranged>,
+            // shadowed by the range for 0x20 to 0x2f
+            member<UInt32Record, id_selector<0x21, 0x30>, dispatch_t, uint32_t, &dispatch_t::last>
+            >
+        > decl;
+
+    ContainerHandle root = NodeHandleFactory<Container>::create(0x01);
+    const ID ids[] = {0x90, 0x02, 0x05, 0x11, 0x21, 0x30, 0x03};
+    for (auto id: ids) {
+        std::shared_ptr<UInt32Record> rec = NodeHandleFactory<UInt32Record>::create(id);
+        rec->set(id);
+        root->child_add(rec);
+    }
+    std::shared_ptr<UTF8Record> str = NodeHandleFactory<UTF8Record>::create(0x05);
+    str->set("shared");
+    root->child_add(str);
+
+    dispatch_t via_tree{};
+    FromTree(deserialize<decl>(via_tree), root);
+
+    uint8_t buffer[256];
+    intptr_t size = tree_to_blob(buffer, sizeof(buffer), root, false);
+    dispatch_t direct{};
+    decode_from<decl>(direct, IOIntfHandle(new MemoryView(buffer, size)));
+
+    for (auto result: {&via_tree, &direct}) {
+        CHECK(result->high == 0x90);
+        CHECK(result->low == 0x02);
+        CHECK(result->shared_int == 0x05);
+        CHECK(result->shared_str == "shared");
+        CHECK(result->either == 0x11);
+        CHECK(result->ranged == 0x21);
+        CHECK(result->last == 0x30);
+    }
+}
+
+TEST_CASE ("deserialize/pool", "Deserializers reuse the memory of their pool")
+{
+    deserializer_pool pool;
+
+    deserializer_base *outside = new deserializer_null();
+    void *first_addr;
+    {
+        deserializer_pool::scope scope(&pool);
+        deserializer_base *first = new deserializer_null();
+        first_addr = first;
+        delete first;
+
+        deserializer_base *second = new deserializer_null();
+        CHECK((void*)second == first_addr);
+
+        // released to the heap, even while a pool is installed
+        delete outside;
+        delete second;
+    }
+    CHECK(deserializer_pool::current() == nullptr);
+
+    std::vector<std::vector<uint32_t>> dest;
+    typedef iterator<
+        container<
+            value_decl<UInt32Record, id_selector<0x02>, uint32_t>,
+            id_selector<0x01>,
+            std::back_insert_iterator<std::vector<uint32_t>>
+            >,
+        std::back_insert_iterator<decltype(dest)>
+        > deserializer;
+
+    ContainerHandle root = NodeHandleFactory<Container>::create(0x00);
+    for (uint32_t i = 0; i < 100; i++) {
+        ContainerHandle item = NodeHandleFactory<Container>::create(0x01);
+        std::shared_ptr<UInt32Record> rec = NodeHandleFactory<UInt32Record>::create(0x02);
+        rec->set(i);
+        item->child_add(rec);
+        root->child_add(item);
+    }
+
+    FromTree(deserialize<deserializer>(std::back_inserter(dest)), root);
+
+    REQUIRE(dest.size() == 100);
+    for (uint32_t i = 0; i < 100; i++) {
+        CHECK(dest[i] == std::vector<uint32_t>({i}));
+    }
+}
+
+struct logging_nesting: public deserializer_nesting
+{
+    logging_nesting(int level, std::vector<std::string> &log):
+        _level(level),
+        _log(log)
+    {
+
+    }
+
+    ~logging_nesting()
+    {
+        _log.push_back("delete " + std::to_string(_level));
+    }
+
+private:
+    int _level;
+    std::vector<std::string> &_log;
+
+protected:
+    bool _end_container() override
+    {
+        _log.push_back("end " + std::to_string(_level));
+        return true;
+    }
+
+    bool _node(const NodeHandle &node) override
+    {
+        _log.push_back("node " + std::to_string(_level));
+        return true;
+    }
+
+    bool _start_container(const ContainerHandle &cont) override
+    {
+        nest(new logging_nesting(_level + 1, _log));
+        return true;
+    }
+
+public:
+    void finalize() override
+    {
+        _log.push_back("finalize " + std::to_string(_level));
+        deserializer_nesting::finalize();
+    }
+};
+
+TEST_CASE ("deserialize/nesting/order", "Order of events, finalization and deletion of nested deserializers")
+{
+    static const int depth = 12;
+
+    std::vector<std::string> log;
+    std::vector<std::string> expected;
+    {
+        ContainerHandle root = NodeHandleFactory<Container>::create(0x00);
+        ContainerHandle parent = root;
+        for (int i = 0; i < depth; i++) {
+            ContainerHandle cont = NodeHandleFactory<Container>::create(0x01);
+            parent->child_add(cont);
+            parent = cont;
+        }
+        parent->child_add(NodeHandleFactory<UInt32Record>::create(0x02));
+
+        FromTree(StreamSink(new DeserializerSink(new logging_nesting(0, log))),
+                 root);
+
+        expected.push_back("node " + std::to_string(depth));
+        for (int i = depth; i > 0; i--) {
+            expected.push_back("finalize " + std::to_string(i));
+            expected.push_back("delete " + std::to_string(i));
+            expected.push_back("end " + std::to_string(i - 1));
+        }
+        expected.push_back("finalize 0");
+        expected.push_back("delete 0");
+
+        CHECK(log == expected);
+    }
+
+    // stream ends while the deserializers are nested
+    log.clear();
+    expected.clear();
+    {
+        DeserializerSink sink(new logging_nesting(0, log));
+        for (int i = 0; i < depth; i++) {
+            sink.start_container(NodeHandleFactory<Container>::create(0x01), nullptr);
+        }
+        sink.end_of_stream();
+
+        for (int i = 0; i <= depth; i++) {
+            expected.push_back("finalize " + std::to_string(i));
+        }
+        for (int i = depth; i >= 0; i--) {
+            expected.push_back("delete " + std::to_string(i));
+        }
+
+        CHECK(log == expected);
+    }
+}
+
+TEST_CASE ("deserialize/dispatch/enum", "Enum members only accept nodes of their record class")
+{
+    enum class colour_t: uint32_t {
+        red = 1,
+        green = 2
+    };
+
+    struct paint_t {
+        colour_t colour;
+    };
+
+    typedef EnumRecordTpl<colour_t, RT_UINT32, UInt32Record> ColourRecord;
+    typedef struct_decl<
+        Container,
+        id_selector<0x01>,
+        struct_members<
+            member<ColourRecord, id_selector<0x02>, paint_t, colour_t, &paint_t::colour>
+            >
+        > decl;
+
+    // a plain UInt32Record is not a ColourRecord and must not be cast
+    // to one
+    ContainerHandle root = NodeHandleFactory<Container>::create(0x01);
+    std::shared_ptr<UInt32Record> plain = NodeHandleFactory<UInt32Record>::create(0x02);
+    plain->set(2);
+    root->child_add(plain);
+
+    paint_t paint{colour_t::red};
+    FromTree(deserialize<decl>(paint), root);
+    CHECK(paint.colour == colour_t::red);
+
+    root = NodeHandleFactory<Container>::create(0x01);
+    std::shared_ptr<ColourRecord> colour = NodeHandleFactory<ColourRecord>::create(0x02);
+    colour->set(colour_t::green);
+    root->child_add(colour);
+
+    FromTree(deserialize<decl>(paint), root);
+    CHECK(paint.colour == colour_t::green);
+
+    // the direct decoder creates no nodes and reads the value as is
+    uint8_t buffer[64];
+    intptr_t size = tree_to_blob(buffer, sizeof(buffer), root, false);
+    paint.colour = colour_t::red;
+    decode_from<decl>(paint, IOIntfHandle(new MemoryView(buffer, size)));
+    CHECK(paint.colour == colour_t::green);
+}
+
+// a class which a custom registry could create for RT_UINT32, but
+// which is no UInt32Record
+class WideUInt32Record: public UInt64Record {
+protected:
+    explicit WideUInt32Record(ID id):
+        UInt64Record(id)
+    {
+
+    };
+public:
+    virtual NodeHandle copy() const {
+        return NodeHandleFactory<WideUInt32Record>::copy(*this);
+    };
+
+    virtual RecordType record_type() const {
+        return RT_UINT32;
+    };
+
+    friend struct NodeHandleFactory<WideUInt32Record>;
+};
+
+TEST_CASE ("deserialize/dispatch/custom_class", "Members only accept nodes of their record class, not just of its record type")
+{
+    struct value_t {
+        uint32_t value;
+    };
+
+    typedef struct_decl<
+        Container,
+        id_selector<0x01>,
+        struct_members<
+            member<UInt32Record, id_selector<0x02>, value_t, uint32_t, &value_t::value>
+            >
+        > decl;
+
+    ContainerHandle root = NodeHandleFactory<Container>::create(0x01);
+    std::shared_ptr<WideUInt32Record> wide = NodeHandleFactory<WideUInt32Record>::create(0x02);
+    wide->set(0x1122334455667788ULL);
+    root->child_add(wide);
+    REQUIRE(wide->record_type() == RT_UINT32);
+
+    value_t value{1};
+    FromTree(deserialize<decl>(value), root);
+    CHECK(value.value == 1U);
+}
+
+TEST_CASE ("deserialize/dispatch/enum_bitstream", "Decode enum members from a bitstream with and without nodes")
+{
+    enum class colour_t: uint32_t {
+        red = 1,
+        green = 2
+    };
+
+    struct paint_t {
+        colour_t colour;
+    };
+
+    typedef EnumRecordTpl<colour_t, RT_UINT32, UInt32Record> ColourRecord;
+    typedef struct_decl<
+        Container,
+        id_selector<0x01>,
+        struct_members<
+            member<ColourRecord, id_selector<0x02>, paint_t, colour_t, &paint_t::colour>
+            >
+        > decl;
+
+    ContainerHandle root = NodeHandleFactory<Container>::create(0x01);
+    std::shared_ptr<ColourRecord> colour = NodeHandleFactory<ColourRecord>::create(0x02);
+    colour->set(colour_t::green);
+    root->child_add(colour);
+
+    uint8_t buffer[64];
+    const intptr_t size = tree_to_blob(buffer, sizeof(buffer), root, false);
+
+    // without nodes, the record type is all that counts
+    paint_t paint{colour_t::red};
+    decode_from<decl>(paint, IOIntfHandle(new MemoryView(buffer, size)));
+    CHECK(paint.colour == colour_t::green);
+
+    // the default registry creates plain UInt32Records
+    paint.colour = colour_t::red;
+    {
+        FromBitstream reader(IOIntfHandle(new MemoryView(buffer, size)),
+                             Registry::defaults(), deserialize<decl>(paint));
+        reader.read_all();
+    }
+    CHECK(paint.colour == colour_t::red);
+
+    // with the enum class registered, both paths agree
+    RegistryHandle registry(new Registry(*Registry::defaults()));
+    registry->register_record_type(RT_UINT32, [](ID id) {
+        return NodeHandleFactory<ColourRecord>::create(id);
+    });
+    {
+        FromBitstream reader(IOIntfHandle(new MemoryView(buffer, size)),
+                             registry, deserialize<decl>(paint));
+        reader.read_all();
+    }
+    CHECK(paint.colour == colour_t::green);
+
+    paint.colour = colour_t::red;
+    decode_from<decl>(paint, IOIntfHandle(new MemoryView(buffer, size)), registry);
+    CHECK(paint.colour == colour_t::green);
+}
@@ -25,6 +25,9 @@ authors named in the AUTHORS file.
 **********************************************************************/
 #include "catch.hpp"
 
+#include <cstring>
+#include <sstream>
+
 #include "tests/utils.hpp"
 
 #define COMMON_HEADER
@@ -104,3 +107,156 @@ TEST_CASE ("encode/container/with_child", "Encode a container with one child")
 
     REQUIRE(memcmp(expected, output, sizeof(expected)) == 0);
 }
+
+TEST_CASE ("encode/container/with_length", "Encode nested containers with body length")
+{
+    static const uint8_t expected[] = {
+        COMMON_HEADER
+        (uint8_t)(RT_CONTAINER) | 0x80,
+        (uint8_t)(0x01) | 0x80,
+        (uint8_t)(CF_WITH_SIZE | CF_WITH_LENGTH) | 0x80,
+        (uint8_t)(0x01) | 0x80,
+        (uint8_t)(0x0b) | 0x80, // body length
+        (uint8_t)(RT_CONTAINER) | 0x80,
+        (uint8_t)(0x03) | 0x80,
+        (uint8_t)(CF_WITH_SIZE | CF_WITH_LENGTH) | 0x80,
+        (uint8_t)(0x01) | 0x80,
+        (uint8_t)(0x06) | 0x80, // body length
+        (uint8_t)(RT_UINT32) | 0x80,
+        (uint8_t)(0x02) | 0x80,
+        0x11, 0x22, 0x33, 0x44,
+        COMMON_FOOTER
+    };
+
+    ContainerHandle outer = NodeHandleFactory<Container>::create(0x01);
+    ContainerHandle inner = NodeHandleFactory<Container>::create(0x03);
+    std::shared_ptr<UInt32Record> rec = NodeHandleFactory<UInt32Record>::create(0x02);
+    rec->set(0x44332211);
+    inner->child_add(rec);
+    outer->child_add(inner);
+
+    uint8_t output[sizeof(expected)];
+
+    IOIntfHandle io(new WritableMemory(output, sizeof(output)));
+    ToBitstream *writer = new ToBitstream(io);
+    writer->set_length_default(true);
+    FromTree(StreamSink(writer), {outer});
+
+    REQUIRE(static_cast<WritableMemory*>(io.get())->size() == sizeof(expected));
+    REQUIRE(memcmp(expected, output, sizeof(expected)) == 0);
+}
+
+TEST_CASE ("encode/container/with_length_seekable", "Fill in body lengths on seekable outputs")
+{
+    static const uint8_t expected[] = {
+        COMMON_HEADER
+        (uint8_t)(RT_CONTAINER) | 0x80,
+        (uint8_t)(0x01) | 0x80,
+        (uint8_t)(CF_WITH_SIZE | CF_WITH_LENGTH) | 0x80,
+        (uint8_t)(0x01) | 0x80,
+        0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x12, // body length
+        (uint8_t)(RT_CONTAINER) | 0x80,
+        (uint8_t)(0x03) | 0x80,
+        (uint8_t)(CF_WITH_SIZE | CF_WITH_LENGTH) | 0x80,
+        (uint8_t)(0x01) | 0x80,
+        0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, // body length
+        (uint8_t)(RT_UINT32) | 0x80,
+        (uint8_t)(0x02) | 0x80,
+        0x11, 0x22, 0x33, 0x44,
+        COMMON_FOOTER
+    };
+
+    ContainerHandle outer = NodeHandleFactory<Container>::create(0x01);
+    ContainerHandle inner = NodeHandleFactory<Container>::create(0x03);
+    std::shared_ptr<UInt32Record> rec = NodeHandleFactory<UInt32Record>::create(0x02);
+    rec->set(0x44332211);
+    inner->child_add(rec);
+    outer->child_add(inner);
+
+    // patch within the buffer, behind it and without buffer
+    for (intptr_t buffer_size: {(intptr_t)BufferedWriter::default_block_size,
+                                (intptr_t)8, (intptr_t)0}) {
+        std::stringstream stream;
+        IOIntfHandle io(new StandardOutputStream(stream));
+        ToBitstream *writer = new ToBitstream(io, buffer_size);
+        writer->set_length_default(true);
+        FromTree(StreamSink(writer), {outer});
+
+        const std::string output = stream.str();
+        REQUIRE(output.size() == sizeof(expected));
+        CHECK(memcmp(expected, output.data(), sizeof(expected)) == 0);
+
+        ContainerHandle root = blob_to_tree((const uint8_t*)output.data(), output.size());
+        REQUIRE(root->child_count() == 1);
+
+        // the overlong length is read like any other
+        BitstreamCursor cursor(IOIntfHandle(new MemoryView(
+            (const uint8_t*)output.data(), output.size())));
+        CursorEvent ev;
+        REQUIRE(cursor.next(ev));
+        CHECK(ev.len == 0x12);
+        cursor.skip_container();
+        CHECK_FALSE(cursor.next(ev));
+    }
+}
+
+// a writer which, like subclasses may, keeps more state per container
+class TaggingWriter: public ToBitstream {
+public:
+    explicit TaggingWriter(IOIntfHandle dest):
+        ToBitstream(dest),
+        infos_created(0)
+    {
+
+    };
+protected:
+    struct TaggedInfo: public ParentInfo {
+        int tag;
+    };
+public:
+    mutable int infos_created;
+protected:
+    virtual ParentInfo *new_parent_info() const {
+        infos_created++;
+        TaggedInfo *info = new TaggedInfo;
+        info->tag = infos_created;
+        return info;
+    };
+public:
+    bool initial_info_is_clean() const {
+        std::unique_ptr<ParentInfo> info(new_parent_info());
+        return !info->cont && info->body == nullptr && !info->body_h
+            && !info->outer_h && !info->with_length
+            && info->length_offset == -1;
+    };
+};
+
+TEST_CASE ("encode/container/custom_parent_info", "Subclasses may create their own parent infos")
+{
+    ContainerHandle outer = NodeHandleFactory<Container>::create(0x01);
+    ContainerHandle inner = NodeHandleFactory<Container>::create(0x03);
+    std::shared_ptr<UInt32Record> rec = NodeHandleFactory<UInt32Record>::create(0x02);
+    rec->set(0x44332211);
+    inner->child_add(rec);
+    outer->child_add(inner);
+
+    WritableMemory *expected = new WritableMemory();
+    IOIntfHandle expected_h(expected);
+    {
+        ToBitstream *writer = new ToBitstream(expected_h);
+        writer->set_length_default(true);
+        FromTree(StreamSink(writer), {outer});
+    }
+
+    WritableMemory *output = new WritableMemory();
+    IOIntfHandle output_h(output);
+    TaggingWriter *writer = new TaggingWriter(output_h);
+    StreamSink sink(writer);
+    CHECK(writer->initial_info_is_clean());
+    writer->set_length_default(true);
+    FromTree(sink, {outer});
+    CHECK(writer->infos_created == 3);
+
+    REQUIRE(output->size() == expected->size());
+    CHECK(memcmp(output->buffer(), expected->buffer(), output->size()) == 0);
+}
@@ -196,3 +196,87 @@ TEST_CASE ("encode/varint/-0x7f", "Encode a negative varint at the byte count bo
     REQUIRE(static_cast<WritableMemory*>(io.get())->size() == sizeof(expected));
     REQUIRE(memcmp(expected, output, sizeof(expected)) == 0);
 }
+
+TEST_CASE ("encode/varuint/buffer", "Encode varuints back to back into a buffer")
+{
+    static const uint8_t expected[] = {
+        0x80,
+        0x3f, 0xff, 0xff,
+        (uint8_t)(0x40 | 0x20), 0x7f
+    };
+
+    uint8_t output[sizeof(expected) + Utils::max_varint_size];
+    intptr_t len = Utils::encode_varuint(output, 0x00);
+    CHECK(len == 1);
+    len += Utils::encode_varuint(&output[len], 0x1fffff);
+    CHECK(len == 4);
+    len += Utils::encode_varint(&output[len], -0x7f);
+
+    REQUIRE(len == sizeof(expected));
+    REQUIRE(memcmp(expected, output, sizeof(expected)) == 0);
+}
+
+TEST_CASE ("encode/varuint/out_of_range", "Refuse to encode values which do not fit into a varint")
+{
+    uint8_t output[Utils::max_varint_size];
+
+    CHECK(Utils::encode_varuint(output, MaxVarUInt) == Utils::max_varint_size);
+    CHECK_THROWS_AS(Utils::encode_varuint(output, MaxVarUInt + 1), LimitError);
+    CHECK_THROWS_AS(Utils::encode_varuint(output, ~(VarUInt)0), LimitError);
+
+    CHECK(Utils::encode_varint(output, MaxVarInt) == Utils::max_varint_size);
+    CHECK(Utils::encode_varint(output, MinVarInt) == Utils::max_varint_size);
+    CHECK_THROWS_AS(Utils::encode_varint(output, MaxVarInt + 1), LimitError);
+    CHECK_THROWS_AS(Utils::encode_varint(output, MinVarInt - 1), LimitError);
+
+    WritableMemory io;
+    CHECK_THROWS_AS(Utils::write_id(&io, MaxID + 1), LimitError);
+    CHECK(io.size() == 0);
+}
+
+TEST_CASE ("encode/varuint/batch", "Encode varuints of all lengths back to back in bulk")
+{
+    static const VarUInt values[] = {
+        0x00, 0x7f, 0x80, 0x3fff, 0x1fffff, 0xfffffff,
+        0x123456789, 0x3ffffffffff, MaxVarUInt
+    };
+    static const uint8_t expected[] = {
+        0x80,
+        0xff,
+        0x40, 0x80,
+        0x7f, 0xff,
+        0x3f, 0xff, 0xff,
+        0x1f, 0xff, 0xff, 0xff,
+        0x09, 0x23, 0x45, 0x67, 0x89,
+        0x07, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0x01, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+    };
+    static const size_t count = sizeof(values) / sizeof(VarUInt);
+
+    uint8_t output[count*Utils::max_varint_size];
+    memset(output, 0, sizeof(output));
+
+    REQUIRE(Utils::encode_varuints(output, values, count) == sizeof(expected));
+    REQUIRE(memcmp(expected, output, sizeof(expected)) == 0);
+
+    // each value ends where the next one starts
+    REQUIRE(Utils::encode_varuints(output, values, 3) == 4);
+    REQUIRE(memcmp(expected, output, 4) == 0);
+    CHECK(Utils::encode_varuints(output, values, 0) == 0);
+}
+
+TEST_CASE ("encode/varuint/batch_out_of_range", "Refuse to encode values which do not fit into a varint in bulk")
+{
+    static const uint8_t expected[] = {
+        0x81,
+        0x01, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+    };
+    const VarUInt values[] = {1, MaxVarUInt, MaxVarUInt + 1, 2};
+    uint8_t output[4*Utils::max_varint_size];
+
+    REQUIRE(Utils::encode_varuints(output, values, 2) == sizeof(expected));
+    REQUIRE(memcmp(expected, output, sizeof(expected)) == 0);
+    CHECK_THROWS_AS(Utils::encode_varuints(output, values, 4), LimitError);
+    // the values before the offending one have been written
+    CHECK(memcmp(expected, output, sizeof(expected)) == 0);
+}
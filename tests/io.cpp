@@ -0,0 +1,975 @@
+/**********************************************************************
+File name: io.cpp
+This file is part of: structstream++
+
+LICENSE
+
+The contents of this file are subject to the Mozilla Public License
+Version 1.1 (the "License"); you may not use this file except in
+compliance with the License. You may obtain a copy of the License at
+http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS"
+basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+License for the specific language governing rights and limitations under
+the License.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public license (the  "GPL License"), in which case  the
+provisions of GPL License are applicable instead of those above.
+
+FEEDBACK & QUESTIONS
+
+For feedback and questions about structstream++ please e-mail one of the
+authors named in the AUTHORS file.
+**********************************************************************/
+#include "catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "structstream/io.hpp"
+
+#include "tests/utils.hpp"
+
+using namespace StructStream;
+
+static const uint8_t io_test_data[] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+    0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17
+};
+
+TEST_CASE ("io/memory/view", "Read from a buffer in place")
+{
+    MemoryView view(io_test_data, sizeof(io_test_data));
+    CHECK(view.buffer() == io_test_data);
+
+    uint8_t buf[4];
+    CHECK(view.read(buf, sizeof(buf)) == sizeof(buf));
+    CHECK(memcmp(buf, io_test_data, sizeof(buf)) == 0);
+
+    MemoryView copy(view);
+    CHECK(copy.buffer() == io_test_data);
+    CHECK(copy.read(buf, sizeof(buf)) == sizeof(buf));
+    CHECK(memcmp(buf, io_test_data, sizeof(buf)) == 0);
+}
+
+TEST_CASE ("io/memory/view_writable", "View the contents of a WritableMemory")
+{
+    uint8_t output[sizeof(io_test_data)];
+    WritableMemory mem(output, sizeof(output));
+    REQUIRE(mem.write(io_test_data, 8) == 8);
+
+    MemoryView view(mem);
+    CHECK(view.buffer() == output);
+    CHECK(view.size() == 8);
+
+    uint8_t buf[sizeof(io_test_data)];
+    CHECK(view.read(buf, sizeof(buf)) == 8);
+    CHECK(memcmp(buf, io_test_data, 8) == 0);
+}
+
+TEST_CASE ("io/memory/view_segments", "View a growing WritableMemory without copying")
+{
+    SegmentPoolHandle pool(new SegmentPool(16));
+    WritableMemory mem(pool);
+    REQUIRE(mem.write(io_test_data, 8) == 8);
+
+    MemoryView view(mem);
+    CHECK(view.buffer() == mem.segmented()->segments()[0].data);
+    CHECK(view.size() == 8);
+
+    REQUIRE(mem.write(io_test_data, sizeof(io_test_data)) == sizeof(io_test_data));
+    CHECK_THROWS_AS(MemoryView{mem}, UnsupportedInput);
+}
+
+TEST_CASE ("io/memory/view_decode", "Decode blobs in place from a view")
+{
+    static const uint8_t data[] = {
+        (uint8_t)(RT_BLOB) | 0x80, uint8_t(0x01) | 0x80, uint8_t(0x04) | 0x80,
+        0xde, 0xad, 0xbe, 0xef,
+        (uint8_t)(RT_UINT32) | 0x80, uint8_t(0x02) | 0x80, 0x11, 0x11, 0x11, 0x11,
+        (uint8_t)(RT_END_OF_CHILDREN) | 0x80
+    };
+
+    BitstreamCursor cursor(IOIntfHandle(new MemoryView(data, sizeof(data))));
+    CursorEvent ev;
+    REQUIRE(cursor.next(ev));
+    CHECK(ev.kind == CE_BLOB);
+    CHECK(ev.data == &data[3]);
+    REQUIRE(cursor.next(ev));
+    CHECK(ev.value.u32 == 0x11111111U);
+    CHECK_FALSE(cursor.next(ev));
+
+    ContainerHandle root = bitstream_to_tree(
+        IOIntfHandle(new MemoryView(data, sizeof(data))));
+    CHECK(root->child_count() == 2);
+}
+
+TEST_CASE ("io/memory/acquire", "Access a memory buffer directly")
+{
+    ReadableMemory mem(io_test_data, sizeof(io_test_data));
+    CHECK(mem.contiguous());
+
+    const uint8_t *direct = nullptr;
+    CHECK(mem.acquire(&direct, 4) == sizeof(io_test_data));
+    CHECK(memcmp(direct, io_test_data, sizeof(io_test_data)) == 0);
+    mem.commit(4);
+
+    uint8_t value = 0;
+    CHECK(mem.read(&value, 1) == 1);
+    CHECK(value == 0x04);
+
+    mem.commit(mem.acquire(&direct, 1));
+    CHECK(mem.acquire(&direct, 1) == 0);
+}
+
+TEST_CASE ("io/memory/seek", "Seek within a memory buffer")
+{
+    ReadableMemory mem(io_test_data, sizeof(io_test_data));
+    REQUIRE(mem.seekable());
+    CHECK(mem.tell() == 0);
+    CHECK(mem.seek(10) == 10);
+
+    uint8_t value = 0;
+    CHECK(mem.read(&value, 1) == 1);
+    CHECK(value == 0x0a);
+    CHECK(mem.tell() == 11);
+
+    CHECK(mem.skip(10) == 10);
+    CHECK(mem.skip(10) == 3);
+    CHECK(mem.seek(100) == sizeof(io_test_data));
+    CHECK(mem.seek(0) == 0);
+}
+
+TEST_CASE ("io/buffered/seek", "Seek through a BufferedReader")
+{
+    IOIntfHandle mem(new ReadableMemory(io_test_data, sizeof(io_test_data)));
+    BufferedReader reader(mem, 8);
+    REQUIRE(reader.seekable());
+
+    uint8_t value = 0;
+    CHECK(reader.read(&value, 1) == 1);
+    CHECK(reader.tell() == 1);
+    // within the buffer
+    CHECK(reader.seek(6) == 6);
+    CHECK(reader.read(&value, 1) == 1);
+    CHECK(value == 0x06);
+    // outside of it
+    CHECK(reader.seek(20) == 20);
+    CHECK(reader.read(&value, 1) == 1);
+    CHECK(value == 0x14);
+    CHECK(reader.seek(2) == 2);
+    CHECK(reader.read(&value, 1) == 1);
+    CHECK(value == 0x02);
+    CHECK(reader.skip(100) == 21);
+
+    // hashing sources must see all data and cannot seek
+    HashPipe<HP_READ> pipe(nullptr, mem);
+    CHECK(!pipe.seekable());
+}
+
+TEST_CASE ("io/std/seek", "Seek within a std stream")
+{
+    std::stringstream stream(std::string((const char*)io_test_data, sizeof(io_test_data)));
+    StandardInputStream in(stream);
+    REQUIRE(in.seekable());
+
+    uint8_t value = 0;
+    CHECK(in.skip(5) == 5);
+    CHECK(in.read(&value, 1) == 1);
+    CHECK(value == 0x05);
+    CHECK(in.tell() == 6);
+    CHECK(in.skip(100) == 18);
+    CHECK(in.read(&value, 1) == 0);
+    CHECK(in.seek(1) == 1);
+    CHECK(in.read(&value, 1) == 1);
+    CHECK(value == 0x01);
+
+    // errors which did not come from reading up to the end are kept
+    stream.setstate(std::ios_base::failbit);
+    CHECK(in.skip(2) == 2);
+    CHECK(stream.fail());
+    CHECK(in.tell() == 4);
+    CHECK(in.read(&value, 1) == 0);
+    stream.clear();
+    CHECK(in.read(&value, 1) == 1);
+    CHECK(value == 0x04);
+}
+
+// a std::streambuf which, like those of pipes, cannot seek
+class UnseekableBuf: public std::streambuf {
+public:
+    UnseekableBuf(const uint8_t *data, intptr_t len) {
+        char *begin = (char*)data;
+        setg(begin, begin, begin + len);
+    };
+};
+
+TEST_CASE ("io/std/state", "Keep the stream state when checking for seekability")
+{
+    UnseekableBuf buf(io_test_data, sizeof(io_test_data));
+    std::istream stream(&buf);
+    StandardInputStream in(stream);
+
+    uint8_t data[sizeof(io_test_data) + 1];
+    CHECK(in.read(data, sizeof(data)) == sizeof(io_test_data));
+    REQUIRE(stream.eof());
+
+    CHECK(!in.seekable());
+    CHECK(stream.eof());
+    CHECK(in.tell() == -1);
+    CHECK(stream.eof());
+}
+
+// a std::streambuf whose writer is still connected: asking it for
+// more data than it holds would block, which is recorded instead
+class OpenEndedBuf: public std::streambuf {
+public:
+    OpenEndedBuf(const uint8_t *data, intptr_t len):
+        waited(false)
+    {
+        char *begin = (char*)data;
+        setg(begin, begin, begin + len);
+    };
+
+    bool waited;
+protected:
+    virtual int_type underflow() {
+        waited = true;
+        return traits_type::eof();
+    };
+};
+
+static const uint8_t io_short_record[] = {
+    (uint8_t)(RT_UINT32) | 0x80, uint8_t(0x02) | 0x80, 0x11, 0x11, 0x11, 0x11
+};
+
+TEST_CASE ("io/std/open_ended", "Decode a short record from a stream which is still open")
+{
+    OpenEndedBuf buf(io_short_record, sizeof(io_short_record));
+    std::istream stream(&buf);
+
+    BitstreamCursor cursor(IOIntfHandle(new StandardInputStream(stream)));
+    CursorEvent ev;
+    REQUIRE(cursor.next(ev));
+    CHECK(ev.kind == CE_VALUE);
+    CHECK(ev.value.u32 == 0x11111111U);
+    CHECK_FALSE(buf.waited);
+}
+
+TEST_CASE ("io/buffered/acquire", "Access the buffer of a BufferedReader")
+{
+    IOIntfHandle mem(new ReadableMemory(io_test_data, sizeof(io_test_data)));
+    BufferedReader reader(mem, 8);
+    CHECK(!reader.contiguous());
+
+    uint8_t value = 0;
+    CHECK(reader.read(&value, 1) == 1);
+
+    const uint8_t *direct = nullptr;
+    CHECK(reader.acquire(&direct, 4) == 7);
+    CHECK(direct[0] == 0x01);
+    reader.commit(5);
+
+    // the buffer is refilled to satisfy the request
+    CHECK(reader.acquire(&direct, 6) == 8);
+    CHECK(memcmp(direct, &io_test_data[6], 8) == 0);
+    reader.commit(2);
+
+    // larger than the block size
+    CHECK(reader.acquire(&direct, 10) == 6);
+
+    CHECK(reader.read(&value, 1) == 1);
+    CHECK(value == 0x08);
+}
+
+TEST_CASE ("io/segmented/write", "Write across segment boundaries")
+{
+    SegmentPoolHandle pool(new SegmentPool(7, 2));
+    SegmentedMemory mem(pool);
+
+    CHECK(mem.write(&io_test_data[0], 3) == 3);
+    CHECK(mem.write(&io_test_data[3], 10) == 10);
+    CHECK(mem.write(&io_test_data[13], 11) == 11);
+    CHECK(mem.size() == sizeof(io_test_data));
+
+    const std::vector<MemorySegment> &segments = mem.segments();
+    REQUIRE(segments.size() == 4);
+    intptr_t offset = 0;
+    for (auto &segment: segments) {
+        CHECK(segment.len <= 7);
+        CHECK(memcmp(segment.data, &io_test_data[offset], segment.len) == 0);
+        offset += segment.len;
+    }
+    CHECK(offset == (intptr_t)sizeof(io_test_data));
+
+    const uint8_t *flat = mem.flatten();
+    REQUIRE(mem.segments().size() == 1);
+    CHECK(memcmp(flat, io_test_data, sizeof(io_test_data)) == 0);
+
+    CHECK(mem.write(io_test_data, 2) == 2);
+    CHECK(mem.segments().size() == 2);
+
+    intptr_t len = 0;
+    uint8_t *released = mem.release_buffer(len);
+    REQUIRE(len == sizeof(io_test_data) + 2);
+    CHECK(memcmp(released, io_test_data, sizeof(io_test_data)) == 0);
+    CHECK(memcmp(&released[sizeof(io_test_data)], io_test_data, 2) == 0);
+    free(released);
+
+    CHECK(mem.size() == 0);
+    CHECK(mem.segments().size() == 0);
+}
+
+TEST_CASE ("io/segmented/flatten_append", "Merge only new data on repeated flatten()")
+{
+    SegmentPoolHandle pool(new SegmentPool(8, 2));
+    SegmentedMemory mem(pool);
+
+    CHECK(mem.write(io_test_data, sizeof(io_test_data)) == sizeof(io_test_data));
+    REQUIRE(mem.segments().size() == 3);
+    mem.flatten();
+    CHECK(mem.write(io_test_data, 8) == 8);
+    CHECK(mem.segments().size() == 2);
+
+    // the merged block keeps spare room for the next writes
+    const uint8_t *flat = mem.flatten();
+    CHECK(mem.write(&io_test_data[8], 8) == 8);
+    REQUIRE(mem.segments().size() == 1);
+    CHECK(mem.flatten() == flat);
+
+    CHECK(memcmp(flat, io_test_data, sizeof(io_test_data)) == 0);
+    CHECK(memcmp(&flat[sizeof(io_test_data)], io_test_data, 16) == 0);
+}
+
+TEST_CASE ("io/segmented/splice", "Move segments from one buffer to another")
+{
+    SegmentPoolHandle pool(new SegmentPool(8, 4));
+    SegmentedMemory outer(pool);
+    SegmentedMemory inner(pool);
+
+    CHECK(outer.write(io_test_data, 3) == 3);
+    CHECK(inner.write(&io_test_data[3], 18) == 18);
+    REQUIRE(inner.segments().size() == 3);
+    const uint8_t *full = inner.segments()[0].data;
+
+    // the last segment of inner is less than half full
+    outer.splice(inner);
+    CHECK(inner.size() == 0);
+    CHECK(inner.segments().size() == 0);
+    CHECK(outer.size() == 21);
+    REQUIRE(outer.segments().size() == 4);
+    CHECK(outer.segments()[1].data == full);
+
+    CHECK(outer.write(&io_test_data[21], 3) == 3);
+    std::vector<uint8_t> merged;
+    for (auto &segment: outer.segments()) {
+        merged.insert(merged.end(), segment.data, segment.data + segment.len);
+    }
+    REQUIRE(merged.size() == sizeof(io_test_data));
+    CHECK(memcmp(merged.data(), io_test_data, sizeof(io_test_data)) == 0);
+}
+
+TEST_CASE ("io/buffered/write_seek", "Overwrite output through a BufferedWriter")
+{
+    std::stringstream stream;
+    IOIntfHandle out(new StandardOutputStream(stream));
+    BufferedWriter writer(out, 8);
+    REQUIRE(writer.seekable());
+
+    CHECK(writer.write(io_test_data, 6) == 6);
+    // within the buffer
+    CHECK(writer.seek(2) == 2);
+    CHECK(writer.write(&io_test_data[10], 2) == 2);
+    CHECK(writer.seek(6) == 6);
+    CHECK(writer.write(&io_test_data[6], 10) == 10);
+    CHECK(writer.tell() == 16);
+    // behind the buffer
+    CHECK(writer.seek(0) == 0);
+    CHECK(writer.write(&io_test_data[20], 1) == 1);
+    CHECK(writer.seek(16) == 16);
+    REQUIRE(writer.flush());
+
+    uint8_t expected[16];
+    memcpy(expected, io_test_data, sizeof(expected));
+    expected[0] = io_test_data[20];
+    expected[2] = io_test_data[10];
+    expected[3] = io_test_data[11];
+    const std::string output = stream.str();
+    REQUIRE(output.size() == sizeof(expected));
+    CHECK(memcmp(output.data(), expected, sizeof(expected)) == 0);
+}
+
+TEST_CASE ("io/segmented/pool", "Recycle segments through the pool")
+{
+    SegmentPoolHandle pool(new SegmentPool(16, 1));
+    uint8_t *first = pool->allocate();
+    pool->release(first);
+    CHECK(pool->allocate() == first);
+    pool->release(first);
+
+    {
+        SegmentedMemory mem(pool);
+        mem.write(io_test_data, 8);
+        CHECK(mem.segments()[0].data == first);
+    }
+    CHECK(pool->allocate() == first);
+    free(first);
+}
+
+TEST_CASE ("io/memory/growing", "Grow a WritableMemory beyond one segment")
+{
+    SegmentPoolHandle pool(new SegmentPool(5));
+    WritableMemory mem(pool);
+    for (int i = 0; i < 10; i++) {
+        CHECK(mem.write(io_test_data, sizeof(io_test_data)) == sizeof(io_test_data));
+    }
+    REQUIRE(mem.size() == 10*sizeof(io_test_data));
+    REQUIRE(mem.segmented() != nullptr);
+    CHECK(mem.segmented()->segments().size() == 48);
+
+    for (int i = 0; i < 10; i++) {
+        CHECK(memcmp(&mem.buffer()[i*sizeof(io_test_data)],
+                     io_test_data, sizeof(io_test_data)) == 0);
+    }
+
+    ReadableMemory copy(mem);
+    CHECK(copy.size() == mem.size());
+}
+
+TEST_CASE ("io/buffered/read", "Read through a BufferedReader")
+{
+    IOIntfHandle mem(new ReadableMemory(io_test_data, sizeof(io_test_data)));
+    BufferedReader reader(mem, 5);
+
+    uint8_t buf[sizeof(io_test_data)];
+    memset(buf, 0, sizeof(buf));
+
+    CHECK(reader.read(&buf[0], 1) == 1);
+    CHECK(reader.read(&buf[1], 3) == 3);
+    CHECK(reader.read(&buf[4], 4) == 4);
+    // larger than the block size
+    CHECK(reader.read(&buf[8], 7) == 7);
+    CHECK(reader.read(&buf[15], 2) == 2);
+    CHECK(reader.skip(3) == 3);
+    CHECK(reader.read(&buf[20], 8) == 4);
+    CHECK(reader.read(&buf[0], 1) == 0);
+
+    CHECK(memcmp(buf, io_test_data, 17) == 0);
+    CHECK(memcmp(&buf[20], &io_test_data[20], 4) == 0);
+}
+
+TEST_CASE ("io/buffered/skip", "Skip beyond the end through a BufferedReader")
+{
+    IOIntfHandle mem(new ReadableMemory(io_test_data, sizeof(io_test_data)));
+    BufferedReader reader(mem, 8);
+
+    uint8_t value = 0;
+    CHECK(reader.read(&value, 1) == 1);
+    CHECK(reader.skip(10) == 10);
+    CHECK(reader.read(&value, 1) == 1);
+    CHECK(value == 0x0b);
+    CHECK(reader.skip(100) == 12);
+}
+
+TEST_CASE ("io/buffered/write", "Write through a BufferedWriter")
+{
+    uint8_t output[sizeof(io_test_data)];
+    IOIntfHandle mem(new WritableMemory(output, sizeof(output)));
+    WritableMemory *mem_raw = static_cast<WritableMemory*>(mem.get());
+
+    {
+        BufferedWriter writer(mem, 5);
+        CHECK(writer.write(&io_test_data[0], 3) == 3);
+        CHECK(mem_raw->size() == 0);
+        CHECK(writer.write(&io_test_data[3], 4) == 4);
+        CHECK(mem_raw->size() == 3);
+        CHECK(writer.write(&io_test_data[7], 10) == 10);
+        CHECK(writer.write(&io_test_data[17], 2) == 2);
+        REQUIRE(writer.flush());
+        CHECK(mem_raw->size() == 19);
+        CHECK(writer.write(&io_test_data[19], 5) == 5);
+    }
+
+    REQUIRE(mem_raw->size() == sizeof(io_test_data));
+    CHECK(memcmp(output, io_test_data, sizeof(io_test_data)) == 0);
+}
+
+TEST_CASE ("io/buffered/write_overflow", "Report short writes on flush")
+{
+    uint8_t output[4];
+    IOIntfHandle mem(new WritableMemory(output, sizeof(output)));
+
+    BufferedWriter writer(mem, 16);
+    CHECK(writer.write(io_test_data, 8) == 8);
+    CHECK(!writer.flush());
+}
+
+TEST_CASE ("io/std/roundtrip", "Encode to and decode from std streams")
+{
+    std::stringstream stream;
+
+    NodeHandle node = NodeHandleFactory<UInt32Record>::create(0x01);
+    static_cast<UInt32Record*>(node.get())->set(0xdeadbeef);
+    tree_to_bitstream({node}, IOIntfHandle(new StandardOutputStream(stream)));
+
+    ContainerHandle root = bitstream_to_tree(
+        IOIntfHandle(new StandardInputStream(stream)));
+    REQUIRE(root->child_count() == 1);
+
+    UInt32Record *rec = dynamic_cast<UInt32Record*>(
+        root->children_begin()->get());
+    REQUIRE(rec != 0);
+    CHECK(rec->get() == 0xdeadbeef);
+}
+
+TEST_CASE ("io/mmap/read", "Decode a stream from a memory mapped file")
+{
+    char path[] = "/tmp/structstream-test-XXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+
+    {
+        NodeHandle node = NodeHandleFactory<UInt32Record>::create(0x01);
+        static_cast<UInt32Record*>(node.get())->set(0xdeadbeef);
+
+        uint8_t output[32];
+        intptr_t size = tree_to_blob(output, sizeof(output), {node});
+        REQUIRE(write(fd, output, size) == size);
+    }
+
+    IOIntfHandle io(new MappedFile(fd));
+    close(fd);
+    unlink(path);
+
+    MappedFile *file = static_cast<MappedFile*>(io.get());
+    CHECK(file->size() == 7);
+
+    ContainerHandle root = bitstream_to_tree(io);
+    REQUIRE(root->child_count() == 1);
+    UInt32Record *rec = dynamic_cast<UInt32Record*>(
+        root->children_begin()->get());
+    REQUIRE(rec != 0);
+    CHECK(rec->get() == 0xdeadbeef);
+    CHECK(file->offset() == file->size());
+}
+
+TEST_CASE ("io/mmap/skip", "Skip within a memory mapped file")
+{
+    char path[] = "/tmp/structstream-test-XXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+    REQUIRE(write(fd, io_test_data, sizeof(io_test_data)) == sizeof(io_test_data));
+
+    MappedFile file(path, MappedFile::Random);
+    close(fd);
+    unlink(path);
+
+    uint8_t value = 0;
+    CHECK(file.skip(10) == 10);
+    CHECK(file.read(&value, 1) == 1);
+    CHECK(value == 0x0a);
+    CHECK(file.skip(100) == 13);
+    CHECK(file.read(&value, 1) == 0);
+}
+
+TEST_CASE ("io/mmap/empty", "Map an empty file")
+{
+    char path[] = "/tmp/structstream-test-XXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+
+    MappedFile file(fd);
+    close(fd);
+    unlink(path);
+
+    CHECK(file.size() == 0);
+    uint8_t value = 0;
+    CHECK(file.read(&value, 1) == 0);
+    CHECK(file.read(&value, 0) == 0);
+    CHECK(file.skip(1) == 0);
+    const uint8_t *direct = &value;
+    CHECK(file.acquire(&direct, 1) == 0);
+    CHECK(file.offset() == 0);
+}
+
+TEST_CASE ("io/mmap/missing", "Fail to map a missing file")
+{
+    CHECK_THROWS_AS(MappedFile("/nonexistent/structstream"), IOError);
+}
+
+TEST_CASE ("io/fd/pipe", "Read and write through a pipe")
+{
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+
+    {
+        FdOutput out(fds[1], true, 5);
+        CHECK(out.write(&io_test_data[0], 3) == 3);
+        CHECK(out.write(&io_test_data[3], 1) == 1);
+        // does not fit anymore, goes out together with the buffer
+        CHECK(out.write(&io_test_data[4], 10) == 10);
+        CHECK(out.write(&io_test_data[14], 10) == 10);
+    }
+
+    FdInput in(fds[0], true, 8);
+    uint8_t buf[sizeof(io_test_data)];
+    memset(buf, 0, sizeof(buf));
+
+    CHECK(in.read(&buf[0], 2) == 2);
+    const uint8_t *direct = nullptr;
+    CHECK(in.acquire(&direct, 3) >= 3);
+    CHECK(direct[0] == 0x02);
+    in.commit(3);
+    CHECK(in.read(&buf[5], 10) == 10);
+    // no seeking on pipes
+    CHECK(in.skip(4) == 4);
+    CHECK(in.read(&buf[19], 10) == 5);
+    CHECK(in.read(&buf[0], 1) == 0);
+
+    CHECK(memcmp(buf, io_test_data, 2) == 0);
+    CHECK(memcmp(&buf[5], &io_test_data[5], 10) == 0);
+    CHECK(memcmp(&buf[19], &io_test_data[19], 5) == 0);
+}
+
+TEST_CASE ("io/fd/open_ended", "Decode a short record from a pipe which is still open")
+{
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    REQUIRE(write(fds[1], io_short_record, sizeof(io_short_record))
+            == (ssize_t)sizeof(io_short_record));
+
+    // unstall the reader eventually if it waits for more data
+    std::atomic<bool> decoded(false);
+    std::atomic<bool> closed(false);
+    std::thread watchdog([fds, &decoded, &closed]() {
+        for (int i = 0; i < 500 && !decoded.load(); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        closed.store(true);
+        close(fds[1]);
+    });
+
+    BitstreamCursor cursor(IOIntfHandle(new FdInput(fds[0], true)));
+    CursorEvent ev;
+    const bool has_next = cursor.next(ev);
+    const bool writer_open = !closed.load();
+    decoded.store(true);
+    watchdog.join();
+
+    REQUIRE(has_next);
+    CHECK(writer_open);
+    CHECK(ev.value.u32 == 0x11111111U);
+}
+
+TEST_CASE ("io/fd/file", "Encode to and decode from a file")
+{
+    char path[] = "/tmp/structstream-test-XXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+    close(fd);
+
+    {
+        NodeHandle node = NodeHandleFactory<UInt32Record>::create(0x01);
+        static_cast<UInt32Record*>(node.get())->set(0xdeadbeef);
+        tree_to_bitstream({node}, IOIntfHandle(new FdOutput(std::string(path))));
+    }
+
+    ContainerHandle root = bitstream_to_tree(
+        IOIntfHandle(new FdInput(std::string(path))));
+    REQUIRE(root->child_count() == 1);
+    UInt32Record *rec = dynamic_cast<UInt32Record*>(
+        root->children_begin()->get());
+    REQUIRE(rec != 0);
+    CHECK(rec->get() == 0xdeadbeef);
+
+    FdInput in{std::string(path), 0};
+    uint8_t value = 0;
+    CHECK(in.skip(3) == 3);
+    CHECK(in.read(&value, 1) == 1);
+    CHECK(in.skip(100) == 3);
+    CHECK(in.read(&value, 1) == 0);
+
+    unlink(path);
+}
+
+TEST_CASE ("io/fd/with_length", "Encode containers with body length into a descriptor")
+{
+    ContainerHandle outer = NodeHandleFactory<Container>::create(0x01);
+    ContainerHandle inner = NodeHandleFactory<Container>::create(0x02);
+    std::shared_ptr<BlobRecord> blob = NodeHandleFactory<BlobRecord>::create(0x03);
+    std::vector<char> payload(300, 'x');
+    blob->set(payload.data(), payload.size());
+    inner->child_add(blob);
+    outer->child_add(inner);
+
+    WritableMemory *mem = new WritableMemory();
+    IOIntfHandle mem_h(mem);
+    {
+        ToBitstream *writer = new ToBitstream(mem_h);
+        writer->set_length_default(true);
+        FromTree(StreamSink(writer), {outer});
+    }
+
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    {
+        // smaller than the body, which is written with writev()
+        FdOutput *out = new FdOutput(fds[1], true, 16);
+        CHECK(out->buffered());
+        ToBitstream *writer = new ToBitstream(IOIntfHandle(out));
+        writer->set_length_default(true);
+        FromTree(StreamSink(writer), {outer});
+    }
+
+    std::vector<uint8_t> output(mem->size() + 1);
+    FdInput in(fds[0], true);
+    REQUIRE(in.read(output.data(), output.size()) == mem->size());
+    CHECK(memcmp(output.data(), mem->buffer(), mem->size()) == 0);
+}
+
+TEST_CASE ("io/fd/segments", "Write segmented memory with writev")
+{
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+
+    SegmentPoolHandle pool(new SegmentPool(5));
+    SegmentedMemory mem(pool);
+    mem.write(&io_test_data[2], 22);
+
+    {
+        FdOutput out(fds[1], true);
+        out.write(io_test_data, 2);
+        out.write_segments(mem);
+    }
+
+    FdInput in(fds[0], true);
+    uint8_t buf[sizeof(io_test_data) + 1];
+    CHECK(in.read(buf, sizeof(buf)) == sizeof(io_test_data));
+    CHECK(memcmp(buf, io_test_data, sizeof(io_test_data)) == 0);
+}
+
+TEST_CASE ("io/fd/missing", "Fail to open a missing file")
+{
+    CHECK_THROWS_AS(FdInput(std::string("/nonexistent/structstream")), IOError);
+}
+
+static void check_async_roundtrip(bool try_io_uring)
+{
+    char path[] = "/tmp/structstream-test-XXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+    close(fd);
+
+    static const int repeat = 100;
+    {
+        AsyncFileOutput out(std::string(path), 64, 3, try_io_uring);
+        for (int i = 0; i < repeat; i++) {
+            CHECK(out.write(io_test_data, sizeof(io_test_data)) == sizeof(io_test_data));
+        }
+        out.flush();
+    }
+
+    AsyncFileInput in(std::string(path), 50, 3, try_io_uring);
+    unlink(path);
+    if (!try_io_uring) {
+        CHECK(!in.uses_io_uring());
+    }
+
+    uint8_t buf[sizeof(io_test_data)];
+    for (int i = 0; i < repeat / 2; i++) {
+        REQUIRE(in.read(buf, sizeof(buf)) == sizeof(buf));
+        CHECK(memcmp(buf, io_test_data, sizeof(buf)) == 0);
+    }
+
+    // beyond the blocks in flight
+    CHECK(in.skip(10*sizeof(io_test_data) + 3) == 10*sizeof(io_test_data) + 3);
+    const uint8_t *direct = nullptr;
+    REQUIRE(in.acquire(&direct, 1) >= 1);
+    CHECK(direct[0] == io_test_data[3]);
+    in.commit(1);
+
+    CHECK(in.skip(sizeof(io_test_data) - 4) == sizeof(io_test_data) - 4);
+    for (int i = repeat / 2 + 11; i < repeat; i++) {
+        REQUIRE(in.read(buf, sizeof(buf)) == sizeof(buf));
+        CHECK(memcmp(buf, io_test_data, sizeof(buf)) == 0);
+    }
+    CHECK(in.read(buf, sizeof(buf)) == 0);
+    CHECK(in.skip(10) == 0);
+}
+
+TEST_CASE ("io/async/roundtrip", "Write and read a file asynchronously")
+{
+    check_async_roundtrip(true);
+}
+
+TEST_CASE ("io/async/fallback", "Write and read a file with pread/pwrite")
+{
+    check_async_roundtrip(false);
+}
+
+TEST_CASE ("io/async/decode", "Decode a stream from an asynchronous source")
+{
+    char path[] = "/tmp/structstream-test-XXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+    close(fd);
+
+    {
+        NodeHandle node = NodeHandleFactory<UInt32Record>::create(0x01);
+        static_cast<UInt32Record*>(node.get())->set(0xdeadbeef);
+        tree_to_bitstream({node}, IOIntfHandle(
+            new AsyncFileOutput(std::string(path))));
+    }
+
+    ContainerHandle root = bitstream_to_tree(
+        IOIntfHandle(new AsyncFileInput(std::string(path))));
+    unlink(path);
+    REQUIRE(root->child_count() == 1);
+    UInt32Record *rec = dynamic_cast<UInt32Record*>(
+        root->children_begin()->get());
+    REQUIRE(rec != 0);
+    CHECK(rec->get() == 0xdeadbeef);
+}
+
+static void check_async_read_error(bool try_io_uring)
+{
+    // reading from a directory fails, for every block in flight
+    int fd = open("/tmp", O_RDONLY | O_DIRECTORY);
+    REQUIRE(fd >= 0);
+
+    AsyncFileInput in(fd, true, 16, 4, try_io_uring);
+    uint8_t buf[16];
+    CHECK_THROWS_AS(in.read(buf, sizeof(buf)), IOError);
+
+    // dropping the reads in flight reaps all of their failures
+    CHECK_NOTHROW(in.seek(1));
+    CHECK_THROWS_AS(in.read(buf, sizeof(buf)), IOError);
+}
+
+TEST_CASE ("io/async/read_error", "Reap failed requests before teardown")
+{
+    check_async_read_error(true);
+    check_async_read_error(false);
+}
+
+TEST_CASE ("io/pipe/wrap", "Read and write across the end of the ring")
+{
+    RingPipeHandle pipe(new RingPipe(10));
+    REQUIRE(pipe->capacity() == 16);
+    PipeWriteEnd out(pipe);
+    PipeReadEnd in(pipe);
+
+    uint8_t buf[sizeof(io_test_data)];
+    CHECK(out.write(io_test_data, 12) == 12);
+    CHECK(in.read(buf, 10) == 10);
+    CHECK(out.write(&io_test_data[12], 12) == 12);
+
+    const uint8_t *direct = nullptr;
+    // only the part up to the end of the ring is contiguous
+    CHECK(in.acquire(&direct, 8) == 6);
+    CHECK(direct[0] == 0x0a);
+    in.commit(6);
+    CHECK(in.acquire(&direct, 8) == 8);
+    CHECK(direct[0] == 0x10);
+
+    out.close();
+    CHECK(in.read(&buf[16], 10) == 8);
+    CHECK(memcmp(&buf[16], &io_test_data[16], 8) == 0);
+    CHECK(in.read(buf, 1) == 0);
+}
+
+TEST_CASE ("io/pipe/reader_closed", "Fail writes after the reader went away")
+{
+    RingPipeHandle pipe(new RingPipe(16));
+    PipeWriteEnd out(pipe);
+    {
+        PipeReadEnd in(pipe);
+    }
+    CHECK(out.write(io_test_data, sizeof(io_test_data)) < (intptr_t)sizeof(io_test_data));
+}
+
+TEST_CASE ("io/pipe/idle_writer", "Decode a record while the writer is idle")
+{
+    RingPipeHandle pipe(new RingPipe(64));
+    PipeWriteEnd out(pipe);
+
+    // shorter than a varuint word
+    static const uint8_t data[] = {
+        (uint8_t)(RT_UINT32) | 0x80, uint8_t(0x02) | 0x80, 0x11, 0x11, 0x11, 0x11
+    };
+    REQUIRE(out.write(data, sizeof(data)) == sizeof(data));
+
+    // unstall the reader eventually if it waits for more data
+    std::atomic<bool> decoded(false);
+    std::atomic<bool> closed(false);
+    std::thread watchdog([&out, &decoded, &closed]() {
+        for (int i = 0; i < 500 && !decoded.load(); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        closed.store(true);
+        out.close();
+    });
+
+    BitstreamCursor cursor(IOIntfHandle(new PipeReadEnd(pipe)), 0);
+    CursorEvent ev;
+    const bool has_next = cursor.next(ev);
+    const bool writer_open = !closed.load();
+    decoded.store(true);
+    watchdog.join();
+
+    REQUIRE(has_next);
+    CHECK(writer_open);
+    CHECK(ev.kind == CE_VALUE);
+    CHECK(ev.id == 0x02U);
+    CHECK(ev.value.u32 == 0x11111111U);
+}
+
+static void check_pipe_streaming(RingPipe::WaitPolicy policy)
+{
+    static const int count = 5000;
+    RingPipeHandle pipe(new RingPipe(256, policy));
+
+    std::thread producer([pipe]() {
+        ContainerHandle root = NodeHandleFactory<Container>::create(0x01);
+        for (int i = 0; i < count; i++) {
+            NodeHandle node = NodeHandleFactory<UInt32Record>::create(0x02);
+            static_cast<UInt32Record*>(node.get())->set(i);
+            root->child_add(node);
+        }
+        tree_to_bitstream({root}, IOIntfHandle(new PipeWriteEnd(pipe)));
+    });
+
+    ContainerHandle tree = bitstream_to_tree(IOIntfHandle(new PipeReadEnd(pipe)));
+    producer.join();
+
+    REQUIRE(tree->child_count() == 1);
+    ContainerHandle root = std::dynamic_pointer_cast<Container>(
+        *tree->children_begin());
+    REQUIRE(root.get() != nullptr);
+    REQUIRE(root->child_count() == count);
+    int i = 0;
+    bool all_equal = true;
+    for (auto it = root->children_begin(); it != root->children_end(); it++) {
+        all_equal = all_equal && static_cast<UInt32Record*>(it->get())->get() == (uint32_t)i++;
+    }
+    CHECK(all_equal);
+}
+
+TEST_CASE ("io/pipe/streaming", "Decode while encoding in another thread")
+{
+    check_pipe_streaming(RingPipe::Block);
+}
+
+TEST_CASE ("io/pipe/spinning", "Decode while encoding in another thread, spinning")
+{
+    check_pipe_streaming(RingPipe::Spin);
+}
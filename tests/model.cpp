@@ -72,3 +72,39 @@ TEST_CASE ("model/bool_record", "Test the boolean record inheritance")
     NodeHandle copy = rec->copy();
     REQUIRE(dynamic_cast<BoolRecord*>(copy.get()) != 0);
 }
+
+TEST_CASE ("model/node_cast", "Test the node kind and node_cast")
+{
+    typedef EnumRecordTpl<HashType, 0x60, UInt32Record> EnumRecord;
+
+    NodeHandle cont = NodeHandleFactory<Container>::create(0x01);
+    NodeHandle rec = NodeHandleFactory<UInt32Record>::create(0x02);
+    NodeHandle enum_rec = NodeHandleFactory<EnumRecord>::create(0x03);
+
+    CHECK(cont->is_container());
+    CHECK(cont->copy()->is_container());
+    CHECK_FALSE(rec->is_container());
+
+    CHECK(node_cast<Container>(cont) == cont);
+    CHECK(node_cast<Node>(cont.get()) == cont.get());
+    CHECK(node_cast<Container>(rec).get() == 0);
+    CHECK(node_cast<UInt32Record>(cont.get()) == 0);
+    CHECK(node_cast<UInt32Record>(rec.get()) == rec.get());
+    CHECK(node_cast<DataRecord>(rec.get()) == rec.get());
+    CHECK(node_cast<UInt64Record>(rec.get()) == 0);
+
+    // the class tag is set by the factory, also for copies
+    CHECK(rec->class_tag() == NodeClass<UInt32Record>::tag());
+    CHECK(rec->copy()->class_tag() == NodeClass<UInt32Record>::tag());
+    CHECK(enum_rec->class_tag() == NodeClass<EnumRecord>::tag());
+    CHECK(cont->class_tag() != rec->class_tag());
+    CHECK(NodeClass<UInt32Record>::tag() != NodeClass<Int32Record>::tag());
+
+    // subclasses go through dynamic_cast
+    CHECK(node_cast<UInt32Record>(enum_rec.get()) == dynamic_cast<UInt32Record*>(enum_rec.get()));
+    CHECK(node_cast<EnumRecord>(rec.get()) == 0);
+    CHECK(node_cast<EnumRecord>(enum_rec.get()) == enum_rec.get());
+
+    const Node *const_rec = rec.get();
+    CHECK(node_cast<UInt32Record>(const_rec) == rec.get());
+}
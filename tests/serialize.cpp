@@ -27,6 +27,7 @@ authors named in the AUTHORS file.
 
 #include "structstream/serialize.hpp"
 
+#include "structstream/streaming_bitstream.hpp"
 #include "structstream/streaming_tree.hpp"
 #include "structstream/node_primitive.hpp"
 #include "structstream/node_container.hpp"
@@ -201,3 +202,100 @@ TEST_CASE ("serialize/static_byte_array/raw128",
     rec->raw_get(result_payload);
     CHECK(memcmp(&result_payload[0], &payload[0], sizeof(payload)) == 0);
 }
+
+TEST_CASE ("serialize/encode/identical",
+           "Direct encoding produces the same bytes as the sink path")
+{
+    enum class colour_t: uint32_t {
+        red = 1,
+        green = 2
+    };
+
+    struct inner_t {
+        uint32_t v1;
+        double v2;
+    };
+
+    struct message_t {
+        uint32_t id;
+        std::string name;
+        std::string payload;
+        bool flag;
+        int64_t delta;
+        uint64_t count;
+        colour_t colour;
+        inner_t inner;
+        std::vector<uint32_t> values;
+        uint32_t triple[3];
+        uint8_t raw[16];
+    };
+
+    typedef EnumRecordTpl<colour_t, 0x60, UInt32Record> ColourRecord;
+
+    typedef struct_decl<
+        Container,
+        id_selector<0x01>,
+        struct_members<
+            member<UInt32Record, id_selector<0x02>, message_t, uint32_t, &message_t::id>,
+            member<UTF8Record, id_selector<0x03>, message_t, std::string, &message_t::name>,
+            member<BlobRecord, id_selector<0x04>, message_t, std::string, &message_t::payload>,
+            member<BoolRecord, id_selector<0x05>, message_t, bool, &message_t::flag>,
+            member<VarIntRecord, id_selector<0x06>, message_t, int64_t, &message_t::delta>,
+            member<VarUIntRecord, id_selector<0x07>, message_t, uint64_t, &message_t::count>,
+            member<ColourRecord, id_selector<0x08>, message_t, colour_t, &message_t::colour>,
+            member_struct<
+                message_t,
+                struct_decl<
+                    Container,
+                    id_selector<0x09>,
+                    struct_members<
+                        member<UInt32Record, id_selector<0x0a>, inner_t, uint32_t, &inner_t::v1>,
+                        member<Float64Record, id_selector<0x0b>, inner_t, double, &inner_t::v2>
+                        >
+                    >,
+                &message_t::inner
+                >,
+            member_struct<
+                message_t,
+                container<
+                    value_decl<UInt32Record, id_selector<0x0d>, uint32_t>,
+                    id_selector<0x0c>,
+                    std::back_insert_iterator<std::vector<uint32_t>>
+                    >,
+                &message_t::values
+                >,
+            member_struct<
+                message_t,
+                static_array<
+                    value_decl<UInt32Record, id_selector<0x0f>, uint32_t>,
+                    id_selector<0x0e>,
+                    3
+                    >,
+                &message_t::triple
+                >,
+            member<Raw128Record, id_selector<0x10>, message_t, uint8_t[16], &message_t::raw>
+            >
+        > serializer;
+
+    message_t msg{
+        0xdeadbeef, "name", std::string("pay\0load", 8), true,
+        -1234567, 1ULL << 40, colour_t::green,
+        {42, 2.5}, {1, 2, 3, 4}, {7, 8, 9}, {0}
+    };
+    for (int i = 0; i < 16; i++) {
+        msg.raw[i] = i * 17;
+    }
+
+    WritableMemory *via_sink = new WritableMemory();
+    IOIntfHandle via_sink_h(via_sink);
+    StreamSink writer(new ToBitstream(via_sink_h));
+    serialize_to_sink<serializer>(msg, writer);
+    writer->end_of_stream();
+
+    WritableMemory direct;
+    encode_to<serializer>(msg, &direct);
+    Utils::write_record_type(&direct, RT_END_OF_CHILDREN);
+
+    REQUIRE(direct.size() == via_sink->size());
+    CHECK(memcmp(direct.buffer(), via_sink->buffer(), direct.size()) == 0);
+}